@@ -0,0 +1,327 @@
+#pragma once
+
+#include <cstddef>
+
+namespace bench {
+
+// Counting versions of malloc, realloc and free, defined in main.cpp
+void *CountedMalloc(size_t size);
+void *CountedRealloc(void *ptr, size_t size);
+void CountedFree(void *ptr);
+
+}  // namespace bench
+
+// rapidjson's CrtAllocator - behind MemoryPoolAllocator chunks, parse stacks
+// and StringBuffer - allocates through these instead of operator new, so
+// they're routed through the counters as well. Every benchmark source has to
+// include this before any rapidjson header
+#define RAPIDJSON_MALLOC(size) ::bench::CountedMalloc(size)
+#define RAPIDJSON_REALLOC(ptr, new_size) ::bench::CountedRealloc(ptr, new_size)
+#define RAPIDJSON_FREE(ptr) ::bench::CountedFree(ptr)
+
+#include <benchmark/benchmark.h>
+#include <rapidjson/document.h>
+#include <rapidjson/reader.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <any>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <pajlada/serialize.hpp>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace bench {
+
+// Number of allocations made so far, through the global operator new and
+// rapidjson's allocators. Counted in main.cpp
+uint64_t AllocationCount();
+
+// Builds a sample value of Type, with size elements for containers and
+// size characters for strings
+template <typename Type, typename Enable = void>
+struct Sample {
+    static Type
+    make(size_t /*size*/)
+    {
+        return Type{};
+    }
+};
+
+template <typename Type>
+struct Sample<Type,
+              typename std::enable_if<std::is_arithmetic<Type>::value>::type> {
+    static Type
+    make(size_t size)
+    {
+        if constexpr (std::is_same<Type, bool>::value) {
+            return size % 2 == 0;
+        } else if constexpr (std::is_floating_point<Type>::value) {
+            return static_cast<Type>(size) + static_cast<Type>(0.25);
+        } else {
+            return static_cast<Type>(size);
+        }
+    }
+};
+
+template <>
+struct Sample<std::string> {
+    static std::string
+    make(size_t size)
+    {
+        std::string ret(size, 'a');
+        for (size_t i = 0; i < size; ++i) {
+            ret[i] = static_cast<char>('a' + i % 26);
+        }
+        return ret;
+    }
+};
+
+template <>
+struct Sample<std::string_view> {
+    static std::string_view
+    make(size_t size)
+    {
+        // Views need something to point to that outlives the benchmark
+        static const auto storage = Sample<std::string>::make(1 << 16);
+        return std::string_view(storage).substr(0, size);
+    }
+};
+
+template <typename ValueType>
+struct Sample<std::vector<ValueType>> {
+    static std::vector<ValueType>
+    make(size_t size)
+    {
+        std::vector<ValueType> ret;
+        ret.reserve(size);
+        for (size_t i = 0; i < size; ++i) {
+            ret.push_back(Sample<ValueType>::make(i % 16));
+        }
+        return ret;
+    }
+};
+
+template <typename ValueType, size_t Size>
+struct Sample<std::array<ValueType, Size>> {
+    static std::array<ValueType, Size>
+    make(size_t /*size*/)
+    {
+        std::array<ValueType, Size> ret;
+        for (size_t i = 0; i < Size; ++i) {
+            ret[i] = Sample<ValueType>::make(i % 16);
+        }
+        return ret;
+    }
+};
+
+template <typename ValueType>
+struct Sample<std::map<std::string, ValueType>> {
+    static std::map<std::string, ValueType>
+    make(size_t size)
+    {
+        std::map<std::string, ValueType> ret;
+        for (size_t i = 0; i < size; ++i) {
+            ret.emplace("key" + std::to_string(i),
+                        Sample<ValueType>::make(i % 16));
+        }
+        return ret;
+    }
+};
+
+template <typename Arg1, typename Arg2>
+struct Sample<std::pair<Arg1, Arg2>> {
+    static std::pair<Arg1, Arg2>
+    make(size_t size)
+    {
+        return {Sample<Arg1>::make(size), Sample<Arg2>::make(size)};
+    }
+};
+
+template <typename InnerType>
+struct Sample<std::optional<InnerType>> {
+    static std::optional<InnerType>
+    make(size_t size)
+    {
+        return Sample<InnerType>::make(size);
+    }
+};
+
+// The last alternative, which untagged decoding reaches last
+template <typename... InnerTypes>
+struct Sample<std::variant<InnerTypes...>> {
+    static std::variant<InnerTypes...>
+    make(size_t size)
+    {
+        using Last = std::variant_alternative_t<sizeof...(InnerTypes) - 1,
+                                                std::variant<InnerTypes...>>;
+        return Sample<Last>::make(size);
+    }
+};
+
+// A settings-like tree: size leaves per level, three levels deep
+template <>
+struct Sample<std::any> {
+    static std::any
+    make(size_t size)
+    {
+        return makeLevel(size, 3);
+    }
+
+private:
+    static std::any
+    makeLevel(size_t size, int depth)
+    {
+        std::map<std::string, std::any> ret;
+        for (size_t i = 0; i < size; ++i) {
+            auto key = "key" + std::to_string(i);
+            switch (i % 4) {
+                case 0:
+                    ret.emplace(key, static_cast<int>(i));
+                    break;
+                case 1:
+                    ret.emplace(key, Sample<std::string>::make(i % 16));
+                    break;
+                case 2:
+                    ret.emplace(key, std::vector<std::any>{1, 2.5, true});
+                    break;
+                default:
+                    ret.emplace(key, depth > 1 ? makeLevel(size, depth - 1)
+                                               : std::any(false));
+                    break;
+            }
+        }
+        return ret;
+    }
+};
+
+template <typename Type>
+std::string
+Stringify(const Type &value)
+{
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    pajlada::SerializeTo<Type>::write(value, writer);
+
+    return {buffer.GetString(), buffer.GetSize()};
+}
+
+// Reports the throughput in JSON bytes and the allocations made per iteration
+class Counters
+{
+public:
+    Counters(benchmark::State &state, size_t bytes)
+        : state_(state)
+        , bytes_(bytes)
+        , allocations_(AllocationCount())
+    {
+    }
+
+    ~Counters()
+    {
+        auto iterations = static_cast<int64_t>(this->state_.iterations());
+
+        this->state_.SetBytesProcessed(iterations *
+                                       static_cast<int64_t>(this->bytes_));
+        this->state_.counters["allocs/op"] = benchmark::Counter(
+            static_cast<double>(AllocationCount() - this->allocations_),
+            benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    benchmark::State &state_;
+    size_t bytes_;
+    uint64_t allocations_;
+};
+
+// Serialize<Type>::get into a fresh document
+template <typename Type>
+void
+SerializeDOM(benchmark::State &state)
+{
+    auto value = Sample<Type>::make(static_cast<size_t>(state.range(0)));
+    Counters counters(state, Stringify(value).size());
+
+    for (auto _ : state) {
+        rapidjson::Document d;
+        auto out = pajlada::Serialize<Type>::get(value, d.GetAllocator());
+        benchmark::DoNotOptimize(out);
+    }
+}
+
+// SerializeTo<Type>::write into a reused buffer
+template <typename Type>
+void
+SerializeSAX(benchmark::State &state)
+{
+    auto value = Sample<Type>::make(static_cast<size_t>(state.range(0)));
+    Counters counters(state, Stringify(value).size());
+
+    rapidjson::StringBuffer buffer;
+    for (auto _ : state) {
+        buffer.Clear();
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        pajlada::SerializeTo<Type>::write(value, writer);
+        benchmark::DoNotOptimize(buffer.GetString());
+    }
+}
+
+// Deserialize<Type>::get from an already parsed document
+template <typename Type>
+void
+DeserializeDOM(benchmark::State &state)
+{
+    auto json =
+        Stringify(Sample<Type>::make(static_cast<size_t>(state.range(0))));
+    rapidjson::Document d;
+    d.Parse(json.c_str(), json.size());
+
+    Counters counters(state, json.size());
+
+    for (auto _ : state) {
+        bool error = false;
+        auto out = pajlada::Deserialize<Type>::get(d, &error);
+        benchmark::DoNotOptimize(out);
+    }
+}
+
+// DeserializeStream straight from the JSON text
+template <typename Type>
+void
+DeserializeSAX(benchmark::State &state)
+{
+    auto json =
+        Stringify(Sample<Type>::make(static_cast<size_t>(state.range(0))));
+    Counters counters(state, json.size());
+
+    for (auto _ : state) {
+        bool error = false;
+        Type out{};
+        rapidjson::StringStream ss(json.c_str());
+        pajlada::DeserializeStream(ss, out, &error);
+        benchmark::DoNotOptimize(out);
+    }
+}
+
+}  // namespace bench
+
+// BENCHMARK_TEMPLATE pastes the function name into an identifier, so it
+// can't be qualified
+using bench::DeserializeDOM;
+using bench::DeserializeSAX;
+using bench::SerializeDOM;
+using bench::SerializeSAX;
+
+// Registers all four directions for Type, which must not contain commas.
+// Everything after Type is applied to each benchmark, e.g. ->Arg(8)
+#define PAJLADA_BENCHMARK(Type, ...)                    \
+    BENCHMARK_TEMPLATE(SerializeDOM, Type) __VA_ARGS__;   \
+    BENCHMARK_TEMPLATE(SerializeSAX, Type) __VA_ARGS__;   \
+    BENCHMARK_TEMPLATE(DeserializeDOM, Type) __VA_ARGS__; \
+    BENCHMARK_TEMPLATE(DeserializeSAX, Type) __VA_ARGS__
@@ -0,0 +1,96 @@
+#include "common.hpp"
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <pajlada/serialize/base64.hpp>
+#include <pajlada/serialize/containers.hpp>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+template <typename Type>
+struct Sample<pajlada::Base64<Type>> {
+    static pajlada::Base64<Type>
+    make(size_t size)
+    {
+        return {Sample<Type>::make(size)};
+    }
+};
+
+template <typename ValueType>
+struct Sample<std::deque<ValueType>> {
+    static std::deque<ValueType>
+    make(size_t size)
+    {
+        auto elements = Sample<std::vector<ValueType>>::make(size);
+        return {elements.begin(), elements.end()};
+    }
+};
+
+// Distinct elements, so the set ends up with size of them
+template <typename ValueType>
+struct Sample<std::set<ValueType>> {
+    static std::set<ValueType>
+    make(size_t size)
+    {
+        std::set<ValueType> ret;
+        for (size_t i = 0; i < size; ++i) {
+            ret.insert(Sample<ValueType>::make(i));
+        }
+        return ret;
+    }
+};
+
+template <typename ValueType>
+struct Sample<std::unordered_map<std::string, ValueType>> {
+    static std::unordered_map<std::string, ValueType>
+    make(size_t size)
+    {
+        auto entries = Sample<std::map<std::string, ValueType>>::make(size);
+        return {entries.begin(), entries.end()};
+    }
+};
+
+}  // namespace bench
+
+namespace {
+
+using IntVector = std::vector<int>;
+using Int64Vector = std::vector<int64_t>;
+using DoubleVector = std::vector<double>;
+using ByteVector = std::vector<uint8_t>;
+using Base64Bytes = pajlada::Base64<std::vector<uint8_t>>;
+using Base64Doubles = pajlada::Base64<std::vector<double>>;
+using StringVector = std::vector<std::string>;
+using NestedVector = std::vector<std::vector<int>>;
+using IntArray = std::array<int, 64>;
+using IntMap = std::map<std::string, int>;
+using IntUnorderedMap = std::unordered_map<std::string, int>;
+using IntSet = std::set<int>;
+using IntDeque = std::deque<int>;
+using StringMap = std::map<std::string, std::string>;
+using Pair = std::pair<std::string, int>;
+
+}  // namespace
+
+PAJLADA_BENCHMARK(IntVector, ->Arg(8)->Arg(512)->Arg(32768));
+PAJLADA_BENCHMARK(Int64Vector, ->Arg(8)->Arg(512)->Arg(32768));
+PAJLADA_BENCHMARK(DoubleVector, ->Arg(8)->Arg(512)->Arg(32768));
+PAJLADA_BENCHMARK(ByteVector, ->Arg(512)->Arg(32768));
+PAJLADA_BENCHMARK(Base64Bytes, ->Arg(512)->Arg(32768));
+PAJLADA_BENCHMARK(Base64Doubles, ->Arg(512)->Arg(32768));
+PAJLADA_BENCHMARK(StringVector, ->Arg(8)->Arg(512)->Arg(32768));
+PAJLADA_BENCHMARK(NestedVector, ->Arg(8)->Arg(512));
+PAJLADA_BENCHMARK(IntArray, ->Arg(64));
+PAJLADA_BENCHMARK(IntMap, ->Arg(8)->Arg(512)->Arg(32768));
+PAJLADA_BENCHMARK(IntUnorderedMap, ->Arg(8)->Arg(512)->Arg(32768));
+PAJLADA_BENCHMARK(IntSet, ->Arg(512)->Arg(32768));
+PAJLADA_BENCHMARK(IntDeque, ->Arg(512)->Arg(32768));
+PAJLADA_BENCHMARK(StringMap, ->Arg(8)->Arg(512)->Arg(32768));
+PAJLADA_BENCHMARK(Pair, ->Arg(8));
@@ -0,0 +1,35 @@
+#include "common.hpp"
+
+#include <any>
+#include <map>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace {
+
+using AnyTree = std::any;
+
+// Decoded values are the last alternative, the worst case for untagged
+// variants
+using WideVariant =
+    std::variant<bool, int, double, std::vector<int>, std::vector<std::string>,
+                 std::map<std::string, int>, std::string>;
+using WideVariants = std::vector<WideVariant>;
+
+using OptionalInt = std::optional<int>;
+using OptionalVector = std::optional<std::vector<int>>;
+using Optionals = std::vector<std::optional<std::string>>;
+
+}  // namespace
+
+// Three levels of size entries each
+PAJLADA_BENCHMARK(AnyTree, ->Arg(4)->Arg(16));
+
+PAJLADA_BENCHMARK(WideVariant, ->Arg(8));
+PAJLADA_BENCHMARK(WideVariants, ->Arg(512));
+
+PAJLADA_BENCHMARK(OptionalInt, ->Arg(42));
+PAJLADA_BENCHMARK(OptionalVector, ->Arg(512));
+PAJLADA_BENCHMARK(Optionals, ->Arg(512));
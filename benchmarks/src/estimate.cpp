@@ -0,0 +1,108 @@
+#include "common.hpp"
+
+#include <map>
+#include <pajlada/serialize/estimate.hpp>
+#include <string>
+#include <vector>
+
+namespace {
+
+using IntVector = std::vector<int>;
+using StringVector = std::vector<std::string>;
+using StringMap = std::map<std::string, std::string>;
+
+// EstimateSize<Type>::get on its own
+template <typename Type>
+void
+Estimate(benchmark::State &state)
+{
+    auto value =
+        bench::Sample<Type>::make(static_cast<size_t>(state.range(0)));
+    bench::Counters counters(state, bench::Stringify(value).size());
+
+    for (auto _ : state) {
+        auto estimate = pajlada::EstimateSize<Type>::get(value);
+        benchmark::DoNotOptimize(estimate);
+    }
+}
+
+// SerializeTo<Type>::write into a fresh buffer, which grows on the way
+template <typename Type>
+void
+WriteGrown(benchmark::State &state)
+{
+    auto value =
+        bench::Sample<Type>::make(static_cast<size_t>(state.range(0)));
+    bench::Counters counters(state, bench::Stringify(value).size());
+
+    for (auto _ : state) {
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        pajlada::SerializeTo<Type>::write(value, writer);
+        benchmark::DoNotOptimize(buffer.GetString());
+    }
+}
+
+// The same, with the buffer reserved from EstimateSize first
+template <typename Type>
+void
+WritePresized(benchmark::State &state)
+{
+    auto value =
+        bench::Sample<Type>::make(static_cast<size_t>(state.range(0)));
+    bench::Counters counters(state, bench::Stringify(value).size());
+
+    for (auto _ : state) {
+        rapidjson::StringBuffer buffer;
+        buffer.Reserve(pajlada::EstimateSize<Type>::get(value).bytes + 1);
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        pajlada::SerializeTo<Type>::write(value, writer);
+        benchmark::DoNotOptimize(buffer.GetString());
+    }
+}
+
+// Serialize<Type>::get into a pool with the default chunk size
+template <typename Type>
+void
+BuildGrown(benchmark::State &state)
+{
+    auto value =
+        bench::Sample<Type>::make(static_cast<size_t>(state.range(0)));
+    bench::Counters counters(state, bench::Stringify(value).size());
+
+    for (auto _ : state) {
+        rapidjson::MemoryPoolAllocator<> pool;
+        auto out = pajlada::Serialize<Type>::get(value, pool);
+        benchmark::DoNotOptimize(out);
+    }
+}
+
+// The same, with a single chunk sized from EstimateSize
+template <typename Type>
+void
+BuildPresized(benchmark::State &state)
+{
+    auto value =
+        bench::Sample<Type>::make(static_cast<size_t>(state.range(0)));
+    bench::Counters counters(state, bench::Stringify(value).size());
+
+    for (auto _ : state) {
+        rapidjson::MemoryPoolAllocator<> pool(
+            pajlada::EstimateSize<Type>::get(value).allocatorBytes());
+        auto out = pajlada::Serialize<Type>::get(value, pool);
+        benchmark::DoNotOptimize(out);
+    }
+}
+
+}  // namespace
+
+#define PAJLADA_BENCHMARK_PRESIZE(Type, ...)             \
+    BENCHMARK_TEMPLATE(Estimate, Type) __VA_ARGS__;      \
+    BENCHMARK_TEMPLATE(WriteGrown, Type) __VA_ARGS__;    \
+    BENCHMARK_TEMPLATE(WritePresized, Type) __VA_ARGS__; \
+    BENCHMARK_TEMPLATE(BuildGrown, Type) __VA_ARGS__;    \
+    BENCHMARK_TEMPLATE(BuildPresized, Type) __VA_ARGS__
+
+PAJLADA_BENCHMARK_PRESIZE(IntVector, ->Arg(512)->Arg(262144));
+PAJLADA_BENCHMARK_PRESIZE(StringVector, ->Arg(512)->Arg(262144));
+PAJLADA_BENCHMARK_PRESIZE(StringMap, ->Arg(512)->Arg(65536));
@@ -0,0 +1,72 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<uint64_t> allocations{0};
+
+}  // namespace
+
+namespace bench {
+
+uint64_t
+AllocationCount()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+void *
+CountedMalloc(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size);
+}
+
+// Growing a buffer in place or not, it's an allocation either way
+void *
+CountedRealloc(void *ptr, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::realloc(ptr, size);
+}
+
+void
+CountedFree(void *ptr)
+{
+    std::free(ptr);
+}
+
+}  // namespace bench
+
+// Count every allocation, so benchmarks can report allocations per operation.
+// rapidjson's own allocations come in through the functions above, see
+// common.hpp
+void *
+operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void
+operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void
+operator delete(void *ptr, std::size_t /*size*/) noexcept
+{
+    std::free(ptr);
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,11 @@
+#include "common.hpp"
+
+#include <cstdint>
+
+// The argument is the value itself for scalars
+PAJLADA_BENCHMARK(bool, ->Arg(1));
+PAJLADA_BENCHMARK(int, ->Arg(42));
+PAJLADA_BENCHMARK(int64_t, ->Arg(1LL << 40));
+PAJLADA_BENCHMARK(uint64_t, ->Arg(1LL << 40));
+PAJLADA_BENCHMARK(float, ->Arg(42));
+PAJLADA_BENCHMARK(double, ->Arg(42));
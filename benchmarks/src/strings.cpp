@@ -0,0 +1,20 @@
+#include "common.hpp"
+
+#include <string>
+#include <string_view>
+
+PAJLADA_BENCHMARK(std::string, ->Arg(8)->Arg(64)->Arg(4096));
+
+// Views can only be streamed from insitu input, which isn't covered here
+BENCHMARK_TEMPLATE(SerializeDOM, std::string_view)
+    ->Arg(8)
+    ->Arg(64)
+    ->Arg(4096);
+BENCHMARK_TEMPLATE(SerializeSAX, std::string_view)
+    ->Arg(8)
+    ->Arg(64)
+    ->Arg(4096);
+BENCHMARK_TEMPLATE(DeserializeDOM, std::string_view)
+    ->Arg(8)
+    ->Arg(64)
+    ->Arg(4096);
@@ -1,4 +1,7 @@
 #pragma once
 
+#include <pajlada/serialize/deserialize-from.hpp>
 #include <pajlada/serialize/deserialize.hpp>
+#include <pajlada/serialize/insitu.hpp>
+#include <pajlada/serialize/serialize-to.hpp>
 #include <pajlada/serialize/serialize.hpp>
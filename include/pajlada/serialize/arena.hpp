@@ -0,0 +1,189 @@
+#pragma once
+
+#include <rapidjson/document.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace pajlada {
+
+// Bump allocator for rapidjson values, meant to be reused across requests.
+//
+// Memory is handed out from large blocks and never freed individually.
+// Reset() rewinds to the first block in O(1): every value allocated from the
+// arena becomes invalid, and the blocks are reused for whatever is allocated
+// next, so a warmed up arena doesn't allocate at all.
+//
+//   using ArenaValue =
+//       rapidjson::GenericValue<rapidjson::UTF8<>, ArenaAllocator>;
+//
+//   ArenaAllocator arena;
+//   for (const auto &request : requests) {
+//       auto response =
+//           Serialize<Response, ArenaValue>::get(handle(request), arena);
+//       send(response);
+//       arena.Reset();
+//   }
+//
+// Since kNeedFree is false, values never touch their memory when they're
+// destroyed, so it's fine for them to outlive a Reset() as long as they're
+// not used anymore.
+class ArenaAllocator
+{
+public:
+    static const bool kNeedFree = false;
+
+    static constexpr size_t kDefaultBlockSize = 64 * 1024;
+
+    explicit ArenaAllocator(size_t blockSize = kDefaultBlockSize)
+        : blockSize_(blockSize)
+    {
+    }
+
+    ArenaAllocator(const ArenaAllocator &) = delete;
+    ArenaAllocator &operator=(const ArenaAllocator &) = delete;
+
+    void *
+    Malloc(size_t size)
+    {
+        if (size == 0) {
+            return nullptr;
+        }
+
+        size = Align(size);
+
+        if (this->blocks_.empty() ||
+            this->offset_ + size > this->blocks_[this->current_].size) {
+            this->nextBlock(size);
+        }
+
+        auto *ptr = this->blocks_[this->current_].data.get() + this->offset_;
+        this->offset_ += size;
+        this->size_ += size;
+
+        return ptr;
+    }
+
+    void *
+    Realloc(void *originalPtr, size_t originalSize, size_t newSize)
+    {
+        if (originalPtr == nullptr) {
+            return this->Malloc(newSize);
+        }
+
+        if (newSize == 0) {
+            return nullptr;
+        }
+
+        originalSize = Align(originalSize);
+        newSize = Align(newSize);
+
+        if (originalSize >= newSize) {
+            return originalPtr;
+        }
+
+        // Grow in place if this was the last allocation
+        const auto &block = this->blocks_[this->current_];
+        auto *end = block.data.get() + this->offset_;
+        if (static_cast<char *>(originalPtr) + originalSize == end &&
+            this->offset_ + (newSize - originalSize) <= block.size) {
+            this->offset_ += newSize - originalSize;
+            this->size_ += newSize - originalSize;
+            return originalPtr;
+        }
+
+        void *newBuffer = this->Malloc(newSize);
+        std::memcpy(newBuffer, originalPtr, originalSize);
+        return newBuffer;
+    }
+
+    static void
+    Free(void * /*ptr*/)
+    {
+    }
+
+    // Invalidate everything allocated so far, keeping the blocks around for
+    // reuse
+    void
+    Reset()
+    {
+        this->current_ = 0;
+        this->offset_ = 0;
+        this->size_ = 0;
+    }
+
+    // Number of bytes handed out since the last reset
+    size_t
+    Size() const
+    {
+        return this->size_;
+    }
+
+    // Number of bytes reserved in blocks
+    size_t
+    Capacity() const
+    {
+        size_t capacity = 0;
+        for (const auto &block : this->blocks_) {
+            capacity += block.size;
+        }
+        return capacity;
+    }
+
+    bool
+    operator==(const ArenaAllocator &rhs) const
+    {
+        return this == &rhs;
+    }
+
+    bool
+    operator!=(const ArenaAllocator &rhs) const
+    {
+        return !this->operator==(rhs);
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    static size_t
+    Align(size_t size)
+    {
+        return RAPIDJSON_ALIGN(size);
+    }
+
+    // Move on to a block with room for size bytes, reusing the blocks left
+    // over from before the last reset where possible
+    void
+    nextBlock(size_t size)
+    {
+        size_t next = this->blocks_.empty() ? 0 : this->current_ + 1;
+        while (next < this->blocks_.size() && this->blocks_[next].size < size) {
+            ++next;
+        }
+
+        if (next == this->blocks_.size()) {
+            auto blockSize = std::max(this->blockSize_, size);
+            // Not value-initialized, the memory is overwritten anyway
+            this->blocks_.push_back(
+                {std::unique_ptr<char[]>(new char[blockSize]), blockSize});
+        }
+
+        // Blocks that were skipped over stay unused until the next reset
+        this->current_ = next;
+        this->offset_ = 0;
+    }
+
+    size_t blockSize_;
+    std::vector<Block> blocks_;
+    size_t current_ = 0;
+    size_t offset_ = 0;
+    size_t size_ = 0;
+};
+
+}  // namespace pajlada
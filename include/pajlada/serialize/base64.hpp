@@ -0,0 +1,336 @@
+#pragma once
+
+#include <rapidjson/document.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <pajlada/serialize/common.hpp>
+#include <pajlada/serialize/deserialize-from.hpp>
+#include <pajlada/serialize/deserialize.hpp>
+#include <pajlada/serialize/serialize-to.hpp>
+#include <pajlada/serialize/serialize.hpp>
+#include <pajlada/serialize/variant.hpp>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace pajlada {
+
+// A vector of numbers that is serialized as a base64 string (RFC 4648, with
+// padding) of its elements' bytes instead of an array of numbers.
+//
+// Elements are stored in little endian byte order, whatever the platform.
+// The string is a third larger than the data, where an array of numbers can
+// be several times larger, and it's decoded without converting any numbers.
+// Deserialize still accepts the array form, so existing documents keep
+// loading, e.g.
+//
+//   struct Emote {
+//       std::string name;
+//       Base64<std::vector<uint8_t>> image;
+//   };
+//
+// Strings that aren't valid base64, or whose length isn't a multiple of the
+// element size, are reported as errors.
+template <typename Type>
+struct Base64 {
+    static_assert(
+        std::is_same<Type, std::vector<typename Type::value_type>>::value &&
+            detail::IsNumber<typename Type::value_type>,
+        "Base64 only supports std::vector of numbers");
+
+    Type value{};
+
+    bool operator==(const Base64 &other) const = default;
+};
+
+namespace detail {
+
+inline constexpr char Base64Alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Both characters for every 12 bits, so a 3 byte group takes two lookups
+inline constexpr auto Base64PairTable = [] {
+    std::array<std::array<char, 2>, 4096> table{};
+    for (size_t i = 0; i < table.size(); ++i) {
+        table[i] = {Base64Alphabet[i >> 6], Base64Alphabet[i & 0x3F]};
+    }
+    return table;
+}();
+
+// The 6 bits of each character, 0xFF for characters outside the alphabet
+inline constexpr auto Base64DecodeTable = [] {
+    std::array<uint8_t, 256> table{};
+    table.fill(0xFF);
+    for (uint8_t i = 0; i < 64; ++i) {
+        table[static_cast<unsigned char>(Base64Alphabet[i])] = i;
+    }
+    return table;
+}();
+
+constexpr size_t
+Base64EncodedSize(size_t bytes)
+{
+    return (bytes + 2) / 3 * 4;
+}
+
+// Writes Base64EncodedSize(size) characters to out
+inline void
+Base64Encode(const unsigned char *in, size_t size, char *out)
+{
+    const auto &pairs = Base64PairTable;
+
+    size_t i = 0;
+    for (; i + 3 <= size; i += 3, out += 4) {
+        uint32_t group = (uint32_t(in[i]) << 16) |
+                         (uint32_t(in[i + 1]) << 8) | uint32_t(in[i + 2]);
+        std::memcpy(out, pairs[group >> 12].data(), 2);
+        std::memcpy(out + 2, pairs[group & 0xFFF].data(), 2);
+    }
+
+    if (i == size) {
+        return;
+    }
+
+    uint32_t group = uint32_t(in[i]) << 16;
+    if (i + 1 < size) {
+        group |= uint32_t(in[i + 1]) << 8;
+    }
+
+    std::memcpy(out, pairs[group >> 12].data(), 2);
+    out[2] = i + 1 < size ? pairs[group & 0xFFF][0] : '=';
+    out[3] = '=';
+}
+
+// Returns the number of bytes text decodes to, or false if no base64 string
+// has its length. Padding is optional
+inline bool
+Base64DecodedSize(std::string_view text, size_t &size)
+{
+    if (!text.empty() && text.size() % 4 == 0) {
+        text.remove_suffix(text.back() == '=' ? 1 : 0);
+        text.remove_suffix(text.back() == '=' ? 1 : 0);
+    }
+
+    auto rest = text.size() % 4;
+    if (rest == 1) {
+        return false;
+    }
+
+    size = text.size() / 4 * 3 + (rest == 0 ? 0 : rest - 1);
+    return true;
+}
+
+// Writes size bytes, as returned by Base64DecodedSize, to out. Returns false
+// if text contains characters outside the alphabet
+inline bool
+Base64Decode(std::string_view text, size_t size, unsigned char *out)
+{
+    const auto &table = Base64DecodeTable;
+    const auto *in = reinterpret_cast<const unsigned char *>(text.data());
+
+    // Invalid characters are only checked for once at the end rather than in
+    // every group
+    uint8_t invalid = 0;
+
+    size_t i = 0;
+    size_t o = 0;
+    for (; o + 3 <= size; i += 4, o += 3) {
+        auto c0 = table[in[i]];
+        auto c1 = table[in[i + 1]];
+        auto c2 = table[in[i + 2]];
+        auto c3 = table[in[i + 3]];
+        invalid |= c0 | c1 | c2 | c3;
+
+        uint32_t group = (uint32_t(c0) << 18) | (uint32_t(c1) << 12) |
+                         (uint32_t(c2) << 6) | uint32_t(c3);
+        out[o] = static_cast<unsigned char>(group >> 16);
+        out[o + 1] = static_cast<unsigned char>(group >> 8);
+        out[o + 2] = static_cast<unsigned char>(group);
+    }
+
+    if (o < size) {
+        auto c0 = table[in[i]];
+        auto c1 = table[in[i + 1]];
+        auto c2 = o + 1 < size ? table[in[i + 2]] : uint8_t(0);
+        invalid |= c0 | c1 | c2;
+
+        uint32_t group =
+            (uint32_t(c0) << 18) | (uint32_t(c1) << 12) | (uint32_t(c2) << 6);
+        out[o] = static_cast<unsigned char>(group >> 16);
+        if (o + 1 < size) {
+            out[o + 1] = static_cast<unsigned char>(group >> 8);
+        }
+    }
+
+    return (invalid & 0x80) == 0;
+}
+
+// Reverses the bytes of each element, for big endian platforms
+template <typename ValueType>
+void
+SwapBytes(ValueType *values, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        auto *bytes = reinterpret_cast<unsigned char *>(values + i);
+        std::reverse(bytes, bytes + sizeof(ValueType));
+    }
+}
+
+template <typename ValueType>
+constexpr bool NeedsByteSwap =
+    sizeof(ValueType) > 1 && std::endian::native != std::endian::little;
+
+// Writes Base64EncodedSize of the bytes of values to out
+template <typename ValueType>
+void
+EncodeBase64Elements(const std::vector<ValueType> &values, char *out)
+{
+    const auto size = values.size() * sizeof(ValueType);
+
+    if constexpr (NeedsByteSwap<ValueType>) {
+        auto swapped = values;
+        SwapBytes(swapped.data(), swapped.size());
+        Base64Encode(reinterpret_cast<const unsigned char *>(swapped.data()),
+                     size, out);
+    } else {
+        Base64Encode(reinterpret_cast<const unsigned char *>(values.data()),
+                     size, out);
+    }
+}
+
+template <typename ValueType>
+bool
+DecodeBase64Elements(std::string_view text, std::vector<ValueType> &out)
+{
+    size_t size = 0;
+    if (!Base64DecodedSize(text, size) || size % sizeof(ValueType) != 0) {
+        out.clear();
+        return false;
+    }
+
+    out.resize(size / sizeof(ValueType));
+    if (!Base64Decode(text, size,
+                      reinterpret_cast<unsigned char *>(out.data()))) {
+        out.clear();
+        return false;
+    }
+
+    if constexpr (NeedsByteSwap<ValueType>) {
+        SwapBytes(out.data(), out.size());
+    }
+
+    return true;
+}
+
+}  // namespace detail
+
+template <typename Type>
+struct JsonKinds<Base64<Type>> {
+    static constexpr unsigned value = JsonKind::String | JsonKind::Array;
+};
+
+template <typename Type, typename RJValue>
+struct Serialize<Base64<Type>, RJValue> {
+    static RJValue
+    get(const Base64<Type> &value, typename RJValue::AllocatorType &a)
+    {
+        const auto size = detail::Base64EncodedSize(
+            value.value.size() * sizeof(typename Type::value_type));
+
+        if constexpr (!RJValue::AllocatorType::kNeedFree) {
+            // a never frees its memory on its own, so the string can be
+            // encoded straight into it instead of being copied there
+            auto *buffer = static_cast<char *>(a.Malloc(size + 1));
+            detail::EncodeBase64Elements(value.value, buffer);
+            buffer[size] = '\0';
+            return RJValue(rapidjson::StringRef(buffer, size));
+        } else {
+            std::string text(size, '\0');
+            detail::EncodeBase64Elements(value.value, text.data());
+            return RJValue(text.data(),
+                           static_cast<rapidjson::SizeType>(size), a);
+        }
+    }
+};
+
+template <typename Type, typename RJValue>
+struct Deserialize<Base64<Type>, RJValue> {
+    static Base64<Type>
+    get(const RJValue &value, bool *error = nullptr)
+    {
+        Base64<Type> ret;
+        into(ret, value, error);
+        return ret;
+    }
+
+    static void
+    into(Base64<Type> &target, const RJValue &value, bool *error = nullptr)
+    {
+        if (value.IsArray()) {
+            detail::DeserializeInto<Type, RJValue>(target.value, value, error);
+            return;
+        }
+
+        if (!value.IsString() ||
+            !detail::DecodeBase64Elements(
+                {value.GetString(), value.GetStringLength()}, target.value)) {
+            PAJLADA_REPORT_ERROR(error)
+            target.value.clear();
+        }
+    }
+};
+
+template <typename Type>
+struct SerializeTo<Base64<Type>> {
+    template <typename Handler>
+    static bool
+    write(const Base64<Type> &value, Handler &handler)
+    {
+        const auto size = detail::Base64EncodedSize(
+            value.value.size() * sizeof(typename Type::value_type));
+
+        if constexpr (requires {
+                          handler.RawValue("", 0, rapidjson::kNullType);
+                      }) {
+            // Nothing in the alphabet needs escaping, so the quoted string
+            // can skip the writer's escaping pass
+            std::string text(size + 2, '"');
+            detail::EncodeBase64Elements(value.value, text.data() + 1);
+            return handler.RawValue(text.data(), text.size(),
+                                    rapidjson::kStringType);
+        } else {
+            std::string text(size, '\0');
+            detail::EncodeBase64Elements(value.value, text.data());
+            return handler.String(
+                text.data(), static_cast<rapidjson::SizeType>(size), true);
+        }
+    }
+};
+
+template <typename Type>
+struct DeserializeFrom<Base64<Type>> {
+    static bool
+    start(SaxContext &ctx, Base64<Type> &out, const SaxEvent &e)
+    {
+        if (e.kind == SaxEvent::Kind::StartArray) {
+            return DeserializeFrom<Type>::start(ctx, out.value, e);
+        }
+
+        if (e.kind != SaxEvent::Kind::String ||
+            !detail::DecodeBase64Elements(e.str, out.value)) {
+            out.value.clear();
+            ctx.reportError();
+            ctx.skip(e);
+        }
+
+        return true;
+    }
+};
+
+}  // namespace pajlada
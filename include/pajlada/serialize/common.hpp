@@ -2,7 +2,16 @@
 
 #include <rapidjson/document.h>
 
+#include <algorithm>
+#include <charconv>
 #include <cmath>
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
 
 #ifndef PAJLADA_REPORT_ERROR
 #define PAJLADA_REPORT_ERROR(x) \
@@ -11,6 +20,18 @@
     }
 #endif
 
+#define PAJLADA_ERROR_POLICY_CONTINUE 0
+#define PAJLADA_ERROR_POLICY_FAIL_FAST 1
+
+// valid values: continue/fail fast
+// continue decodes every element of a container even after an error was
+// reported. fail fast stops decoding at the first error and records where it
+// happened in ErrorPath, see error-path.hpp
+// default: continue
+#ifndef PAJLADA_ERROR_POLICY
+#define PAJLADA_ERROR_POLICY PAJLADA_ERROR_POLICY_CONTINUE
+#endif
+
 #define PAJLADA_ROUNDING_METHOD_ROUND 0
 #define PAJLADA_ROUNDING_METHOD_CEIL 1
 #define PAJLADA_ROUNDING_METHOD_FLOOR 2
@@ -25,39 +46,240 @@ namespace pajlada {
 
 namespace detail {
 
-template <typename T1, typename T2>
-typename std::enable_if<std::is_integral<T1>::value, T1>::type
-Round(T2 value)
+// Rounds value to an integer as chosen by PAJLADA_ROUNDING_METHOD
+inline double
+RoundToInteger(double value)
 {
 #if PAJLADA_ROUNDING_METHOD == PAJLADA_ROUNDING_METHOD_ROUND
-    return static_cast<T1>(round(value));
+    return std::round(value);
 #elif PAJLADA_ROUNDING_METHOD == PAJLADA_ROUNDING_METHOD_CEIL
-    return static_cast<T1>(ceil(value));
+    return std::ceil(value);
 #elif PAJLADA_ROUNDING_METHOD == PAJLADA_ROUNDING_METHOD_FLOOR
-    return static_cast<T1>(floor(value));
+    return std::floor(value);
 #else
     static_assert(
         "Invalid rounding method selected in PAJLADA_ROUNDING_METHOD");
 #endif
 }
 
+// Numbers get fast paths in arrays, bools are integral but not numbers
+template <typename Type>
+inline constexpr bool IsNumber = std::is_arithmetic<Type>::value &&
+                                 !std::is_same<Type, bool>::value;
+
+template <typename Type>
+inline constexpr bool IsInteger =
+    std::is_integral<Type>::value && IsNumber<Type>;
+
+// Maps are written as objects, so their keys have to become member names.
+// Strings are used as they are, integers and enums are written as their
+// decimal digits, e.g. {"1": ...}
+template <typename Key>
+inline constexpr bool IsStringKey =
+    std::is_same<Key, std::string>::value ||
+    std::is_same<Key, std::string_view>::value;
+
+// Enums are read and written through their underlying type, so the ones
+// based on bool are left out like bool itself
+template <typename Key, typename Enable = void>
+inline constexpr bool IsEnumKey = false;
+
+template <typename Key>
+inline constexpr bool IsEnumKey<
+    Key, typename std::enable_if<std::is_enum<Key>::value>::type> =
+    IsInteger<typename std::underlying_type<Key>::type>;
+
+template <typename Key>
+inline constexpr bool IsNumberKey = IsInteger<Key> || IsEnumKey<Key>;
+
+template <typename Key>
+inline constexpr bool IsMapKey = IsStringKey<Key> || IsNumberKey<Key>;
+
+// Long enough for any 64-bit integer, sign included
+inline constexpr size_t MaxNumberKeyLength = 20;
+
+// MemberReserve only exists in rapidjson versions after 1.1.0. Without it
+// the members are added the same, the object just grows as they come in
+template <typename RJValue>
+inline void
+MemberReserve(RJValue &object, rapidjson::SizeType count,
+              typename RJValue::AllocatorType &a)
+{
+    if constexpr (requires { object.MemberReserve(count, a); }) {
+        object.MemberReserve(count, a);
+    }
+}
+
+// Writes the digits of key to buffer, returns how many were written
+template <typename Key>
+inline size_t
+FormatNumberKey(Key key, char (&buffer)[MaxNumberKeyLength])
+{
+    if constexpr (std::is_enum<Key>::value) {
+        return FormatNumberKey(
+            static_cast<std::underlying_type_t<Key>>(key), buffer);
+    } else {
+        auto result = std::to_chars(buffer, buffer + MaxNumberKeyLength, key);
+        return static_cast<size_t>(result.ptr - buffer);
+    }
+}
+
+// Parses a member name into key. Returns false, leaving key untouched, unless
+// all of name is an integer that fits in Key
+template <typename Key>
+inline bool
+ParseNumberKey(std::string_view name, Key &key)
+{
+    if constexpr (std::is_enum<Key>::value) {
+        std::underlying_type_t<Key> number{};
+        if (!ParseNumberKey(name, number)) {
+            return false;
+        }
+        key = static_cast<Key>(number);
+        return true;
+    } else {
+        const auto *end = name.data() + name.size();
+        Key number{};
+        auto [ptr, ec] = std::from_chars(name.data(), end, number);
+        if (ec != std::errc() || ptr != end) {
+            return false;
+        }
+        key = number;
+        return true;
+    }
+}
+
+// Chunks shouldn't be so small that handing them out costs more than
+// decoding them
+inline constexpr size_t ParallelMinChunkSize = 1024;
+
+// How a container of size elements is split up for an executor
+struct ChunkPlan {
+    size_t size = 0;
+    size_t count = 1;
+
+    // Elements [first, second) belong to chunk
+    std::pair<size_t, size_t>
+    range(size_t chunk) const
+    {
+        return {this->size * chunk / this->count,
+                this->size * (chunk + 1) / this->count};
+    }
+};
+
+// A few chunks per thread, so threads that are done early can pick up the
+// work that's left instead of waiting for the slowest one
+inline ChunkPlan
+PlanChunks(size_t size, size_t concurrency)
+{
+    auto count = std::max<size_t>(concurrency, 1) * 4;
+    count = std::min(count, std::max<size_t>(size / ParallelMinChunkSize, 1));
+
+    return {size, count};
+}
+
+// Returns true if value can be stored in Type. Like std::in_range, but char
+// types are allowed as well
+template <typename Type, typename From>
+constexpr bool
+InRange(From value)
+{
+    using Limits = std::numeric_limits<Type>;
+
+    if constexpr (std::is_signed<From>::value == std::is_signed<Type>::value) {
+        return value >= Limits::min() && value <= Limits::max();
+    } else if constexpr (std::is_signed<From>::value) {
+        return value >= 0 &&
+               static_cast<std::make_unsigned_t<From>>(value) <= Limits::max();
+    } else {
+        return value <= static_cast<std::make_unsigned_t<Type>>(Limits::max());
+    }
+}
+
+// Stores an integer of any type in out if it fits. Returns false otherwise
+template <typename Type, typename From>
+constexpr bool
+StoreInteger(Type &out, From value)
+{
+    if (!InRange<Type>(value)) {
+        return false;
+    }
+
+    out = static_cast<Type>(value);
+    return true;
+}
+
+// Rounds value and stores it in out if it fits. Returns false otherwise,
+// including for NaN and infinities
+template <typename Type>
+inline bool
+StoreRounded(Type &out, double value)
+{
+    // 2^digits, which unlike max() converts to double exactly
+    constexpr double limit =
+        static_cast<double>(std::numeric_limits<Type>::max() / 2 + 1) * 2.0;
+    constexpr double lower = std::is_signed<Type>::value ? -limit : 0.0;
+
+    // Checked after rounding, so the cast below can't overflow
+    auto rounded = RoundToInteger(value);
+    if (!(rounded >= lower && rounded < limit)) {
+        return false;
+    }
+
+    out = static_cast<Type>(rounded);
+    return true;
+}
+
+// Reads an integer of Type from value. Integers are read with the getter
+// matching Type and range checked as integers, only doubles are rounded.
+// Returns false, leaving out untouched, if value isn't a number or doesn't
+// fit in Type
+template <typename Type, typename RJValue>
+inline bool
+ReadInteger(const RJValue &value, Type &out)
+{
+    if constexpr (std::is_signed<Type>::value) {
+        if constexpr (sizeof(Type) <= sizeof(int)) {
+            if (value.IsInt()) {
+                return StoreInteger(out, value.GetInt());
+            }
+        } else {
+            if (value.IsInt64()) {
+                return StoreInteger(out, value.GetInt64());
+            }
+        }
+    } else {
+        if constexpr (sizeof(Type) <= sizeof(unsigned)) {
+            if (value.IsUint()) {
+                return StoreInteger(out, value.GetUint());
+            }
+        } else {
+            if (value.IsUint64()) {
+                return StoreInteger(out, value.GetUint64());
+            }
+        }
+    }
+
+    if (value.IsDouble()) {
+        return StoreRounded(out, value.GetDouble());
+    }
+
+    // Not a number, or an integer that is out of range for Type
+    return false;
+}
+
 template <
     typename Type, typename RJValue = rapidjson::Value,
     typename std::enable_if<std::is_integral<Type>::value>::type * = nullptr>
 Type
-GetNumber(const RJValue &value)
+GetNumber(const RJValue &value, bool *error = nullptr)
 {
-    if (value.IsDouble()) {
-        return Round<Type>(value.GetDouble());
-    }
-    if (value.IsFloat()) {
-        return Round<Type>(value.GetFloat());
-    }
-    if (value.IsInt()) {
-        return value.GetInt();
+    Type ret{};
+    if (!ReadInteger(value, ret)) {
+        PAJLADA_REPORT_ERROR(error)
     }
 
-    return Type{};
+    return ret;
 }
 
 }  // namespace detail
@@ -0,0 +1,825 @@
+#pragma once
+
+#include <rapidjson/document.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <numeric>
+#include <pajlada/serialize/common.hpp>
+#include <pajlada/serialize/deserialize-from.hpp>
+#include <pajlada/serialize/deserialize.hpp>
+#include <pajlada/serialize/error-path.hpp>
+#include <pajlada/serialize/flat-map.hpp>
+#include <pajlada/serialize/serialize-to.hpp>
+#include <pajlada/serialize/serialize.hpp>
+#include <pajlada/serialize/variant.hpp>
+#include <set>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// The standard containers besides std::vector, std::array and std::map:
+//
+// - std::deque, std::set and std::unordered_set are arrays
+// - std::unordered_map and FlatMap (std::flat_map if the standard library
+//   has it, see flat-map.hpp) are objects, keyed by strings, integers or
+//   enums like std::map
+//
+// Objects are built in bulk rather than one member at a time: unordered maps
+// reserve their buckets from MemberCount up front, and flat maps collect
+// their keys and values first and are sorted once at the end - or not at all
+// if the members were already in order, like those of a saved flat map.
+// Set elements are inserted with a hint at the end, which makes elements
+// that arrive in order cheap to insert.
+//
+// Unordered containers are written in their iteration order, which differs
+// between standard libraries.
+namespace pajlada {
+
+namespace detail {
+
+template <typename Container, typename RJValue>
+inline RJValue
+SerializeSequence(const Container &value, typename RJValue::AllocatorType &a)
+{
+    using ValueType = typename Container::value_type;
+
+    RJValue ret(rapidjson::kArrayType);
+    ret.Reserve(static_cast<rapidjson::SizeType>(value.size()), a);
+
+    for (const auto &element : value) {
+        ret.PushBack(Serialize<ValueType, RJValue>::get(element, a), a);
+    }
+
+    return ret;
+}
+
+template <typename Map, typename RJValue>
+inline RJValue
+SerializeObject(const Map &value, typename RJValue::AllocatorType &a)
+{
+    using ValueType = typename Map::mapped_type;
+
+    RJValue ret(rapidjson::kObjectType);
+    detail::MemberReserve(ret, static_cast<rapidjson::SizeType>(value.size()),
+                          a);
+
+    for (const auto &[key, innerValue] : value) {
+        ret.AddMember(MapKey<RJValue>(key, a).Move(),
+                      Serialize<ValueType, RJValue>::get(innerValue, a), a);
+    }
+
+    return ret;
+}
+
+template <typename Container, typename Handler>
+inline bool
+WriteSequence(const Container &value, Handler &handler)
+{
+    using ValueType = typename Container::value_type;
+
+    if (!handler.StartArray()) {
+        return false;
+    }
+
+    for (const auto &element : value) {
+        if (!SerializeTo<ValueType>::write(element, handler)) {
+            return false;
+        }
+    }
+
+    return handler.EndArray(static_cast<rapidjson::SizeType>(value.size()));
+}
+
+template <typename Map, typename Handler>
+inline bool
+WriteObject(const Map &value, Handler &handler)
+{
+    using ValueType = typename Map::mapped_type;
+
+    if (!handler.StartObject()) {
+        return false;
+    }
+
+    for (const auto &[key, innerValue] : value) {
+        if (!WriteKey(handler, key)) {
+            return false;
+        }
+        if (!SerializeTo<ValueType>::write(innerValue, handler)) {
+            return false;
+        }
+    }
+
+    return handler.EndObject(static_cast<rapidjson::SizeType>(value.size()));
+}
+
+// Existing elements are overwritten in place, like for std::vector
+template <typename Container, typename RJValue>
+inline void
+DeserializeSequenceInto(Container &target, const RJValue &value, bool *error)
+{
+    using ValueType = typename Container::value_type;
+
+    if (!value.IsArray()) {
+        PAJLADA_REPORT_ERROR(error)
+        target.clear();
+        return;
+    }
+
+    target.resize(value.Size());
+
+    ErrorPathScope scope;
+    size_t i = 0;
+    for (auto &element : target) {
+        DeserializeElement<ValueType, RJValue>(
+            element, value[static_cast<rapidjson::SizeType>(i)], error);
+        if (ShouldStop(error)) {
+            scope.failIndex(i);
+            return;
+        }
+        ++i;
+    }
+}
+
+// Elements that are already in the set (duplicates in the array) are
+// dropped
+template <typename Set, typename RJValue>
+inline void
+DeserializeSetInto(Set &target, const RJValue &value, bool *error)
+{
+    using ValueType = typename Set::value_type;
+
+    target.clear();
+
+    if (!value.IsArray()) {
+        PAJLADA_REPORT_ERROR(error)
+        return;
+    }
+
+    if constexpr (requires { target.reserve(size_t{}); }) {
+        target.reserve(value.Size());
+    }
+
+    ErrorPathScope scope;
+    for (rapidjson::SizeType i = 0; i < value.Size(); ++i) {
+        ValueType element{};
+        DeserializeElement<ValueType, RJValue>(element, value[i], error);
+        if (ShouldStop(error)) {
+            scope.failIndex(i);
+            return;
+        }
+
+        target.insert(target.end(), std::move(element));
+    }
+}
+
+// Entries whose key is still present keep their node, and with it whatever
+// capacity their value has. For duplicate keys the first member wins, like
+// for std::map
+template <typename Map, typename RJValue>
+inline void
+DeserializeUnorderedMapInto(Map &target, const RJValue &value, bool *error)
+{
+    using ValueType = typename Map::mapped_type;
+
+    if (!value.IsObject()) {
+        PAJLADA_REPORT_ERROR(error)
+        target.clear();
+        return;
+    }
+
+    Map previous;
+    previous.swap(target);
+    target.reserve(value.MemberCount());
+
+    // Reused for every key, so looking up keys doesn't allocate
+    typename Map::key_type key{};
+    ErrorPathScope scope;
+
+    for (typename RJValue::ConstMemberIterator it = value.MemberBegin();
+         it != value.MemberEnd(); ++it) {
+        if (!AssignKey(key, it->name)) {
+            PAJLADA_REPORT_ERROR(error)
+            if (ShouldStop(error)) {
+                scope.failKey(it->name);
+                return;
+            }
+            continue;
+        }
+
+        if (auto node = previous.extract(key); !node.empty()) {
+            DeserializeInto<ValueType, RJValue>(node.mapped(), it->value,
+                                                error);
+            target.insert(std::move(node));
+        } else {
+            auto [entry, inserted] = target.try_emplace(key);
+            if (!inserted) {
+                continue;
+            }
+            DeserializeInto<ValueType, RJValue>(entry->second, it->value,
+                                                error);
+        }
+
+        if (ShouldStop(error)) {
+            scope.failKey(it->name);
+            return;
+        }
+    }
+}
+
+// Adds the elements of an array to a set once the array is complete.
+// Elements are staged in a deque since set elements can't be changed after
+// they are inserted, and the frames of nested values need a stable target
+template <typename Set>
+class SetFrame : public SaxFrame
+{
+public:
+    explicit SetFrame(Set &out)
+        : out_(out)
+    {
+    }
+
+    bool
+    event(SaxContext &ctx, const SaxEvent &e) override
+    {
+        if (e.kind != SaxEvent::Kind::EndArray) {
+            return DeserializeFrom<typename Set::value_type>::start(
+                ctx, this->staged_.emplace_back(), e);
+        }
+
+        if constexpr (requires { this->out_.reserve(size_t{}); }) {
+            this->out_.reserve(this->staged_.size());
+        }
+
+        for (auto &element : this->staged_) {
+            this->out_.insert(this->out_.end(), std::move(element));
+        }
+
+        ctx.pop();
+        return true;
+    }
+
+private:
+    Set &out_;
+    std::deque<typename Set::value_type> staged_;
+};
+
+}  // namespace detail
+
+template <typename ValueType, typename Allocator>
+struct JsonKinds<std::deque<ValueType, Allocator>> {
+    static constexpr unsigned value = JsonKind::Array;
+};
+
+template <typename Key, typename Compare, typename Allocator>
+struct JsonKinds<std::set<Key, Compare, Allocator>> {
+    static constexpr unsigned value = JsonKind::Array;
+};
+
+template <typename Key, typename Hash, typename KeyEqual, typename Allocator>
+struct JsonKinds<std::unordered_set<Key, Hash, KeyEqual, Allocator>> {
+    static constexpr unsigned value = JsonKind::Array;
+};
+
+template <typename Key, typename ValueType, typename Hash, typename KeyEqual,
+          typename Allocator>
+struct JsonKinds<
+    std::unordered_map<Key, ValueType, Hash, KeyEqual, Allocator>> {
+    static constexpr unsigned value = JsonKind::Object;
+};
+
+// std::deque
+
+template <typename ValueType, typename Allocator, typename RJValue>
+struct Serialize<std::deque<ValueType, Allocator>, RJValue> {
+    static RJValue
+    get(const std::deque<ValueType, Allocator> &value,
+        typename RJValue::AllocatorType &a)
+    {
+        return detail::SerializeSequence<std::deque<ValueType, Allocator>,
+                                         RJValue>(value, a);
+    }
+};
+
+template <typename ValueType, typename Allocator, typename RJValue>
+struct Deserialize<std::deque<ValueType, Allocator>, RJValue> {
+    static std::deque<ValueType, Allocator>
+    get(const RJValue &value, bool *error = nullptr)
+    {
+        std::deque<ValueType, Allocator> ret;
+        into(ret, value, error);
+        return ret;
+    }
+
+    static void
+    into(std::deque<ValueType, Allocator> &target, const RJValue &value,
+         bool *error = nullptr)
+    {
+        detail::DeserializeSequenceInto(target, value, error);
+    }
+};
+
+template <typename ValueType, typename Allocator>
+struct SerializeTo<std::deque<ValueType, Allocator>> {
+    template <typename Handler>
+    static bool
+    write(const std::deque<ValueType, Allocator> &value, Handler &handler)
+    {
+        return detail::WriteSequence(value, handler);
+    }
+};
+
+template <typename ValueType, typename Allocator>
+struct DeserializeFrom<std::deque<ValueType, Allocator>> {
+    static bool
+    start(SaxContext &ctx, std::deque<ValueType, Allocator> &out,
+          const SaxEvent &e)
+    {
+        out.clear();
+
+        if (e.kind != SaxEvent::Kind::StartArray) {
+            ctx.reportError();
+            ctx.skip(e);
+            return true;
+        }
+
+        ctx.push<detail::VectorFrame<ValueType,
+                                     std::deque<ValueType, Allocator>>>(out);
+        return true;
+    }
+};
+
+// std::set and std::unordered_set
+
+template <typename Key, typename Compare, typename Allocator,
+          typename RJValue>
+struct Serialize<std::set<Key, Compare, Allocator>, RJValue> {
+    static RJValue
+    get(const std::set<Key, Compare, Allocator> &value,
+        typename RJValue::AllocatorType &a)
+    {
+        return detail::SerializeSequence<std::set<Key, Compare, Allocator>,
+                                         RJValue>(value, a);
+    }
+};
+
+template <typename Key, typename Compare, typename Allocator,
+          typename RJValue>
+struct Deserialize<std::set<Key, Compare, Allocator>, RJValue> {
+    static std::set<Key, Compare, Allocator>
+    get(const RJValue &value, bool *error = nullptr)
+    {
+        std::set<Key, Compare, Allocator> ret;
+        into(ret, value, error);
+        return ret;
+    }
+
+    static void
+    into(std::set<Key, Compare, Allocator> &target, const RJValue &value,
+         bool *error = nullptr)
+    {
+        detail::DeserializeSetInto(target, value, error);
+    }
+};
+
+template <typename Key, typename Compare, typename Allocator>
+struct SerializeTo<std::set<Key, Compare, Allocator>> {
+    template <typename Handler>
+    static bool
+    write(const std::set<Key, Compare, Allocator> &value, Handler &handler)
+    {
+        return detail::WriteSequence(value, handler);
+    }
+};
+
+template <typename Key, typename Compare, typename Allocator>
+struct DeserializeFrom<std::set<Key, Compare, Allocator>> {
+    static bool
+    start(SaxContext &ctx, std::set<Key, Compare, Allocator> &out,
+          const SaxEvent &e)
+    {
+        out.clear();
+
+        if (e.kind != SaxEvent::Kind::StartArray) {
+            ctx.reportError();
+            ctx.skip(e);
+            return true;
+        }
+
+        ctx.push<detail::SetFrame<std::set<Key, Compare, Allocator>>>(out);
+        return true;
+    }
+};
+
+template <typename Key, typename Hash, typename KeyEqual, typename Allocator,
+          typename RJValue>
+struct Serialize<std::unordered_set<Key, Hash, KeyEqual, Allocator>,
+                 RJValue> {
+    using Set = std::unordered_set<Key, Hash, KeyEqual, Allocator>;
+
+    static RJValue
+    get(const Set &value, typename RJValue::AllocatorType &a)
+    {
+        return detail::SerializeSequence<Set, RJValue>(value, a);
+    }
+};
+
+template <typename Key, typename Hash, typename KeyEqual, typename Allocator,
+          typename RJValue>
+struct Deserialize<std::unordered_set<Key, Hash, KeyEqual, Allocator>,
+                   RJValue> {
+    using Set = std::unordered_set<Key, Hash, KeyEqual, Allocator>;
+
+    static Set
+    get(const RJValue &value, bool *error = nullptr)
+    {
+        Set ret;
+        into(ret, value, error);
+        return ret;
+    }
+
+    static void
+    into(Set &target, const RJValue &value, bool *error = nullptr)
+    {
+        detail::DeserializeSetInto(target, value, error);
+    }
+};
+
+template <typename Key, typename Hash, typename KeyEqual, typename Allocator>
+struct SerializeTo<std::unordered_set<Key, Hash, KeyEqual, Allocator>> {
+    using Set = std::unordered_set<Key, Hash, KeyEqual, Allocator>;
+
+    template <typename Handler>
+    static bool
+    write(const Set &value, Handler &handler)
+    {
+        return detail::WriteSequence(value, handler);
+    }
+};
+
+template <typename Key, typename Hash, typename KeyEqual, typename Allocator>
+struct DeserializeFrom<std::unordered_set<Key, Hash, KeyEqual, Allocator>> {
+    using Set = std::unordered_set<Key, Hash, KeyEqual, Allocator>;
+
+    static bool
+    start(SaxContext &ctx, Set &out, const SaxEvent &e)
+    {
+        out.clear();
+
+        if (e.kind != SaxEvent::Kind::StartArray) {
+            ctx.reportError();
+            ctx.skip(e);
+            return true;
+        }
+
+        ctx.push<detail::SetFrame<Set>>(out);
+        return true;
+    }
+};
+
+// std::unordered_map
+
+template <typename Key, typename ValueType, typename Hash, typename KeyEqual,
+          typename Allocator, typename RJValue>
+struct Serialize<std::unordered_map<Key, ValueType, Hash, KeyEqual, Allocator>,
+                 RJValue> {
+    static_assert(detail::IsMapKey<Key>,
+                  "Map keys must be strings, integers or enums");
+
+    using Map = std::unordered_map<Key, ValueType, Hash, KeyEqual, Allocator>;
+
+    static RJValue
+    get(const Map &value, typename RJValue::AllocatorType &a)
+    {
+        return detail::SerializeObject<Map, RJValue>(value, a);
+    }
+};
+
+template <typename Key, typename ValueType, typename Hash, typename KeyEqual,
+          typename Allocator, typename RJValue>
+struct Deserialize<
+    std::unordered_map<Key, ValueType, Hash, KeyEqual, Allocator>, RJValue,
+    typename std::enable_if<detail::IsMapKey<Key>>::type> {
+    using Map = std::unordered_map<Key, ValueType, Hash, KeyEqual, Allocator>;
+
+    static Map
+    get(const RJValue &value, bool *error = nullptr)
+    {
+        Map ret;
+        into(ret, value, error);
+        return ret;
+    }
+
+    static void
+    into(Map &target, const RJValue &value, bool *error = nullptr)
+    {
+        detail::DeserializeUnorderedMapInto(target, value, error);
+    }
+};
+
+template <typename Key, typename ValueType, typename Hash, typename KeyEqual,
+          typename Allocator>
+struct SerializeTo<
+    std::unordered_map<Key, ValueType, Hash, KeyEqual, Allocator>,
+    typename std::enable_if<detail::IsMapKey<Key>>::type> {
+    using Map = std::unordered_map<Key, ValueType, Hash, KeyEqual, Allocator>;
+
+    template <typename Handler>
+    static bool
+    write(const Map &value, Handler &handler)
+    {
+        return detail::WriteObject(value, handler);
+    }
+};
+
+template <typename Key, typename ValueType, typename Hash, typename KeyEqual,
+          typename Allocator>
+struct DeserializeFrom<
+    std::unordered_map<Key, ValueType, Hash, KeyEqual, Allocator>,
+    typename std::enable_if<detail::IsMapKey<Key>>::type> {
+    using Map = std::unordered_map<Key, ValueType, Hash, KeyEqual, Allocator>;
+
+    static bool
+    start(SaxContext &ctx, Map &out, const SaxEvent &e)
+    {
+        out.clear();
+
+        if (e.kind != SaxEvent::Kind::StartObject) {
+            ctx.reportError();
+            ctx.skip(e);
+            return true;
+        }
+
+        ctx.push<detail::MapFrame<Key, ValueType, Map>>(out);
+        return true;
+    }
+};
+
+// FlatMap
+
+namespace detail {
+
+// Builds target from keys and values in document order. Members that are
+// already in order are taken as they are, anything else is sorted once. For
+// duplicate keys the first member wins, like for std::map
+template <typename Map>
+inline void
+BuildFlatMap(Map &target, typename Map::key_container_type keys,
+             typename Map::mapped_container_type values)
+{
+    auto less = target.key_comp();
+
+    auto unordered = std::adjacent_find(keys.begin(), keys.end(),
+                                        [&](const auto &lhs, const auto &rhs) {
+                                            return !less(lhs, rhs);
+                                        });
+    if (unordered == keys.end()) {
+        target.replace(std::move(keys), std::move(values));
+        return;
+    }
+
+    std::vector<size_t> order(keys.size());
+    std::iota(order.begin(), order.end(), size_t{0});
+    std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+        return less(keys[lhs], keys[rhs]);
+    });
+    order.erase(std::unique(order.begin(), order.end(),
+                            [&](size_t lhs, size_t rhs) {
+                                return !less(keys[lhs], keys[rhs]);
+                            }),
+                order.end());
+
+    typename Map::key_container_type sortedKeys;
+    typename Map::mapped_container_type sortedValues;
+    if constexpr (requires { sortedKeys.reserve(size_t{}); }) {
+        sortedKeys.reserve(order.size());
+    }
+    if constexpr (requires { sortedValues.reserve(size_t{}); }) {
+        sortedValues.reserve(order.size());
+    }
+
+    for (auto i : order) {
+        sortedKeys.push_back(std::move(keys[i]));
+        sortedValues.push_back(std::move(values[i]));
+    }
+
+    target.replace(std::move(sortedKeys), std::move(sortedValues));
+}
+
+// Reuses the capacity of target's containers
+template <typename Map, typename RJValue>
+inline void
+DeserializeFlatMapInto(Map &target, const RJValue &value, bool *error)
+{
+    using ValueType = typename Map::mapped_type;
+
+    auto containers = std::move(target).extract();
+    containers.keys.clear();
+    containers.values.clear();
+
+    if (!value.IsObject()) {
+        PAJLADA_REPORT_ERROR(error)
+        target.replace(std::move(containers.keys),
+                       std::move(containers.values));
+        return;
+    }
+
+    if constexpr (requires { containers.keys.reserve(size_t{}); }) {
+        containers.keys.reserve(value.MemberCount());
+    }
+    if constexpr (requires { containers.values.reserve(size_t{}); }) {
+        containers.values.reserve(value.MemberCount());
+    }
+
+    ErrorPathScope scope;
+    for (typename RJValue::ConstMemberIterator it = value.MemberBegin();
+         it != value.MemberEnd(); ++it) {
+        if (!AssignKey(containers.keys.emplace_back(), it->name)) {
+            containers.keys.pop_back();
+            PAJLADA_REPORT_ERROR(error)
+            if (ShouldStop(error)) {
+                scope.failKey(it->name);
+                break;
+            }
+            continue;
+        }
+
+        ValueType innerValue{};
+        DeserializeInto<ValueType, RJValue>(innerValue, it->value, error);
+        containers.values.push_back(std::move(innerValue));
+
+        if (ShouldStop(error)) {
+            scope.failKey(it->name);
+            break;
+        }
+    }
+
+    BuildFlatMap(target, std::move(containers.keys),
+                 std::move(containers.values));
+}
+
+// Collects the members of an object, and builds the flat map once the object
+// is complete. Values are staged in a deque so the frames of nested values
+// have a stable target
+template <typename Map>
+class FlatMapFrame : public SaxFrame
+{
+public:
+    explicit FlatMapFrame(Map &out)
+        : out_(out)
+    {
+    }
+
+    bool
+    event(SaxContext &ctx, const SaxEvent &e) override
+    {
+        using Key = typename Map::key_type;
+        using ValueType = typename Map::mapped_type;
+
+        if (e.kind == SaxEvent::Kind::Key) {
+            // Like in MapFrame, views of keys that don't outlive the event
+            // are reported and their values skipped
+            if constexpr (IsNumberKey<Key>) {
+                Key key{};
+                this->invalidKey_ = !ParseNumberKey(e.str, key);
+                if (!this->invalidKey_) {
+                    this->keys_.push_back(key);
+                }
+            } else if constexpr (std::is_same<Key, std::string_view>::value) {
+                this->invalidKey_ = e.copy;
+                if (!e.copy) {
+                    this->keys_.emplace_back(e.str);
+                }
+            } else {
+                this->keys_.emplace_back(e.str);
+            }
+
+            if (this->invalidKey_) {
+                ctx.reportError();
+            }
+            return true;
+        }
+
+        if (e.kind != SaxEvent::Kind::EndObject) {
+            if (this->invalidKey_) {
+                ctx.skip(e);
+                return true;
+            }
+            return DeserializeFrom<ValueType>::start(
+                ctx, this->staged_.emplace_back(), e);
+        }
+
+        typename Map::mapped_container_type values;
+        for (auto &value : this->staged_) {
+            values.push_back(std::move(value));
+        }
+
+        BuildFlatMap(this->out_, std::move(this->keys_), std::move(values));
+        ctx.pop();
+        return true;
+    }
+
+private:
+    Map &out_;
+    typename Map::key_container_type keys_;
+    std::deque<typename Map::mapped_type> staged_;
+    bool invalidKey_ = false;
+};
+
+}  // namespace detail
+
+template <typename Key, typename ValueType, typename Compare,
+          typename KeyContainer, typename MappedContainer>
+struct JsonKinds<
+    FlatMap<Key, ValueType, Compare, KeyContainer, MappedContainer>> {
+    static constexpr unsigned value = JsonKind::Object;
+};
+
+template <typename Key, typename ValueType, typename Compare,
+          typename KeyContainer, typename MappedContainer, typename RJValue>
+struct Serialize<
+    FlatMap<Key, ValueType, Compare, KeyContainer, MappedContainer>,
+    RJValue> {
+    static_assert(detail::IsMapKey<Key>,
+                  "Map keys must be strings, integers or enums");
+
+    using Map =
+        FlatMap<Key, ValueType, Compare, KeyContainer, MappedContainer>;
+
+    static RJValue
+    get(const Map &value, typename RJValue::AllocatorType &a)
+    {
+        return detail::SerializeObject<Map, RJValue>(value, a);
+    }
+};
+
+template <typename Key, typename ValueType, typename Compare,
+          typename KeyContainer, typename MappedContainer, typename RJValue>
+struct Deserialize<
+    FlatMap<Key, ValueType, Compare, KeyContainer, MappedContainer>,
+    RJValue,
+    typename std::enable_if<detail::IsMapKey<Key>>::type> {
+    using Map =
+        FlatMap<Key, ValueType, Compare, KeyContainer, MappedContainer>;
+
+    static Map
+    get(const RJValue &value, bool *error = nullptr)
+    {
+        Map ret;
+        into(ret, value, error);
+        return ret;
+    }
+
+    static void
+    into(Map &target, const RJValue &value, bool *error = nullptr)
+    {
+        detail::DeserializeFlatMapInto(target, value, error);
+    }
+};
+
+template <typename Key, typename ValueType, typename Compare,
+          typename KeyContainer, typename MappedContainer>
+struct SerializeTo<
+    FlatMap<Key, ValueType, Compare, KeyContainer, MappedContainer>,
+    typename std::enable_if<detail::IsMapKey<Key>>::type> {
+    using Map =
+        FlatMap<Key, ValueType, Compare, KeyContainer, MappedContainer>;
+
+    template <typename Handler>
+    static bool
+    write(const Map &value, Handler &handler)
+    {
+        return detail::WriteObject(value, handler);
+    }
+};
+
+template <typename Key, typename ValueType, typename Compare,
+          typename KeyContainer, typename MappedContainer>
+struct DeserializeFrom<
+    FlatMap<Key, ValueType, Compare, KeyContainer, MappedContainer>,
+    typename std::enable_if<detail::IsMapKey<Key>>::type> {
+    using Map =
+        FlatMap<Key, ValueType, Compare, KeyContainer, MappedContainer>;
+
+    static bool
+    start(SaxContext &ctx, Map &out, const SaxEvent &e)
+    {
+        out.clear();
+
+        if (e.kind != SaxEvent::Kind::StartObject) {
+            ctx.reportError();
+            ctx.skip(e);
+            return true;
+        }
+
+        ctx.push<detail::FlatMapFrame<Map>>(out);
+        return true;
+    }
+};
+
+}  // namespace pajlada
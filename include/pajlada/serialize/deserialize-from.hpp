@@ -0,0 +1,862 @@
+#pragma once
+
+#include <rapidjson/document.h>
+#include <rapidjson/reader.h>
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <pajlada/serialize/common.hpp>
+#include <pajlada/serialize/deserialize.hpp>
+#include <pajlada/serialize/error-path.hpp>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace pajlada {
+
+// DeserializeFrom is the streaming counterpart of Deserialize.
+// A rapidjson::Reader drives a SaxDeserializer, which fills the target value
+// as tokens arrive, without ever building a rapidjson::Document.
+//
+// Strings handed out by the reader are only valid for the duration of the
+// event, unless the input is parsed insitu (kParseInsituFlag with an
+// InsituStringStream). std::string_view targets, including string_view map
+// keys, are only filled from insitu strings and report an error otherwise.
+
+// A single event as delivered by rapidjson::Reader
+struct SaxEvent {
+    enum class Kind {
+        Null,
+        Bool,
+        Int,
+        Uint,
+        Int64,
+        Uint64,
+        Double,
+        String,
+        Key,
+        StartObject,
+        EndObject,
+        StartArray,
+        EndArray,
+    };
+
+    Kind kind = Kind::Null;
+
+    union {
+        bool b;
+        int i;
+        unsigned u;
+        int64_t i64;
+        uint64_t u64;
+        double d;
+        rapidjson::SizeType count = 0;
+    };
+
+    // String & Key payload
+    std::string_view str;
+
+    // false if str points into the (insitu) input buffer and outlives the
+    // event
+    bool copy = true;
+
+    bool
+    isScalar() const
+    {
+        return this->kind != Kind::Key && this->kind != Kind::StartObject &&
+               this->kind != Kind::EndObject &&
+               this->kind != Kind::StartArray &&
+               this->kind != Kind::EndArray;
+    }
+
+    bool
+    isEnd() const
+    {
+        return this->kind == Kind::EndObject || this->kind == Kind::EndArray;
+    }
+
+    // Returns a value that can be handed to Deserialize for scalar events.
+    // Nothing is allocated, strings are referenced rather than copied.
+    rapidjson::Value
+    toValue() const
+    {
+        switch (this->kind) {
+            case Kind::Bool:
+                return rapidjson::Value(this->b);
+            case Kind::Int:
+                return rapidjson::Value(this->i);
+            case Kind::Uint:
+                return rapidjson::Value(this->u);
+            case Kind::Int64:
+                return rapidjson::Value(this->i64);
+            case Kind::Uint64:
+                return rapidjson::Value(this->u64);
+            case Kind::Double:
+                return rapidjson::Value(this->d);
+            case Kind::String:
+            case Kind::Key:
+                return rapidjson::Value(rapidjson::StringRef(
+                    this->str.data(), this->str.size()));
+            default:
+                return rapidjson::Value(rapidjson::kNullType);
+        }
+    }
+};
+
+class SaxContext;
+
+// A frame consumes the events of one object or array.
+// It is pushed when its Start event arrives, receives every event up to and
+// including the matching End event, and pops itself on that End event.
+class SaxFrame
+{
+public:
+    virtual ~SaxFrame() = default;
+
+    virtual bool event(SaxContext &ctx, const SaxEvent &e) = 0;
+};
+
+class SaxContext
+{
+public:
+    explicit SaxContext(bool *error)
+        : error_(error)
+    {
+    }
+
+    bool *
+    error() const
+    {
+        return this->error_;
+    }
+
+    void
+    reportError()
+    {
+        PAJLADA_REPORT_ERROR(this->error_)
+    }
+
+    bool
+    empty() const
+    {
+        return this->frames_.empty();
+    }
+
+    template <typename Frame, typename... Args>
+    void
+    push(Args &&...args)
+    {
+        this->frames_.emplace_back(
+            std::make_unique<Frame>(std::forward<Args>(args)...));
+    }
+
+    // Destroys the top frame. A frame calling this must not touch its own
+    // members afterwards
+    void
+    pop()
+    {
+        this->frames_.pop_back();
+    }
+
+    bool
+    dispatch(const SaxEvent &e)
+    {
+        return this->frames_.back()->event(*this, e);
+    }
+
+    // Consume the value starting with e without storing it anywhere
+    void skip(const SaxEvent &e);
+
+private:
+    bool *error_;
+    std::vector<std::unique_ptr<SaxFrame>> frames_;
+};
+
+namespace detail {
+
+class SkipFrame : public SaxFrame
+{
+public:
+    bool
+    event(SaxContext &ctx, const SaxEvent &e) override
+    {
+        if (e.kind == SaxEvent::Kind::StartObject ||
+            e.kind == SaxEvent::Kind::StartArray) {
+            ++this->depth_;
+        } else if (e.isEnd()) {
+            if (this->depth_ == 0) {
+                ctx.pop();
+                return true;
+            }
+            --this->depth_;
+        }
+
+        return true;
+    }
+
+private:
+    size_t depth_ = 0;
+};
+
+// Builds a rapidjson::Value out of the events of one object/array, and hands
+// it to Deserialize once complete.
+// Used for types that have no DeserializeFrom specialization.
+template <typename Type>
+class CaptureFrame : public SaxFrame
+{
+public:
+    CaptureFrame(Type &out, const SaxEvent &start)
+        : out_(out)
+    {
+        this->open(start);
+    }
+
+    bool
+    event(SaxContext &ctx, const SaxEvent &e) override
+    {
+        auto &a = this->document_.GetAllocator();
+
+        switch (e.kind) {
+            case SaxEvent::Kind::StartObject:
+            case SaxEvent::Kind::StartArray: {
+                this->open(e);
+            } break;
+
+            case SaxEvent::Kind::EndObject: {
+                auto base = this->stack_.size() - 2 * e.count;
+                auto &object = this->stack_[base - 1];
+                MemberReserve(object, e.count, a);
+                for (auto i = base; i < this->stack_.size(); i += 2) {
+                    object.AddMember(this->stack_[i], this->stack_[i + 1], a);
+                }
+                this->stack_.erase(this->stack_.begin() + base,
+                                   this->stack_.end());
+            } break;
+
+            case SaxEvent::Kind::EndArray: {
+                auto base = this->stack_.size() - e.count;
+                auto &array = this->stack_[base - 1];
+                array.Reserve(e.count, a);
+                for (auto i = base; i < this->stack_.size(); ++i) {
+                    array.PushBack(this->stack_[i], a);
+                }
+                this->stack_.erase(this->stack_.begin() + base,
+                                   this->stack_.end());
+            } break;
+
+            case SaxEvent::Kind::String:
+            case SaxEvent::Kind::Key: {
+                if (e.copy) {
+                    this->stack_.emplace_back(
+                        e.str.data(),
+                        static_cast<rapidjson::SizeType>(e.str.size()), a);
+                } else {
+                    this->stack_.emplace_back(e.toValue());
+                }
+            } break;
+
+            default: {
+                this->stack_.emplace_back(e.toValue());
+            } break;
+        }
+
+        if (e.isEnd() && this->stack_.size() == 1) {
+            this->out_ =
+                Deserialize<Type>::get(this->stack_.front(), ctx.error());
+            ctx.pop();
+        }
+
+        return true;
+    }
+
+private:
+    void
+    open(const SaxEvent &e)
+    {
+        this->stack_.emplace_back(e.kind == SaxEvent::Kind::StartObject
+                                      ? rapidjson::kObjectType
+                                      : rapidjson::kArrayType);
+    }
+
+    Type &out_;
+    rapidjson::Document document_;
+    std::vector<rapidjson::Value> stack_;
+};
+
+// Appends the elements of an array to a std::vector, or anything else with
+// push_back and emplace_back
+template <typename ValueType, typename Container = std::vector<ValueType>>
+class VectorFrame : public SaxFrame
+{
+public:
+    explicit VectorFrame(Container &out)
+        : out_(out)
+    {
+    }
+
+    bool
+    event(SaxContext &ctx, const SaxEvent &e) override;
+
+private:
+    Container &out_;
+};
+
+// Adds the members of an object to a std::map, or anything else with
+// try_emplace
+template <typename Key, typename ValueType,
+          typename Map = std::map<Key, ValueType>>
+class MapFrame : public SaxFrame
+{
+public:
+    explicit MapFrame(Map &out)
+        : out_(out)
+    {
+    }
+
+    bool
+    event(SaxContext &ctx, const SaxEvent &e) override;
+
+private:
+    Map &out_;
+    Key key_{};
+
+    // Set for string_view keys that would not outlive the event, and for
+    // names that aren't a valid number key
+    bool invalidKey_ = false;
+
+    // Target for duplicate keys, the first occurrence wins just like in
+    // Deserialize
+    ValueType discard_{};
+};
+
+template <typename ValueType, size_t Size>
+class ArrayFrame : public SaxFrame
+{
+public:
+    explicit ArrayFrame(std::array<ValueType, Size> &out)
+        : out_(out)
+    {
+    }
+
+    bool
+    event(SaxContext &ctx, const SaxEvent &e) override;
+
+private:
+    std::array<ValueType, Size> &out_;
+    size_t index_ = 0;
+};
+
+template <typename Arg1, typename Arg2>
+class PairFrame : public SaxFrame
+{
+public:
+    explicit PairFrame(std::pair<Arg1, Arg2> &out)
+        : out_(out)
+    {
+    }
+
+    bool
+    event(SaxContext &ctx, const SaxEvent &e) override;
+
+private:
+    std::pair<Arg1, Arg2> &out_;
+    size_t index_ = 0;
+};
+
+}  // namespace detail
+
+inline void
+SaxContext::skip(const SaxEvent &e)
+{
+    if (e.kind == SaxEvent::Kind::StartObject ||
+        e.kind == SaxEvent::Kind::StartArray) {
+        this->push<detail::SkipFrame>();
+    }
+}
+
+// Consume the value starting with event e into out.
+// Scalars are decoded through Deserialize directly from the event, objects
+// and arrays are captured into a temporary value first
+template <typename Type, typename Enable = void>
+struct DeserializeFrom {
+    static bool
+    start(SaxContext &ctx, Type &out, const SaxEvent &e)
+    {
+        if (e.isScalar()) {
+            out = Deserialize<Type>::get(e.toValue(), ctx.error());
+            return true;
+        }
+
+        ctx.push<detail::CaptureFrame<Type>>(out, e);
+        return true;
+    }
+};
+
+template <typename ValueType>
+struct DeserializeFrom<std::vector<ValueType>> {
+    static bool
+    start(SaxContext &ctx, std::vector<ValueType> &out, const SaxEvent &e)
+    {
+        out.clear();
+
+        if (e.kind != SaxEvent::Kind::StartArray) {
+            ctx.reportError();
+            ctx.skip(e);
+            return true;
+        }
+
+        ctx.push<detail::VectorFrame<ValueType>>(out);
+        return true;
+    }
+};
+
+// Views are only handed out for strings that live in the (insitu) input
+// buffer. Anything else would dangle once the event is over, so it's reported
+// as an error instead
+template <>
+struct DeserializeFrom<std::string_view> {
+    static bool
+    start(SaxContext &ctx, std::string_view &out, const SaxEvent &e)
+    {
+        out = {};
+
+        if (e.kind != SaxEvent::Kind::String || e.copy) {
+            ctx.reportError();
+            ctx.skip(e);
+            return true;
+        }
+
+        out = e.str;
+        return true;
+    }
+};
+
+template <typename Key, typename ValueType>
+struct DeserializeFrom<
+    std::map<Key, ValueType>,
+    typename std::enable_if<detail::IsMapKey<Key>>::type> {
+    static bool
+    start(SaxContext &ctx, std::map<Key, ValueType> &out, const SaxEvent &e)
+    {
+        out.clear();
+
+        if (e.kind != SaxEvent::Kind::StartObject) {
+            ctx.reportError();
+            ctx.skip(e);
+            return true;
+        }
+
+        ctx.push<detail::MapFrame<Key, ValueType>>(out);
+        return true;
+    }
+};
+
+template <typename ValueType, size_t Size>
+struct DeserializeFrom<std::array<ValueType, Size>> {
+    static bool
+    start(SaxContext &ctx, std::array<ValueType, Size> &out,
+          const SaxEvent &e)
+    {
+        out = {};
+
+        if (e.kind != SaxEvent::Kind::StartArray) {
+            ctx.reportError();
+            ctx.skip(e);
+            return true;
+        }
+
+        ctx.push<detail::ArrayFrame<ValueType, Size>>(out);
+        return true;
+    }
+};
+
+template <typename Arg1, typename Arg2>
+struct DeserializeFrom<std::pair<Arg1, Arg2>> {
+    static bool
+    start(SaxContext &ctx, std::pair<Arg1, Arg2> &out, const SaxEvent &e)
+    {
+        out = std::make_pair(Arg1(), Arg2());
+
+        if (e.kind != SaxEvent::Kind::StartArray) {
+            ctx.reportError();
+            ctx.skip(e);
+            return true;
+        }
+
+        ctx.push<detail::PairFrame<Arg1, Arg2>>(out);
+        return true;
+    }
+};
+
+template <class InnerType>
+struct DeserializeFrom<std::optional<InnerType>> {
+    static bool
+    start(SaxContext &ctx, std::optional<InnerType> &out, const SaxEvent &e)
+    {
+        if (e.kind == SaxEvent::Kind::Null) {
+            out.reset();
+            return true;
+        }
+
+        return DeserializeFrom<InnerType>::start(ctx, out.emplace(), e);
+    }
+};
+
+namespace detail {
+
+// Stores an integer event in a number of any type if it fits
+template <typename Type, typename From>
+inline bool
+StoreNumber(Type &out, From value)
+{
+    if constexpr (std::is_floating_point<Type>::value) {
+        out = static_cast<Type>(value);
+        return true;
+    } else {
+        return StoreInteger(out, value);
+    }
+}
+
+// Numbers in arrays are stored straight away instead of going through a
+// rapidjson::Value and Deserialize. Returns false for any other event, and
+// for numbers that don't fit in Type
+template <typename Type>
+inline bool
+NumberFromEvent(Type &out, const SaxEvent &e)
+{
+    switch (e.kind) {
+        case SaxEvent::Kind::Int:
+            return StoreNumber(out, e.i);
+        case SaxEvent::Kind::Uint:
+            return StoreNumber(out, e.u);
+        case SaxEvent::Kind::Int64:
+            return StoreNumber(out, e.i64);
+        case SaxEvent::Kind::Uint64:
+            return StoreNumber(out, e.u64);
+        case SaxEvent::Kind::Double:
+            if constexpr (std::is_floating_point<Type>::value) {
+                out = static_cast<Type>(e.d);
+                return true;
+            } else {
+                return StoreRounded(out, e.d);
+            }
+        default:
+            return false;
+    }
+}
+
+template <typename ValueType, typename Container>
+bool
+VectorFrame<ValueType, Container>::event(SaxContext &ctx, const SaxEvent &e)
+{
+    if (e.kind == SaxEvent::Kind::EndArray) {
+        ctx.pop();
+        return true;
+    }
+
+    if constexpr (std::is_same<ValueType, bool>::value) {
+        // std::vector<bool> hands out proxies rather than references
+        bool b = false;
+        if (e.isScalar()) {
+            b = Deserialize<bool>::get(e.toValue(), ctx.error());
+        } else {
+            ctx.reportError();
+            ctx.skip(e);
+        }
+        this->out_.push_back(b);
+        return true;
+    } else {
+        if constexpr (IsNumber<ValueType>) {
+            ValueType number{};
+            if (NumberFromEvent(number, e)) {
+                this->out_.push_back(number);
+                return true;
+            }
+        }
+
+        // The element stays put until its own frame (if any) is done, since
+        // nothing else is appended in the meantime
+        return DeserializeFrom<ValueType>::start(
+            ctx, this->out_.emplace_back(), e);
+    }
+}
+
+template <typename Key, typename ValueType, typename Map>
+bool
+MapFrame<Key, ValueType, Map>::event(SaxContext &ctx, const SaxEvent &e)
+{
+    if (e.kind == SaxEvent::Kind::EndObject) {
+        ctx.pop();
+        return true;
+    }
+
+    if (e.kind == SaxEvent::Kind::Key) {
+        if constexpr (IsNumberKey<Key>) {
+            this->invalidKey_ = !ParseNumberKey(e.str, this->key_);
+            if (this->invalidKey_) {
+                ctx.reportError();
+            }
+        } else if constexpr (std::is_same<Key, std::string_view>::value) {
+            this->invalidKey_ = e.copy;
+            if (e.copy) {
+                ctx.reportError();
+            }
+            this->key_ = e.str;
+        } else {
+            this->key_.assign(e.str.data(), e.str.size());
+        }
+        return true;
+    }
+
+    if (this->invalidKey_) {
+        ctx.skip(e);
+        return true;
+    }
+
+    auto [it, inserted] = this->out_.try_emplace(this->key_);
+    if (!inserted) {
+        return DeserializeFrom<ValueType>::start(ctx, this->discard_, e);
+    }
+
+    return DeserializeFrom<ValueType>::start(ctx, it->second, e);
+}
+
+template <typename ValueType, size_t Size>
+bool
+ArrayFrame<ValueType, Size>::event(SaxContext &ctx, const SaxEvent &e)
+{
+    if (e.kind == SaxEvent::Kind::EndArray) {
+        if (this->index_ != Size) {
+            ctx.reportError();
+            this->out_ = {};
+        }
+        ctx.pop();
+        return true;
+    }
+
+    if (this->index_ >= Size) {
+        // Too many elements, keep counting so the size check fails
+        this->index_ = Size + 1;
+        ctx.skip(e);
+        return true;
+    }
+
+    if constexpr (IsNumber<ValueType>) {
+        if (NumberFromEvent(this->out_[this->index_], e)) {
+            ++this->index_;
+            return true;
+        }
+    }
+
+    return DeserializeFrom<ValueType>::start(ctx, this->out_[this->index_++],
+                                             e);
+}
+
+template <typename Arg1, typename Arg2>
+bool
+PairFrame<Arg1, Arg2>::event(SaxContext &ctx, const SaxEvent &e)
+{
+    if (e.kind == SaxEvent::Kind::EndArray) {
+        if (this->index_ != 2) {
+            ctx.reportError();
+            this->out_ = std::make_pair(Arg1(), Arg2());
+        }
+        ctx.pop();
+        return true;
+    }
+
+    switch (this->index_++) {
+        case 0:
+            return DeserializeFrom<Arg1>::start(ctx, this->out_.first, e);
+
+        case 1:
+            return DeserializeFrom<Arg2>::start(ctx, this->out_.second, e);
+
+        default:
+            ctx.skip(e);
+            return true;
+    }
+}
+
+}  // namespace detail
+
+// rapidjson Handler that deserializes the parsed JSON into out
+template <typename Type>
+class SaxDeserializer
+{
+public:
+    using Ch = char;
+
+    explicit SaxDeserializer(Type &out, bool *error = nullptr)
+        : out_(out)
+        , ctx_(error)
+    {
+    }
+
+    bool
+    Null()
+    {
+        SaxEvent e;
+        e.kind = SaxEvent::Kind::Null;
+        return this->handle(e);
+    }
+
+    bool
+    Bool(bool b)
+    {
+        SaxEvent e;
+        e.kind = SaxEvent::Kind::Bool;
+        e.b = b;
+        return this->handle(e);
+    }
+
+    bool
+    Int(int i)
+    {
+        SaxEvent e;
+        e.kind = SaxEvent::Kind::Int;
+        e.i = i;
+        return this->handle(e);
+    }
+
+    bool
+    Uint(unsigned u)
+    {
+        SaxEvent e;
+        e.kind = SaxEvent::Kind::Uint;
+        e.u = u;
+        return this->handle(e);
+    }
+
+    bool
+    Int64(int64_t i64)
+    {
+        SaxEvent e;
+        e.kind = SaxEvent::Kind::Int64;
+        e.i64 = i64;
+        return this->handle(e);
+    }
+
+    bool
+    Uint64(uint64_t u64)
+    {
+        SaxEvent e;
+        e.kind = SaxEvent::Kind::Uint64;
+        e.u64 = u64;
+        return this->handle(e);
+    }
+
+    bool
+    Double(double d)
+    {
+        SaxEvent e;
+        e.kind = SaxEvent::Kind::Double;
+        e.d = d;
+        return this->handle(e);
+    }
+
+    bool
+    RawNumber(const Ch *str, rapidjson::SizeType length, bool copy)
+    {
+        return this->String(str, length, copy);
+    }
+
+    bool
+    String(const Ch *str, rapidjson::SizeType length, bool copy)
+    {
+        SaxEvent e;
+        e.kind = SaxEvent::Kind::String;
+        e.str = {str, length};
+        e.copy = copy;
+        return this->handle(e);
+    }
+
+    bool
+    StartObject()
+    {
+        SaxEvent e;
+        e.kind = SaxEvent::Kind::StartObject;
+        return this->handle(e);
+    }
+
+    bool
+    Key(const Ch *str, rapidjson::SizeType length, bool copy)
+    {
+        SaxEvent e;
+        e.kind = SaxEvent::Kind::Key;
+        e.str = {str, length};
+        e.copy = copy;
+        return this->handle(e);
+    }
+
+    bool
+    EndObject(rapidjson::SizeType memberCount)
+    {
+        SaxEvent e;
+        e.kind = SaxEvent::Kind::EndObject;
+        e.count = memberCount;
+        return this->handle(e);
+    }
+
+    bool
+    StartArray()
+    {
+        SaxEvent e;
+        e.kind = SaxEvent::Kind::StartArray;
+        return this->handle(e);
+    }
+
+    bool
+    EndArray(rapidjson::SizeType elementCount)
+    {
+        SaxEvent e;
+        e.kind = SaxEvent::Kind::EndArray;
+        e.count = elementCount;
+        return this->handle(e);
+    }
+
+private:
+    bool
+    handle(const SaxEvent &e)
+    {
+        if (this->ctx_.empty()) {
+            // Start of the root value
+            return DeserializeFrom<Type>::start(this->ctx_, this->out_, e) &&
+                   !detail::ShouldStop(this->ctx_.error());
+        }
+
+        if (!this->ctx_.dispatch(e)) {
+            return false;
+        }
+
+        // Stops the reader, which then reports kParseErrorTermination
+        return !detail::ShouldStop(this->ctx_.error());
+    }
+
+    Type &out_;
+    SaxContext ctx_;
+};
+
+// Parse the JSON in is straight into out
+template <unsigned parseFlags = rapidjson::kParseDefaultFlags, typename Type,
+          typename InputStream>
+rapidjson::ParseResult
+DeserializeStream(InputStream &is, Type &out, bool *error = nullptr)
+{
+    SaxDeserializer<Type> handler(out, error);
+    rapidjson::Reader reader;
+
+    auto result = reader.Parse<parseFlags>(is, handler);
+    if (result.IsError()) {
+        PAJLADA_REPORT_ERROR(error)
+    }
+
+    return result;
+}
+
+}  // namespace pajlada
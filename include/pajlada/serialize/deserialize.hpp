@@ -2,15 +2,24 @@
 
 #include <rapidjson/document.h>
 
+#include <algorithm>
 #include <any>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <cmath>
+#include <cstddef>
+#include <iterator>
 #include <map>
 #include <optional>
 #include <pajlada/serialize/common.hpp>
-#include <pajlada/serialize/internal.hpp>
+#include <pajlada/serialize/error-path.hpp>
+#include <pajlada/serialize/trace.hpp>
+#include <pajlada/serialize/variant.hpp>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <typeinfo>
 #include <variant>
 #include <vector>
@@ -18,6 +27,10 @@
 namespace pajlada {
 
 // Deserialize is called when we load a json file into our library
+//
+// get returns a freshly deserialized value.
+// into overwrites an existing value in place, reusing whatever capacity it
+// already has (string buffers, vector storage, map nodes).
 
 template <typename Type, typename RJValue = rapidjson::Value,
           typename Enable = void>
@@ -31,8 +44,277 @@ struct Deserialize {
 
         return Type{};
     }
+
+    static void
+    into(Type &target, const RJValue &value, bool *error = nullptr)
+    {
+        target = get(value, error);
+    }
 };
 
+namespace detail {
+
+// Calls Deserialize<Type>::into if the specialization provides it, and falls
+// back to assigning the result of get otherwise
+template <typename Type, typename RJValue>
+inline void
+DeserializeInto(Type &target, const RJValue &value, bool *error)
+{
+    if constexpr (requires {
+                      Deserialize<Type, RJValue>::into(target, value, error);
+                  }) {
+        Deserialize<Type, RJValue>::into(target, value, error);
+    } else {
+        target = Deserialize<Type, RJValue>::get(value, error);
+    }
+}
+
+// Sets a map key from a JSON member name. string_view keys point into the
+// document instead of copying the name, and number keys are parsed straight
+// from it. Returns false if the name isn't a valid Key
+template <typename Key, typename RJValue>
+inline bool
+AssignKey(Key &key, const RJValue &name)
+{
+    if constexpr (IsNumberKey<Key>) {
+        return ParseNumberKey({name.GetString(), name.GetStringLength()},
+                              key);
+    } else if constexpr (std::is_same<Key, std::string_view>::value) {
+        key = {name.GetString(), name.GetStringLength()};
+    } else {
+        key.assign(name.GetString(), name.GetStringLength());
+    }
+
+    return true;
+}
+
+// Shared implementation of into for maps keyed by JSON member names.
+// Entries whose key is still present are overwritten in place, and the nodes
+// of removed entries are recycled for newly added keys
+template <typename Key, typename ValueType, typename RJValue>
+inline void
+DeserializeMapInto(std::map<Key, ValueType> &target, const RJValue &value,
+                   bool *error)
+{
+    using Map = std::map<Key, ValueType>;
+
+    if (!value.IsObject()) {
+        PAJLADA_REPORT_ERROR(error)
+        target.clear();
+        return;
+    }
+
+    // Reused for every key, so looking up keys doesn't allocate
+    Key key{};
+    ErrorPathScope scope;
+
+    if (target.empty()) {
+        for (typename RJValue::ConstMemberIterator it = value.MemberBegin();
+             it != value.MemberEnd(); ++it) {
+            if (!AssignKey(key, it->name)) {
+                PAJLADA_REPORT_ERROR(error)
+                if (ShouldStop(error)) {
+                    scope.failKey(it->name);
+                    return;
+                }
+                continue;
+            }
+            auto [entry, inserted] = target.try_emplace(key);
+            if (inserted) {
+                DeserializeInto<ValueType, RJValue>(entry->second, it->value,
+                                                    error);
+                if (ShouldStop(error)) {
+                    scope.failKey(it->name);
+                    return;
+                }
+            }
+        }
+        return;
+    }
+
+    // Pair up JSON members with the entries already in the map
+    std::vector<std::pair<typename Map::iterator,
+                          typename RJValue::ConstMemberIterator>>
+        matched;
+    std::vector<typename RJValue::ConstMemberIterator> added;
+    matched.reserve(std::min<size_t>(target.size(), value.MemberCount()));
+
+    for (typename RJValue::ConstMemberIterator it = value.MemberBegin();
+         it != value.MemberEnd(); ++it) {
+        if (!AssignKey(key, it->name)) {
+            PAJLADA_REPORT_ERROR(error)
+            if (ShouldStop(error)) {
+                scope.failKey(it->name);
+                return;
+            }
+            continue;
+        }
+        auto entry = target.find(key);
+        if (entry == target.end()) {
+            added.push_back(it);
+        } else {
+            matched.emplace_back(entry, it);
+        }
+    }
+
+    // Sort the matches into map order. For duplicate keys the first
+    // member wins, like in get
+    std::stable_sort(matched.begin(), matched.end(),
+                     [](const auto &lhs, const auto &rhs) {
+                         return lhs.first->first < rhs.first->first;
+                     });
+    matched.erase(std::unique(matched.begin(), matched.end(),
+                              [](const auto &lhs, const auto &rhs) {
+                                  return lhs.first == rhs.first;
+                              }),
+                  matched.end());
+
+    for (auto &[entry, member] : matched) {
+        DeserializeInto<ValueType, RJValue>(entry->second, member->value,
+                                            error);
+        if (ShouldStop(error)) {
+            scope.failKey(member->name);
+            return;
+        }
+    }
+
+    // Entries that are no longer in the JSON are detached, and their
+    // nodes are recycled for the newly added keys
+    std::vector<typename Map::node_type> spare;
+    auto nextMatch = matched.begin();
+    for (auto it = target.begin(); it != target.end();) {
+        if (nextMatch != matched.end() && nextMatch->first == it) {
+            ++nextMatch;
+            ++it;
+            continue;
+        }
+        auto next = std::next(it);
+        spare.push_back(target.extract(it));
+        it = next;
+    }
+
+    // Only members with valid keys were added
+    for (const auto &member : added) {
+        AssignKey(key, member->name);
+
+        if (spare.empty()) {
+            auto [entry, inserted] = target.try_emplace(key);
+            if (inserted) {
+                DeserializeInto<ValueType, RJValue>(entry->second,
+                                                    member->value, error);
+                if (ShouldStop(error)) {
+                    scope.failKey(member->name);
+                    return;
+                }
+            }
+            continue;
+        }
+
+        if (target.find(key) != target.end()) {
+            continue;
+        }
+
+        auto node = std::move(spare.back());
+        spare.pop_back();
+        node.key() = key;
+        DeserializeInto<ValueType, RJValue>(node.mapped(), member->value,
+                                            error);
+        target.insert(std::move(node));
+        if (ShouldStop(error)) {
+            scope.failKey(member->name);
+            return;
+        }
+    }
+}
+
+// Shared implementation of getParallel for maps keyed by JSON member names.
+// Every chunk of members is decoded into a map of its own, and those are
+// spliced together afterwards
+template <typename Key, typename ValueType, typename RJValue,
+          typename Executor>
+inline std::map<Key, ValueType>
+DeserializeMapParallel(const RJValue &value, Executor &executor, bool *error)
+{
+    using Map = std::map<Key, ValueType>;
+
+    if (!value.IsObject()) {
+        PAJLADA_REPORT_ERROR(error)
+        return {};
+    }
+
+    auto chunks = PlanChunks(value.MemberCount(), executor.concurrency());
+    if (chunks.count <= 1) {
+        Map ret;
+        DeserializeMapInto(ret, value, error);
+        return ret;
+    }
+
+    std::vector<Map> parts(chunks.count);
+    // Not std::vector<bool>, chunks finish at the same time
+    std::vector<char> chunkErrors(chunks.count, 0);
+    std::vector<ChunkPath> chunkPaths(chunks.count);
+    // Set once a chunk stopped, so the others stop as well
+    std::atomic<bool> stop{false};
+    ErrorPathScope scope;
+
+    executor.run(chunks.count, [&](size_t chunk) {
+        auto [begin, end] = chunks.range(chunk);
+        auto &part = parts[chunk];
+        ChunkPathScope chunkScope;
+        bool chunkError = false;
+        Key key{};
+
+        auto it = value.MemberBegin() + static_cast<std::ptrdiff_t>(begin);
+        for (size_t i = begin; i < end; ++i, ++it) {
+            if (stop.load(std::memory_order_relaxed)) {
+                break;
+            }
+            if (!AssignKey(key, it->name)) {
+                chunkError = true;
+                if (ShouldStop(&chunkError)) {
+                    chunkScope.failKey(it->name, chunkPaths[chunk]);
+                    stop.store(true, std::memory_order_relaxed);
+                    break;
+                }
+                continue;
+            }
+            auto [entry, inserted] = part.try_emplace(key);
+            if (inserted) {
+                DeserializeInto<ValueType, RJValue>(entry->second, it->value,
+                                                    &chunkError);
+                if (ShouldStop(&chunkError)) {
+                    chunkScope.failKey(it->name, chunkPaths[chunk]);
+                    stop.store(true, std::memory_order_relaxed);
+                    break;
+                }
+            }
+        }
+
+        chunkErrors[chunk] = chunkError;
+    });
+
+    // Merged in document order, merge leaves keys that are already present
+    // alone so for duplicate keys the first member wins, like in get
+    auto ret = std::move(parts.front());
+    for (size_t i = 1; i < parts.size(); ++i) {
+        ret.merge(parts[i]);
+    }
+
+    // The first chunk that failed has the member closest to the start
+    auto failed = std::find(chunkErrors.begin(), chunkErrors.end(), 1);
+    if (failed != chunkErrors.end()) {
+        PAJLADA_REPORT_ERROR(error)
+        if (ShouldStop(error)) {
+            scope.failChunk(chunkPaths[static_cast<size_t>(
+                std::distance(chunkErrors.begin(), failed))]);
+        }
+    }
+
+    return ret;
+}
+
+}  // namespace detail
+
 template <typename Type, typename RJValue>
 struct Deserialize<
     Type, RJValue,
@@ -40,12 +322,13 @@ struct Deserialize<
     static Type
     get(const RJValue &value, bool *error = nullptr)
     {
-        if (!value.IsNumber()) {
-            PAJLADA_REPORT_ERROR(error)
-            return Type{};
-        }
+        return detail::GetNumber<Type>(value, error);
+    }
 
-        return detail::GetNumber<Type>(value);
+    static void
+    into(Type &target, const RJValue &value, bool *error = nullptr)
+    {
+        target = get(value, error);
     }
 };
 
@@ -69,6 +352,12 @@ struct Deserialize<bool, RJValue> {
         PAJLADA_REPORT_ERROR(error)
         return false;
     }
+
+    static void
+    into(bool &target, const RJValue &value, bool *error = nullptr)
+    {
+        target = get(value, error);
+    }
 };
 
 template <typename RJValue>
@@ -87,6 +376,12 @@ struct Deserialize<double, RJValue> {
 
         return value.GetDouble();
     }
+
+    static void
+    into(double &target, const RJValue &value, bool *error = nullptr)
+    {
+        target = get(value, error);
+    }
 };
 
 template <typename RJValue>
@@ -105,8 +400,39 @@ struct Deserialize<float, RJValue> {
 
         return value.GetFloat();
     }
+
+    static void
+    into(float &target, const RJValue &value, bool *error = nullptr)
+    {
+        target = get(value, error);
+    }
 };
 
+namespace detail {
+
+// Deserializes one element of an array into target.
+// Numbers are stored straight away when they fit, anything else (including
+// errors) takes the regular path
+template <typename Type, typename RJValue>
+inline void
+DeserializeElement(Type &target, const RJValue &value, bool *error)
+{
+    if constexpr (IsInteger<Type>) {
+        if (ReadInteger(value, target)) {
+            return;
+        }
+    } else if constexpr (std::is_floating_point<Type>::value) {
+        if (value.IsNumber()) {
+            target = static_cast<Type>(value.GetDouble());
+            return;
+        }
+    }
+
+    DeserializeInto<Type, RJValue>(target, value, error);
+}
+
+}  // namespace detail
+
 template <typename RJValue>
 struct Deserialize<std::string, RJValue> {
     static std::string
@@ -117,7 +443,19 @@ struct Deserialize<std::string, RJValue> {
             return std::string{};
         }
 
-        return value.GetString();
+        return {value.GetString(), value.GetStringLength()};
+    }
+
+    static void
+    into(std::string &target, const RJValue &value, bool *error = nullptr)
+    {
+        if (!value.IsString()) {
+            PAJLADA_REPORT_ERROR(error)
+            target.clear();
+            return;
+        }
+
+        target.assign(value.GetString(), value.GetStringLength());
     }
 };
 
@@ -133,6 +471,13 @@ struct Deserialize<std::string_view, RJValue> {
 
         return {value.GetString(), value.GetStringLength()};
     }
+
+    static void
+    into(std::string_view &target, const RJValue &value,
+         bool *error = nullptr)
+    {
+        target = get(value, error);
+    }
 };
 
 template <typename ValueType, typename RJValue>
@@ -142,19 +487,94 @@ struct Deserialize<std::map<std::string, ValueType>, RJValue> {
     {
         std::map<std::string, ValueType> ret;
 
-        if (!value.IsObject()) {
-            PAJLADA_REPORT_ERROR(error)
-            return ret;
-        }
+        into(ret, value, error);
 
-        for (typename RJValue::ConstMemberIterator it = value.MemberBegin();
-             it != value.MemberEnd(); ++it) {
-            ret.emplace(it->name.GetString(),
-                        Deserialize<ValueType, RJValue>::get(it->value, error));
-        }
+        return ret;
+    }
+
+    static void
+    into(std::map<std::string, ValueType> &target, const RJValue &value,
+         bool *error = nullptr)
+    {
+        detail::DeserializeMapInto(target, value, error);
+    }
+
+    // Decodes the members on executor, see ThreadPool in parallel.hpp.
+    // Objects too small to be worth splitting up are decoded by get
+    template <typename Executor>
+    static std::map<std::string, ValueType>
+    getParallel(const RJValue &value, Executor &executor,
+                bool *error = nullptr)
+    {
+        return detail::DeserializeMapParallel<std::string, ValueType>(
+            value, executor, error);
+    }
+};
+
+// Keys point into the JSON document, see LoadInsitu
+template <typename ValueType, typename RJValue>
+struct Deserialize<std::map<std::string_view, ValueType>, RJValue> {
+    static std::map<std::string_view, ValueType>
+    get(const RJValue &value, bool *error = nullptr)
+    {
+        std::map<std::string_view, ValueType> ret;
+
+        into(ret, value, error);
 
         return ret;
     }
+
+    static void
+    into(std::map<std::string_view, ValueType> &target, const RJValue &value,
+         bool *error = nullptr)
+    {
+        detail::DeserializeMapInto(target, value, error);
+    }
+
+    // Decodes the members on executor, see ThreadPool in parallel.hpp.
+    // Objects too small to be worth splitting up are decoded by get
+    template <typename Executor>
+    static std::map<std::string_view, ValueType>
+    getParallel(const RJValue &value, Executor &executor,
+                bool *error = nullptr)
+    {
+        return detail::DeserializeMapParallel<std::string_view, ValueType>(
+            value, executor, error);
+    }
+};
+
+// Integer and enum keys are parsed from the member names, names that aren't
+// a number in range of Key are reported as errors and skipped
+template <typename Key, typename ValueType, typename RJValue>
+struct Deserialize<std::map<Key, ValueType>, RJValue,
+                   typename std::enable_if<detail::IsNumberKey<Key>>::type> {
+    static std::map<Key, ValueType>
+    get(const RJValue &value, bool *error = nullptr)
+    {
+        std::map<Key, ValueType> ret;
+
+        into(ret, value, error);
+
+        return ret;
+    }
+
+    static void
+    into(std::map<Key, ValueType> &target, const RJValue &value,
+         bool *error = nullptr)
+    {
+        detail::DeserializeMapInto(target, value, error);
+    }
+
+    // Decodes the members on executor, see ThreadPool in parallel.hpp.
+    // Objects too small to be worth splitting up are decoded by get
+    template <typename Executor>
+    static std::map<Key, ValueType>
+    getParallel(const RJValue &value, Executor &executor,
+                bool *error = nullptr)
+    {
+        return detail::DeserializeMapParallel<Key, ValueType>(value, executor,
+                                                              error);
+    }
 };
 
 template <typename ValueType, typename RJValue>
@@ -164,17 +584,105 @@ struct Deserialize<std::vector<ValueType>, RJValue> {
     {
         std::vector<ValueType> ret;
 
+        into(ret, value, error);
+
+        return ret;
+    }
+
+    static void
+    into(std::vector<ValueType> &target, const RJValue &value,
+         bool *error = nullptr)
+    {
         if (!value.IsArray()) {
             PAJLADA_REPORT_ERROR(error)
-            return ret;
+            target.clear();
+            return;
+        }
+
+        // Existing elements are overwritten in place, the rest is
+        // default-constructed in one go
+        target.resize(value.Size());
+
+        detail::ErrorPathScope scope;
+        for (rapidjson::SizeType i = 0; i < value.Size(); ++i) {
+            if constexpr (std::is_same<ValueType, bool>::value) {
+                // std::vector<bool> hands out proxies rather than references
+                target[i] = Deserialize<bool, RJValue>::get(value[i], error);
+            } else {
+                detail::DeserializeElement<ValueType, RJValue>(
+                    target[i], value[i], error);
+            }
+            if (detail::ShouldStop(error)) {
+                scope.failIndex(i);
+                return;
+            }
         }
+    }
 
-        for (const RJValue &innerValue : value.GetArray()) {
-            ret.emplace_back(
-                Deserialize<ValueType, RJValue>::get(innerValue, error));
+    // Decodes the elements on executor, see ThreadPool in parallel.hpp.
+    // Arrays too small to be worth splitting up are decoded by get
+    template <typename Executor>
+    static std::vector<ValueType>
+    getParallel(const RJValue &value, Executor &executor,
+                bool *error = nullptr)
+    {
+        if (!value.IsArray()) {
+            PAJLADA_REPORT_ERROR(error)
+            return {};
         }
 
-        return ret;
+        auto chunks =
+            detail::PlanChunks(value.Size(), executor.concurrency());
+        if (chunks.count <= 1) {
+            return get(value, error);
+        }
+
+        if constexpr (std::is_same<ValueType, bool>::value) {
+            // std::vector<bool> packs neighbouring elements into the same
+            // word, so they can't be written from different threads
+            return get(value, error);
+        } else {
+            std::vector<ValueType> ret(value.Size());
+            std::vector<char> chunkErrors(chunks.count, 0);
+            std::vector<detail::ChunkPath> chunkPaths(chunks.count);
+            // Set once a chunk stopped, so the others stop as well
+            std::atomic<bool> stop{false};
+            detail::ErrorPathScope scope;
+
+            executor.run(chunks.count, [&](size_t chunk) {
+                auto [begin, end] = chunks.range(chunk);
+                detail::ChunkPathScope chunkScope;
+                bool chunkError = false;
+
+                for (size_t i = begin; i < end; ++i) {
+                    if (stop.load(std::memory_order_relaxed)) {
+                        break;
+                    }
+                    auto index = static_cast<rapidjson::SizeType>(i);
+                    detail::DeserializeElement<ValueType, RJValue>(
+                        ret[i], value[index], &chunkError);
+                    if (detail::ShouldStop(&chunkError)) {
+                        chunkScope.failIndex(i, chunkPaths[chunk]);
+                        stop.store(true, std::memory_order_relaxed);
+                        break;
+                    }
+                }
+
+                chunkErrors[chunk] = chunkError;
+            });
+
+            // The first chunk that failed has the lowest failing index
+            auto failed = std::find(chunkErrors.begin(), chunkErrors.end(), 1);
+            if (failed != chunkErrors.end()) {
+                PAJLADA_REPORT_ERROR(error)
+                if (detail::ShouldStop(error)) {
+                    scope.failChunk(chunkPaths[static_cast<size_t>(
+                        std::distance(chunkErrors.begin(), failed))]);
+                }
+            }
+
+            return ret;
+        }
     }
 };
 
@@ -185,22 +693,37 @@ struct Deserialize<std::array<ValueType, Size>, RJValue> {
     {
         std::array<ValueType, Size> ret{};
 
+        into(ret, value, error);
+
+        return ret;
+    }
+
+    static void
+    into(std::array<ValueType, Size> &target, const RJValue &value,
+         bool *error = nullptr)
+    {
         if (!value.IsArray()) {
             PAJLADA_REPORT_ERROR(error)
-            return ret;
+            target = {};
+            return;
         }
 
         if (value.GetArray().Size() != Size) {
             PAJLADA_REPORT_ERROR(error)
-            return ret;
+            target = {};
+            return;
         }
 
         auto size = static_cast<rapidjson::SizeType>(Size);
+        detail::ErrorPathScope scope;
         for (rapidjson::SizeType i = 0; i < size; ++i) {
-            ret[i] = Deserialize<ValueType, RJValue>::get(value[i], error);
+            detail::DeserializeElement<ValueType, RJValue>(target[i],
+                                                           value[i], error);
+            if (detail::ShouldStop(error)) {
+                scope.failIndex(i);
+                return;
+            }
         }
-
-        return ret;
     }
 };
 
@@ -209,18 +732,35 @@ struct Deserialize<std::pair<Arg1, Arg2>, RJValue> {
     static std::pair<Arg1, Arg2>
     get(const RJValue &value, bool *error = nullptr)
     {
-        if (!value.IsArray()) {
-            PAJLADA_REPORT_ERROR(error)
-            return std::make_pair(Arg1(), Arg2());
-        }
+        // Decoded in order, so the second element can be skipped when the
+        // first one fails
+        std::pair<Arg1, Arg2> ret;
 
-        if (value.Size() != 2) {
+        into(ret, value, error);
+
+        return ret;
+    }
+
+    static void
+    into(std::pair<Arg1, Arg2> &target, const RJValue &value,
+         bool *error = nullptr)
+    {
+        if (!value.IsArray() || value.Size() != 2) {
             PAJLADA_REPORT_ERROR(error)
-            return std::make_pair(Arg1(), Arg2());
+            target = std::make_pair(Arg1(), Arg2());
+            return;
         }
 
-        return std::make_pair(Deserialize<Arg1, RJValue>::get(value[0], error),
-                              Deserialize<Arg2, RJValue>::get(value[1], error));
+        detail::ErrorPathScope scope;
+        detail::DeserializeInto<Arg1, RJValue>(target.first, value[0], error);
+        if (detail::ShouldStop(error)) {
+            scope.failIndex(0);
+            return;
+        }
+        detail::DeserializeInto<Arg2, RJValue>(target.second, value[1], error);
+        if (detail::ShouldStop(error)) {
+            scope.failIndex(1);
+        }
     }
 };
 
@@ -234,7 +774,7 @@ struct Deserialize<std::any, RJValue> {
         } else if (value.IsFloat() || value.IsDouble()) {
             return value.GetDouble();
         } else if (value.IsString()) {
-            return std::string(value.GetString());
+            return std::string(value.GetString(), value.GetStringLength());
         } else if (value.IsBool()) {
             return value.GetBool();
         } else if (value.IsObject()) {
@@ -248,41 +788,117 @@ struct Deserialize<std::any, RJValue> {
         PAJLADA_REPORT_ERROR(error)
         return {};
     }
+
+    static void
+    into(std::any &target, const RJValue &value, bool *error = nullptr)
+    {
+        target = get(value, error);
+    }
 };
 
 template <class... InnerTypes, typename RJValue>
 struct Deserialize<std::variant<InnerTypes...>, RJValue> {
-    static std::variant<InnerTypes...>
+    using Variant = std::variant<InnerTypes...>;
+
+    static Variant
     get(const RJValue &value, bool *error = nullptr)
     {
-        std::variant<InnerTypes...> ret;
+        Variant ret;
 
-        PSE_DEBUG("Attempting to deserialize '"
-                  << internal::pp(value) << "' into " << typeid(ret).name());
+        detail::TraceScope<Variant> trace(TraceOperation::Deserialize);
+        trace.watchError(error);
+
+        bool success = false;
+        if constexpr (VariantTag<Variant>::enabled) {
+            success = getTagged(ret, value, error, trace);
+        } else {
+            success = getUntagged(ret, value, trace,
+                                  std::index_sequence_for<InnerTypes...>{});
+        }
+
+        if (!success) {
+            trace.setError(true);
+            PAJLADA_REPORT_ERROR(error)
+            return {};
+        }
+
+        return ret;
+    }
+
+    static void
+    into(Variant &target, const RJValue &value, bool *error = nullptr)
+    {
+        target = get(value, error);
+    }
+
+private:
+    // Tries the alternatives in order, skipping the ones that can't be
+    // deserialized from this kind of JSON value
+    template <size_t... Indices>
+    static bool
+    getUntagged(Variant &ret, const RJValue &value,
+                detail::TraceScope<Variant> &trace,
+                std::index_sequence<Indices...>)
+    {
+        const auto kind = detail::JsonKindOf(value);
+
+        return ([&]() -> bool {
+            using InnerType = std::variant_alternative_t<Indices, Variant>;
+
+            if ((JsonKinds<InnerType>::value & kind) == 0) {
+                return false;
+            }
+
+            trace.addAlternative();
 
-        bool success = ([&]() -> bool {
             bool innerError = false;
-            ret = Deserialize<InnerTypes>::get(value, &innerError);
+            auto inner =
+                Deserialize<InnerType, RJValue>::get(value, &innerError);
             if (!innerError) {
-                PSE_DEBUG("Deserialized '"
-                          << internal::pp(value) << "' into "
-                          << internal::type_name<InnerTypes>());
+                ret.template emplace<Indices>(std::move(inner));
                 return true;
             }
-            PSE_DEBUG("Could not deserialize '"
-                      << internal::pp(value) << "' into "
-                      << internal::type_name<InnerTypes>());
             return false;
         }() || ...);
+    }
 
-        if (!success) {
-            if (error != nullptr) {
-                *error = true;
-            }
-            return {};
+    static bool
+    getTagged(Variant &ret, const RJValue &value, bool *error,
+              detail::TraceScope<Variant> &trace)
+    {
+        if (!value.IsObject()) {
+            return false;
         }
 
-        return ret;
+        auto tag = value.FindMember(detail::VariantTypeKey.data());
+        auto inner = value.FindMember(detail::VariantValueKey.data());
+        if (tag == value.MemberEnd() || inner == value.MemberEnd()) {
+            return false;
+        }
+
+        auto index = detail::VariantIndexFromTag<Variant>(tag->value);
+        if (index == std::variant_npos) {
+            return false;
+        }
+
+        trace.addAlternative();
+        getAlternative(ret, index, inner->value, error,
+                       std::index_sequence_for<InnerTypes...>{});
+        return true;
+    }
+
+    template <size_t... Indices>
+    static void
+    getAlternative(Variant &ret, size_t index, const RJValue &value,
+                   bool *error, std::index_sequence<Indices...>)
+    {
+        ((Indices == index
+              ? (ret.template emplace<Indices>(
+                     Deserialize<std::variant_alternative_t<Indices, Variant>,
+                                 RJValue>::get(value, error)),
+                 true)
+              : false) ||
+         ...);
     }
 };
 
@@ -295,7 +911,24 @@ struct Deserialize<std::optional<InnerType>, RJValue> {
             return std::nullopt;
         }
 
-        return Deserialize<InnerType>::get(value, error);
+        return Deserialize<InnerType, RJValue>::get(value, error);
+    }
+
+    static void
+    into(std::optional<InnerType> &target, const RJValue &value,
+         bool *error = nullptr)
+    {
+        if (value.IsNull()) {
+            target.reset();
+            return;
+        }
+
+        if (!target.has_value()) {
+            target = Deserialize<InnerType, RJValue>::get(value, error);
+            return;
+        }
+
+        detail::DeserializeInto<InnerType, RJValue>(*target, value, error);
     }
 };
 
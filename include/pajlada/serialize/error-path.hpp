@@ -0,0 +1,327 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <pajlada/serialize/common.hpp>
+#include <string>
+#include <string_view>
+
+namespace pajlada {
+
+namespace detail {
+
+class ErrorPathScope;
+
+// Appends token to a JSON pointer (RFC 6901) as a segment of its own
+inline void
+AppendPointerToken(std::string &pointer, std::string_view token)
+{
+    pointer += '/';
+    for (char c : token) {
+        if (c == '~') {
+            pointer += "~0";
+        } else if (c == '/') {
+            pointer += "~1";
+        } else {
+            pointer += c;
+        }
+    }
+}
+
+}  // namespace detail
+
+// Where in the JSON document the last error happened, as a list of object
+// keys and array indices from the root down.
+//
+// Only filled in with PAJLADA_ERROR_POLICY set to
+// PAJLADA_ERROR_POLICY_FAIL_FAST, by the containers and structs that are
+// decoded from a DOM value:
+//
+//   bool error = false;
+//   auto settings = Deserialize<Settings>::get(d, &error);
+//   if (error) {
+//       log("invalid settings at " + ErrorPath::current().toString());
+//   }
+//
+// The path is kept per thread in a fixed-size stack, so recording it never
+// allocates. Keys point into the document that was decoded and are only valid
+// for as long as it is. Paths deeper than MaxDepth keep their first MaxDepth
+// segments and are marked as truncated.
+//
+// Decoding stops as soon as the error flag is set, so pass a flag that starts
+// out as false.
+class ErrorPath
+{
+public:
+    static constexpr size_t MaxDepth = 32;
+
+    struct Segment {
+        // Points into the document for object members, empty otherwise
+        std::string_view key;
+        size_t index = 0;
+
+        bool
+        isKey() const
+        {
+            return this->key.data() != nullptr;
+        }
+    };
+
+    static ErrorPath &
+    current()
+    {
+        static thread_local ErrorPath path;
+        return path;
+    }
+
+    size_t
+    size() const
+    {
+        return this->size_;
+    }
+
+    bool
+    empty() const
+    {
+        return this->size_ == 0;
+    }
+
+    bool
+    truncated() const
+    {
+        return this->truncated_;
+    }
+
+    const Segment &
+    operator[](size_t i) const
+    {
+        return this->segments_[i];
+    }
+
+    void
+    clear()
+    {
+        this->size_ = 0;
+        this->truncated_ = false;
+    }
+
+    // Formats the path as a JSON pointer (RFC 6901), e.g. "/users/3/name"
+    std::string
+    toString() const
+    {
+        std::string ret;
+
+        for (size_t i = 0; i < this->size_; ++i) {
+            const auto &segment = this->segments_[i];
+            if (segment.isKey()) {
+                detail::AppendPointerToken(ret, segment.key);
+            } else {
+                ret += '/';
+                ret += std::to_string(segment.index);
+            }
+        }
+
+        return ret;
+    }
+
+private:
+    friend class detail::ErrorPathScope;
+
+    // Segment depth is where the error was found. The innermost container
+    // notices the error first and sets the length of the path, the ones
+    // around it fill in their segments as decoding unwinds
+    void
+    record(size_t depth, const Segment &segment)
+    {
+        if (!this->unwinding_) {
+            this->unwinding_ = true;
+            this->size_ = std::min(depth + 1, MaxDepth);
+            this->truncated_ = depth >= MaxDepth;
+        }
+
+        if (depth < MaxDepth) {
+            this->segments_[depth] = segment;
+        }
+    }
+
+    // Takes over the path inner recorded for the container at depth, on
+    // another thread or with a path of its own
+    void
+    adopt(size_t depth, const ErrorPath &inner)
+    {
+        this->unwinding_ = true;
+        this->size_ = std::min(depth + inner.size_, MaxDepth);
+        this->truncated_ = inner.truncated_ || depth + inner.size_ > MaxDepth;
+
+        for (size_t i = 0; i < inner.size_ && depth + i < MaxDepth; ++i) {
+            this->segments_[depth + i] = inner.segments_[i];
+        }
+    }
+
+    std::array<Segment, MaxDepth> segments_{};
+    size_t size_ = 0;
+    bool truncated_ = false;
+
+    // Number of containers currently being decoded
+    size_t depth_ = 0;
+    bool unwinding_ = false;
+};
+
+namespace detail {
+
+// Returns true if the container being decoded should give up on its remaining
+// elements
+inline bool
+ShouldStop(const bool *error)
+{
+#if PAJLADA_ERROR_POLICY == PAJLADA_ERROR_POLICY_FAIL_FAST
+    return error != nullptr && *error;
+#else
+    (void)error;
+    return false;
+#endif
+}
+
+// Where a chunk of a container that getParallel decoded failed, relative to
+// the container. Empty unless the fail fast policy is selected
+struct ChunkPath {
+#if PAJLADA_ERROR_POLICY == PAJLADA_ERROR_POLICY_FAIL_FAST
+    ErrorPath path;
+#endif
+};
+
+// Held by a container for as long as it's decoding its elements. Does
+// nothing unless the fail fast policy is selected
+class ErrorPathScope
+{
+public:
+    ErrorPathScope()
+    {
+#if PAJLADA_ERROR_POLICY == PAJLADA_ERROR_POLICY_FAIL_FAST
+        auto &path = ErrorPath::current();
+        if (path.depth_ == 0) {
+            // Decoding a new document
+            path.clear();
+        }
+        // Anything that was recorded while unwinding before this point was
+        // recovered from, e.g. a variant alternative that didn't match
+        path.unwinding_ = false;
+        ++path.depth_;
+#endif
+    }
+
+    ~ErrorPathScope()
+    {
+#if PAJLADA_ERROR_POLICY == PAJLADA_ERROR_POLICY_FAIL_FAST
+        --ErrorPath::current().depth_;
+#endif
+    }
+
+    ErrorPathScope(const ErrorPathScope &) = delete;
+    ErrorPathScope &operator=(const ErrorPathScope &) = delete;
+
+    // Called when decoding the element at index failed
+    void
+    failIndex([[maybe_unused]] size_t index)
+    {
+#if PAJLADA_ERROR_POLICY == PAJLADA_ERROR_POLICY_FAIL_FAST
+        auto &path = ErrorPath::current();
+        path.record(path.depth_ - 1, {{}, index});
+#endif
+    }
+
+    // Called when decoding the member named key failed
+    template <typename RJValue>
+    void
+    failKey([[maybe_unused]] const RJValue &key)
+    {
+#if PAJLADA_ERROR_POLICY == PAJLADA_ERROR_POLICY_FAIL_FAST
+        auto &path = ErrorPath::current();
+        path.record(path.depth_ - 1,
+                    {{key.GetString(), key.GetStringLength()}, 0});
+#endif
+    }
+
+    // Called when decoding a chunk of the elements in getParallel failed
+    void
+    failChunk([[maybe_unused]] const ChunkPath &chunk)
+    {
+#if PAJLADA_ERROR_POLICY == PAJLADA_ERROR_POLICY_FAIL_FAST
+        auto &path = ErrorPath::current();
+        path.adopt(path.depth_ - 1, chunk.path);
+#endif
+    }
+};
+
+// Held by the task decoding a chunk of a container in getParallel, in place
+// of the container's ErrorPathScope. The chunk gets a path of its own that
+// starts at the container, whichever thread decodes it, and the thread's
+// path is put back afterwards. On failure the path is copied to a ChunkPath,
+// which is handed to the container's scope once every chunk is done
+class ChunkPathScope
+{
+public:
+    ChunkPathScope() = default;
+
+    ChunkPathScope(const ChunkPathScope &) = delete;
+    ChunkPathScope &operator=(const ChunkPathScope &) = delete;
+
+    void
+    failIndex(size_t index, [[maybe_unused]] ChunkPath &out)
+    {
+        this->scope_.failIndex(index);
+#if PAJLADA_ERROR_POLICY == PAJLADA_ERROR_POLICY_FAIL_FAST
+        out.path = ErrorPath::current();
+#endif
+    }
+
+    template <typename RJValue>
+    void
+    failKey(const RJValue &key, [[maybe_unused]] ChunkPath &out)
+    {
+        this->scope_.failKey(key);
+#if PAJLADA_ERROR_POLICY == PAJLADA_ERROR_POLICY_FAIL_FAST
+        out.path = ErrorPath::current();
+#endif
+    }
+
+private:
+    // Swaps the thread's path for an empty one until the chunk is done
+    class Isolation
+    {
+    public:
+        Isolation()
+        {
+#if PAJLADA_ERROR_POLICY == PAJLADA_ERROR_POLICY_FAIL_FAST
+            auto &path = ErrorPath::current();
+            this->saved_ = path;
+            path = ErrorPath{};
+#endif
+        }
+
+        ~Isolation()
+        {
+#if PAJLADA_ERROR_POLICY == PAJLADA_ERROR_POLICY_FAIL_FAST
+            ErrorPath::current() = this->saved_;
+#endif
+        }
+
+        Isolation(const Isolation &) = delete;
+        Isolation &operator=(const Isolation &) = delete;
+
+#if PAJLADA_ERROR_POLICY == PAJLADA_ERROR_POLICY_FAIL_FAST
+    private:
+        ErrorPath saved_;
+#endif
+    };
+
+    // Declared first, so the scope is entered after the path was swapped
+    // and left before it's put back
+    Isolation isolation_;
+    ErrorPathScope scope_;
+};
+
+}  // namespace detail
+
+}  // namespace pajlada
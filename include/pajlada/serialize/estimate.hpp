@@ -0,0 +1,578 @@
+#pragma once
+
+#include <rapidjson/document.h>
+#include <rapidjson/writer.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <map>
+#include <optional>
+#include <pajlada/serialize/common.hpp>
+#include <pajlada/serialize/fields.hpp>
+#include <pajlada/serialize/flat-map.hpp>
+#include <pajlada/serialize/serialize-to.hpp>
+#include <pajlada/serialize/variant.hpp>
+#include <set>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Upper bounds on the size of a value once it's serialized, for sizing
+// buffers and allocators up front instead of growing them on the way:
+//
+//   auto estimate = pajlada::EstimateSize<Settings>::get(settings);
+//
+//   rapidjson::StringBuffer buffer;
+//   buffer.Reserve(estimate.bytes + 1);  // GetString adds a null
+//   rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+//   pajlada::SerializeTo<Settings>::write(settings, writer);
+//
+//   rapidjson::MemoryPoolAllocator<> pool(estimate.allocatorBytes());
+//   auto value = pajlada::Serialize<Settings>::get(settings, pool);
+//
+// Neither of them grow: the buffer is allocated once, and the pool's first
+// chunk takes the whole tree.
+//
+// Estimating walks the value the same way Serialize does, but only adds up
+// lengths. Numbers count as long as the longest number of their type, and
+// strings are scanned for characters that need escaping. Types without a
+// specialization of their own are written through SerializeTo into a writer
+// that only counts, which is exact but costs as much as writing them.
+namespace pajlada {
+
+struct SizeEstimate {
+    // Upper bound on the JSON text a rapidjson::Writer writes (without the
+    // terminating null). A PrettyWriter adds whitespace on top of this
+    size_t bytes = 0;
+
+    // Upper bound on the values in the tree Serialize builds, member names
+    // included
+    size_t nodes = 0;
+
+    SizeEstimate &
+    operator+=(const SizeEstimate &other)
+    {
+        this->bytes += other.bytes;
+        this->nodes += other.nodes;
+        return *this;
+    }
+
+    // Upper bound on what Serialize<Type, RJValue>::get takes from a
+    // rapidjson::MemoryPoolAllocator or ArenaAllocator: a slot and its
+    // padding for every value, and a copy of every string
+    template <typename RJValue = rapidjson::Value>
+    size_t
+    allocatorBytes() const
+    {
+        return this->nodes * (sizeof(RJValue) + RAPIDJSON_ALIGN(1)) +
+               this->bytes;
+    }
+};
+
+template <typename Type>
+struct Base64;
+
+template <typename Type, typename Enable = void>
+struct EstimateSize;
+
+namespace detail {
+
+// Longest text of a number of Type, e.g. "-2147483648" for int. Doubles take
+// at most 17 significant digits, a sign, a point and a 5 character exponent
+template <typename Type>
+inline constexpr size_t NumberLength =
+    std::is_floating_point<Type>::value
+        ? 25
+        : std::numeric_limits<Type>::digits10 + 1 +
+              (std::is_signed<Type>::value ? 1 : 0);
+
+// Length of every byte once a rapidjson::Writer has escaped it
+inline constexpr auto EscapedLength = [] {
+    std::array<uint8_t, 256> table{};
+    for (size_t c = 0; c < table.size(); ++c) {
+        table[c] = c < 0x20 ? 6 : 1;
+    }
+    for (unsigned char c : {'\b', '\t', '\n', '\f', '\r', '"', '\\'}) {
+        table[c] = 2;
+    }
+    return table;
+}();
+
+// Most strings need no escaping at all, so they're checked 8 bytes at a time
+// and only the bytes of words with something to escape are looked up
+inline SizeEstimate
+EstimateString(std::string_view value)
+{
+    constexpr uint64_t Ones = ~uint64_t{0} / 255;
+    constexpr uint64_t Highs = Ones * 0x80;
+
+    SizeEstimate ret{2 + value.size(), 1};
+
+    auto addEscapes = [&ret](const char *begin, const char *end) {
+        for (const char *c = begin; c != end; ++c) {
+            ret.bytes += EscapedLength[static_cast<unsigned char>(*c)] - 1;
+        }
+    };
+
+    const char *p = value.data();
+    const char *end = p + value.size();
+    for (; end - p >= 8; p += 8) {
+        uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+
+        // A byte is below 0x20 or zero after the xor if its high bit ends
+        // up set here
+        const uint64_t quotes = word ^ (Ones * '"');
+        const uint64_t backslashes = word ^ (Ones * '\\');
+        const uint64_t special = (((word - Ones * 0x20) & ~word) |
+                                  ((quotes - Ones) & ~quotes) |
+                                  ((backslashes - Ones) & ~backslashes)) &
+                                 Highs;
+        if (special != 0) {
+            addEscapes(p, p + 8);
+        }
+    }
+    addEscapes(p, end);
+
+    return ret;
+}
+
+// Brackets and the commas between size values
+inline SizeEstimate
+EstimateContainer(size_t size)
+{
+    return {2 + (size == 0 ? 0 : size - 1), 1};
+}
+
+template <typename Container>
+inline SizeEstimate
+EstimateArray(const Container &value)
+{
+    using ValueType = typename Container::value_type;
+
+    auto ret = EstimateContainer(value.size());
+    if constexpr (IsNumber<ValueType>) {
+        ret.bytes += value.size() * NumberLength<ValueType>;
+        ret.nodes += value.size();
+    } else {
+        for (const auto &element : value) {
+            ret += EstimateSize<ValueType>::get(element);
+        }
+    }
+    return ret;
+}
+
+template <typename Key>
+inline SizeEstimate
+EstimateKey(const Key &key)
+{
+    if constexpr (IsNumberKey<Key>) {
+        return {MaxNumberKeyLength + 2, 1};
+    } else {
+        return EstimateString(key);
+    }
+}
+
+template <typename Map>
+inline SizeEstimate
+EstimateObject(const Map &value)
+{
+    using ValueType = typename Map::mapped_type;
+
+    auto ret = EstimateContainer(value.size());
+    for (const auto &[key, innerValue] : value) {
+        ret += EstimateKey(key);
+        ret.bytes += 1;  // :
+        ret += EstimateSize<ValueType>::get(innerValue);
+    }
+    return ret;
+}
+
+// rapidjson output stream that keeps nothing but the count
+struct CountingStream {
+    using Ch = char;
+
+    void
+    Put(Ch /*c*/)
+    {
+        ++this->size;
+    }
+
+    void
+    Flush()
+    {
+    }
+
+    size_t size = 0;
+};
+
+// Passes the events on to a rapidjson::Writer that counts the text, and
+// counts the values itself
+class CountingHandler
+{
+public:
+    bool
+    Null()
+    {
+        ++this->nodes_;
+        return this->writer_.Null();
+    }
+
+    bool
+    Bool(bool b)
+    {
+        ++this->nodes_;
+        return this->writer_.Bool(b);
+    }
+
+    bool
+    Int(int i)
+    {
+        ++this->nodes_;
+        return this->writer_.Int(i);
+    }
+
+    bool
+    Uint(unsigned u)
+    {
+        ++this->nodes_;
+        return this->writer_.Uint(u);
+    }
+
+    bool
+    Int64(int64_t i)
+    {
+        ++this->nodes_;
+        return this->writer_.Int64(i);
+    }
+
+    bool
+    Uint64(uint64_t u)
+    {
+        ++this->nodes_;
+        return this->writer_.Uint64(u);
+    }
+
+    bool
+    Double(double d)
+    {
+        ++this->nodes_;
+        return this->writer_.Double(d);
+    }
+
+    bool
+    RawNumber(const char *str, rapidjson::SizeType length, bool copy)
+    {
+        ++this->nodes_;
+        return this->writer_.RawNumber(str, length, copy);
+    }
+
+    bool
+    String(const char *str, rapidjson::SizeType length, bool copy)
+    {
+        ++this->nodes_;
+        return this->writer_.String(str, length, copy);
+    }
+
+    bool
+    StartObject()
+    {
+        ++this->nodes_;
+        return this->writer_.StartObject();
+    }
+
+    bool
+    Key(const char *str, rapidjson::SizeType length, bool copy)
+    {
+        ++this->nodes_;
+        return this->writer_.Key(str, length, copy);
+    }
+
+    bool
+    EndObject(rapidjson::SizeType memberCount = 0)
+    {
+        return this->writer_.EndObject(memberCount);
+    }
+
+    bool
+    StartArray()
+    {
+        ++this->nodes_;
+        return this->writer_.StartArray();
+    }
+
+    bool
+    EndArray(rapidjson::SizeType elementCount = 0)
+    {
+        return this->writer_.EndArray(elementCount);
+    }
+
+    // Every value of the text takes at least one character of it
+    bool
+    RawValue(const char *json, size_t length, rapidjson::Type type)
+    {
+        this->nodes_ += type == rapidjson::kObjectType ||
+                                type == rapidjson::kArrayType
+                            ? length
+                            : 1;
+        return this->writer_.RawValue(json, length, type);
+    }
+
+    SizeEstimate
+    estimate() const
+    {
+        return {this->stream_.size, this->nodes_};
+    }
+
+private:
+    CountingStream stream_;
+    rapidjson::Writer<CountingStream> writer_{stream_};
+    size_t nodes_ = 0;
+};
+
+}  // namespace detail
+
+// EstimateSize<Type>::get(value) returns the SizeEstimate of value.
+// Specialize it next to Serialize for types whose size can be found without
+// writing them
+template <typename Type, typename Enable>
+struct EstimateSize {
+    static SizeEstimate
+    get(const Type &value)
+    {
+        detail::CountingHandler handler;
+        SerializeTo<Type>::write(value, handler);
+        return handler.estimate();
+    }
+};
+
+template <>
+struct EstimateSize<bool> {
+    static SizeEstimate
+    get(const bool & /*value*/)
+    {
+        return {5, 1};
+    }
+};
+
+// NaN and infinities are written as null, which is shorter than any number
+template <typename Type>
+struct EstimateSize<Type,
+                    typename std::enable_if<detail::IsNumber<Type>>::type> {
+    static SizeEstimate
+    get(const Type & /*value*/)
+    {
+        return {detail::NumberLength<Type>, 1};
+    }
+};
+
+template <>
+struct EstimateSize<std::string> {
+    static SizeEstimate
+    get(const std::string &value)
+    {
+        return detail::EstimateString(value);
+    }
+};
+
+template <>
+struct EstimateSize<std::string_view> {
+    static SizeEstimate
+    get(const std::string_view &value)
+    {
+        return detail::EstimateString(value);
+    }
+};
+
+template <typename Arg1, typename Arg2>
+struct EstimateSize<std::pair<Arg1, Arg2>> {
+    static SizeEstimate
+    get(const std::pair<Arg1, Arg2> &value)
+    {
+        auto ret = detail::EstimateContainer(2);
+        ret += EstimateSize<Arg1>::get(value.first);
+        ret += EstimateSize<Arg2>::get(value.second);
+        return ret;
+    }
+};
+
+template <typename InnerType>
+struct EstimateSize<std::optional<InnerType>> {
+    static SizeEstimate
+    get(const std::optional<InnerType> &value)
+    {
+        if (value.has_value()) {
+            return EstimateSize<InnerType>::get(value.value());
+        }
+
+        return {4, 1};
+    }
+};
+
+template <class... InnerTypes>
+struct EstimateSize<std::variant<InnerTypes...>> {
+    static SizeEstimate
+    get(const std::variant<InnerTypes...> &value)
+    {
+        using Variant = std::variant<InnerTypes...>;
+
+        auto ret = std::visit(
+            [](const auto &arg) {
+                using ActualType = std::decay_t<decltype(arg)>;
+                return EstimateSize<ActualType>::get(arg);
+            },
+            value);
+
+        if constexpr (VariantTag<Variant>::enabled) {
+            // {"type":<tag>,"value":<alternative>}
+            ret += detail::EstimateContainer(2);
+            ret += detail::EstimateString(detail::VariantTypeKey);
+            ret += detail::EstimateString(detail::VariantValueKey);
+            ret.bytes += 2;  // :
+            if constexpr (detail::HasVariantNames<Variant>) {
+                ret += detail::EstimateString(
+                    VariantTag<Variant>::names[value.index()]);
+            } else {
+                ret += EstimateSize<size_t>::get(value.index());
+            }
+        }
+
+        return ret;
+    }
+};
+
+template <typename ValueType>
+struct EstimateSize<std::vector<ValueType>> {
+    static SizeEstimate
+    get(const std::vector<ValueType> &value)
+    {
+        return detail::EstimateArray(value);
+    }
+};
+
+template <typename ValueType, size_t Size>
+struct EstimateSize<std::array<ValueType, Size>> {
+    static SizeEstimate
+    get(const std::array<ValueType, Size> &value)
+    {
+        return detail::EstimateArray(value);
+    }
+};
+
+template <typename ValueType, typename Allocator>
+struct EstimateSize<std::deque<ValueType, Allocator>> {
+    static SizeEstimate
+    get(const std::deque<ValueType, Allocator> &value)
+    {
+        return detail::EstimateArray(value);
+    }
+};
+
+template <typename Key, typename Compare, typename Allocator>
+struct EstimateSize<std::set<Key, Compare, Allocator>> {
+    static SizeEstimate
+    get(const std::set<Key, Compare, Allocator> &value)
+    {
+        return detail::EstimateArray(value);
+    }
+};
+
+template <typename Key, typename Hash, typename KeyEqual, typename Allocator>
+struct EstimateSize<std::unordered_set<Key, Hash, KeyEqual, Allocator>> {
+    static SizeEstimate
+    get(const std::unordered_set<Key, Hash, KeyEqual, Allocator> &value)
+    {
+        return detail::EstimateArray(value);
+    }
+};
+
+template <typename Key, typename ValueType>
+struct EstimateSize<std::map<Key, ValueType>,
+                    typename std::enable_if<detail::IsMapKey<Key>>::type> {
+    static SizeEstimate
+    get(const std::map<Key, ValueType> &value)
+    {
+        return detail::EstimateObject(value);
+    }
+};
+
+template <typename Key, typename ValueType, typename Hash, typename KeyEqual,
+          typename Allocator>
+struct EstimateSize<
+    std::unordered_map<Key, ValueType, Hash, KeyEqual, Allocator>,
+    typename std::enable_if<detail::IsMapKey<Key>>::type> {
+    using Map = std::unordered_map<Key, ValueType, Hash, KeyEqual, Allocator>;
+
+    static SizeEstimate
+    get(const Map &value)
+    {
+        return detail::EstimateObject(value);
+    }
+};
+
+template <typename Key, typename ValueType, typename Compare,
+          typename KeyContainer, typename MappedContainer>
+struct EstimateSize<
+    FlatMap<Key, ValueType, Compare, KeyContainer, MappedContainer>,
+    typename std::enable_if<detail::IsMapKey<Key>>::type> {
+    using Map =
+        FlatMap<Key, ValueType, Compare, KeyContainer, MappedContainer>;
+
+    static SizeEstimate
+    get(const Map &value)
+    {
+        return detail::EstimateObject(value);
+    }
+};
+
+// Structs using PAJLADA_SERIALIZE_FIELDS
+template <typename Type>
+struct EstimateSize<Type,
+                    typename std::enable_if<detail::HasFields<Type>>::type> {
+    static SizeEstimate
+    get(const Type &value)
+    {
+        auto ret = detail::EstimateContainer(detail::FieldCount<Type>);
+        std::apply(
+            [&](const auto &...field) {
+                ((ret += estimateField(field, value)), ...);
+            },
+            Fields<Type>::value);
+        return ret;
+    }
+
+private:
+    template <typename Member>
+    static SizeEstimate
+    estimateField(const Field<Type, Member> &field, const Type &value)
+    {
+        auto ret = detail::EstimateString(field.name);
+        ret.bytes += 1;  // :
+        ret += EstimateSize<Member>::get(value.*field.member);
+        return ret;
+    }
+};
+
+// The base64 text never needs escaping
+template <typename Type>
+struct EstimateSize<Base64<Type>> {
+    static SizeEstimate
+    get(const Base64<Type> &value)
+    {
+        const auto size =
+            value.value.size() * sizeof(typename Type::value_type);
+        return {(size + 2) / 3 * 4 + 2, 1};
+    }
+};
+
+}  // namespace pajlada
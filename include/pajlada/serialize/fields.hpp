@@ -0,0 +1,571 @@
+#pragma once
+
+#include <rapidjson/document.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <pajlada/serialize/common.hpp>
+#include <pajlada/serialize/deserialize-from.hpp>
+#include <pajlada/serialize/deserialize.hpp>
+#include <pajlada/serialize/error-path.hpp>
+#include <pajlada/serialize/serialize-to.hpp>
+#include <pajlada/serialize/serialize.hpp>
+#include <pajlada/serialize/trace.hpp>
+#include <pajlada/serialize/variant.hpp>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Declarative (de-)serialization of structs.
+//
+//   struct Complex {
+//       int a;
+//       int b;
+//       std::string c;
+//   };
+//
+//   PAJLADA_SERIALIZE_FIELDS(Complex, a, b, c);
+//
+// generates Serialize, Deserialize, SerializeTo and DeserializeFrom
+// specializations for Complex, which map it to/from a JSON object with the
+// members "a", "b" and "c". The member names are known at compile time, and
+// are referenced rather than copied when serializing.
+//
+// Deserializing makes a single pass over the members of the object, and finds
+// the field for each member through a perfect hash of the field names.
+// Missing members keep their value (the default value in get), unknown
+// members are ignored, and for duplicate members the first one wins. See
+// FieldsOptions and DeserializeFieldsInto for reporting unknown and missing
+// members.
+//
+// The macro must be used at global scope, with Type being a default
+// constructible type whose name doesn't contain any commas (use an alias for
+// template specializations).
+
+namespace pajlada {
+
+template <typename Class, typename Member>
+struct Field {
+    using ClassType = Class;
+    using MemberType = Member;
+
+    std::string_view name;
+    Member Class::*member;
+};
+
+// Fields<Type>::value is a tuple of Field describing the members of Type.
+// Specialized by PAJLADA_SERIALIZE_FIELDS
+template <typename Type>
+struct Fields;
+
+// Specialize to make deserializing Type report an error for members that
+// don't map to a field (rejectUnknown) or for fields without a member
+// (requireAll)
+template <typename Type>
+struct FieldsOptions {
+    static constexpr bool rejectUnknown = false;
+    static constexpr bool requireAll = false;
+};
+
+// Collects the member names DeserializeFieldsInto couldn't match up
+struct FieldReport {
+    // Members of the object that don't map to a field
+    std::vector<std::string> unknown;
+
+    // Fields that the object has no member for
+    std::vector<std::string_view> missing;
+};
+
+namespace detail {
+
+template <typename Class, typename Member>
+constexpr Field<Class, Member>
+MakeField(std::string_view name, Member Class::*member)
+{
+    return {name, member};
+}
+
+// Whether PAJLADA_SERIALIZE_FIELDS was used for Type
+template <typename Type>
+inline constexpr bool HasFields = requires { Fields<Type>::value; };
+
+template <typename Type>
+inline constexpr size_t FieldCount =
+    std::tuple_size<std::remove_cv_t<decltype(Fields<Type>::value)>>::value;
+
+constexpr uint32_t
+FieldHash(std::string_view name, uint32_t seed)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261U ^ seed;
+    for (char c : name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619U;
+    }
+
+    return hash ^ (hash >> 16);
+}
+
+// Perfect hash of the field names of Type, found at compile time.
+// Every name hashes to a slot of its own, so looking up a member name costs
+// one hash and one string comparison regardless of the number of fields.
+template <typename Type>
+struct FieldLookup {
+    static constexpr size_t Count = FieldCount<Type>;
+
+    static constexpr auto Names = std::apply(
+        [](const auto &...field) {
+            return std::array<std::string_view, Count>{field.name...};
+        },
+        Fields<Type>::value);
+
+    // With about Count^2 / 4 slots a working seed is found after a handful
+    // of tries
+    static constexpr size_t Slots =
+        std::bit_ceil(std::max<size_t>(8, Count * Count / 4));
+
+    static_assert(Count < UINT16_MAX, "Too many fields");
+
+    struct Table {
+        bool found = false;
+        uint32_t seed = 0;
+        std::array<uint16_t, Slots> slots{};
+    };
+
+    static constexpr Table
+    build()
+    {
+        for (uint32_t seed = 0; seed < 10000; ++seed) {
+            Table table;
+            table.seed = seed;
+            table.slots.fill(Count);
+            table.found = true;
+
+            for (size_t i = 0; i < Count && table.found; ++i) {
+                auto &slot = table.slots[FieldHash(Names[i], seed) % Slots];
+                if (slot != Count) {
+                    table.found = false;
+                } else {
+                    slot = static_cast<uint16_t>(i);
+                }
+            }
+
+            if (table.found) {
+                return table;
+            }
+        }
+
+        return {};
+    }
+
+    static constexpr Table Lookup = build();
+
+    static_assert(Lookup.found, "Field names must be unique");
+
+    // Returns the index of the field called name, or Count if there is no
+    // such field
+    static constexpr size_t
+    find(std::string_view name)
+    {
+        size_t index = Lookup.slots[FieldHash(name, Lookup.seed) % Slots];
+        if (index < Count && Names[index] == name) {
+            return index;
+        }
+
+        return Count;
+    }
+};
+
+template <typename Type>
+constexpr size_t
+FieldIndex(std::string_view name)
+{
+    return FieldLookup<Type>::find(name);
+}
+
+template <typename RJValue, typename Class, typename Member>
+inline typename RJValue::StringRefType
+FieldName(const Field<Class, Member> &field)
+{
+    return {field.name.data(),
+            static_cast<rapidjson::SizeType>(field.name.size())};
+}
+
+template <typename Type, typename RJValue>
+struct SerializeFields {
+    static RJValue
+    get(const Type &value, typename RJValue::AllocatorType &a)
+    {
+        TraceScope<Type> trace(TraceOperation::Serialize);
+        const auto used = trace.allocatorSize(a);
+
+        RJValue ret(rapidjson::kObjectType);
+        detail::MemberReserve(
+            ret, static_cast<rapidjson::SizeType>(FieldCount<Type>), a);
+
+        std::apply(
+            [&](const auto &...field) {
+                (addField(ret, field, value, a), ...);
+            },
+            Fields<Type>::value);
+
+        trace.setBytes(trace.allocatorSize(a) - used);
+        return ret;
+    }
+
+private:
+    template <typename Member>
+    static void
+    addField(RJValue &object, const Field<Type, Member> &field,
+             const Type &value, typename RJValue::AllocatorType &a)
+    {
+        auto inner = Serialize<Member, RJValue>::get(value.*field.member, a);
+        object.AddMember(FieldName<RJValue>(field), inner, a);
+    }
+};
+
+// Which fields have been seen so far, for reporting missing fields and
+// skipping duplicates
+template <typename Type>
+using SeenFields = std::array<bool, FieldCount<Type>>;
+
+template <typename Type>
+inline bool
+ReportMissingFields(const SeenFields<Type> &seen, FieldReport *report)
+{
+    bool missing = false;
+    for (size_t i = 0; i < seen.size(); ++i) {
+        if (!seen[i]) {
+            missing = true;
+            if (report != nullptr) {
+                report->missing.push_back(FieldLookup<Type>::Names[i]);
+            }
+        }
+    }
+
+    return missing;
+}
+
+template <typename Type, typename RJValue>
+struct DeserializeFields {
+    static Type
+    get(const RJValue &value, bool *error = nullptr)
+    {
+        Type ret{};
+
+        into(ret, value, error);
+
+        return ret;
+    }
+
+    static void
+    into(Type &target, const RJValue &value, bool *error = nullptr)
+    {
+        intoWithReport(target, value, error, nullptr);
+    }
+
+    // Decodes the members of value in a single pass, each member name is
+    // dispatched to its field through FieldLookup
+    static void
+    intoWithReport(Type &target, const RJValue &value, bool *error,
+                   FieldReport *report)
+    {
+        TraceScope<Type> trace(TraceOperation::Deserialize);
+        trace.watchError(error);
+
+        if (!value.IsObject()) {
+            trace.setError(true);
+            PAJLADA_REPORT_ERROR(error)
+            target = Type{};
+            return;
+        }
+
+        SeenFields<Type> seen{};
+        ErrorPathScope scope;
+
+        for (auto it = value.MemberBegin(); it != value.MemberEnd(); ++it) {
+            std::string_view name(it->name.GetString(),
+                                  it->name.GetStringLength());
+            auto index = FieldIndex<Type>(name);
+
+            if (index == FieldCount<Type>) {
+                if constexpr (FieldsOptions<Type>::rejectUnknown) {
+                    PAJLADA_REPORT_ERROR(error)
+                    if (ShouldStop(error)) {
+                        scope.failKey(it->name);
+                        return;
+                    }
+                }
+                if (report != nullptr) {
+                    report->unknown.emplace_back(name);
+                }
+                continue;
+            }
+
+            if (seen[index]) {
+                // Duplicate, the first one wins
+                continue;
+            }
+            seen[index] = true;
+
+            Decoders[index](target, it->value, error);
+            if (ShouldStop(error)) {
+                scope.failKey(it->name);
+                return;
+            }
+        }
+
+        if (ReportMissingFields<Type>(seen, report)) {
+            if constexpr (FieldsOptions<Type>::requireAll) {
+                PAJLADA_REPORT_ERROR(error)
+            }
+        }
+    }
+
+private:
+    using Decoder = void (*)(Type &, const RJValue &, bool *);
+
+    template <size_t Index>
+    static void
+    decodeField(Type &target, const RJValue &value, bool *error)
+    {
+        constexpr const auto &field = std::get<Index>(Fields<Type>::value);
+        using Member = typename std::decay_t<decltype(field)>::MemberType;
+
+        DeserializeInto<Member, RJValue>(target.*field.member, value, error);
+    }
+
+    template <size_t... Indices>
+    static constexpr std::array<Decoder, sizeof...(Indices)>
+    makeDecoders(std::index_sequence<Indices...>)
+    {
+        return {&decodeField<Indices>...};
+    }
+
+    static constexpr auto Decoders =
+        makeDecoders(std::make_index_sequence<FieldCount<Type>>{});
+};
+
+template <typename Type>
+struct SerializeFieldsTo {
+    template <typename Handler>
+    static bool
+    write(const Type &value, Handler &handler)
+    {
+        // A handler that gave up counts as an error
+        TraceScope<Type> trace(TraceOperation::SerializeTo);
+        trace.setError(true);
+
+        if (!handler.StartObject()) {
+            return false;
+        }
+
+        bool ok = std::apply(
+            [&](const auto &...field) {
+                return (writeField(field, value, handler) && ...);
+            },
+            Fields<Type>::value);
+
+        ok = ok && handler.EndObject(
+                       static_cast<rapidjson::SizeType>(FieldCount<Type>));
+        trace.setError(!ok);
+        return ok;
+    }
+
+private:
+    template <typename Member, typename Handler>
+    static bool
+    writeField(const Field<Type, Member> &field, const Type &value,
+               Handler &handler)
+    {
+        // The names outlive the handler, so there's no need to copy them
+        return handler.Key(field.name.data(),
+                           static_cast<rapidjson::SizeType>(field.name.size()),
+                           false) &&
+               SerializeTo<Member>::write(value.*field.member, handler);
+    }
+};
+
+template <typename Type>
+class FieldsFrame : public SaxFrame
+{
+public:
+    FieldsFrame(Type &out, const bool *error)
+        : out_(out)
+    {
+        // Traced until the frame is popped. An object that never ended, e.g.
+        // because the stream stopped, counts as an error
+        this->trace_.watchError(error);
+        this->trace_.setError(true);
+    }
+
+    bool
+    event(SaxContext &ctx, const SaxEvent &e) override
+    {
+        if (e.kind == SaxEvent::Kind::EndObject) {
+            if (ReportMissingFields<Type>(this->seen_, nullptr)) {
+                if constexpr (FieldsOptions<Type>::requireAll) {
+                    ctx.reportError();
+                }
+            }
+            this->trace_.setError(false);
+            ctx.pop();
+            return true;
+        }
+
+        if (e.kind == SaxEvent::Kind::Key) {
+            this->field_ = FieldIndex<Type>(e.str);
+            if (this->field_ == FieldCount<Type>) {
+                if constexpr (FieldsOptions<Type>::rejectUnknown) {
+                    ctx.reportError();
+                }
+            } else if (this->seen_[this->field_]) {
+                // Duplicate, the first one wins
+                this->field_ = FieldCount<Type>;
+            } else {
+                this->seen_[this->field_] = true;
+            }
+            return true;
+        }
+
+        if (this->field_ == FieldCount<Type>) {
+            ctx.skip(e);
+            return true;
+        }
+
+        return Starters[this->field_](ctx, this->out_, e);
+    }
+
+private:
+    using Starter = bool (*)(SaxContext &, Type &, const SaxEvent &);
+
+    template <size_t Index>
+    static bool
+    startField(SaxContext &ctx, Type &out, const SaxEvent &e)
+    {
+        constexpr const auto &field = std::get<Index>(Fields<Type>::value);
+        using Member = typename std::decay_t<decltype(field)>::MemberType;
+
+        return DeserializeFrom<Member>::start(ctx, out.*field.member, e);
+    }
+
+    template <size_t... Indices>
+    static constexpr std::array<Starter, sizeof...(Indices)>
+    makeStarters(std::index_sequence<Indices...>)
+    {
+        return {&startField<Indices>...};
+    }
+
+    static constexpr auto Starters =
+        makeStarters(std::make_index_sequence<FieldCount<Type>>{});
+
+    Type &out_;
+    size_t field_ = FieldCount<Type>;
+    SeenFields<Type> seen_{};
+    TraceScope<Type> trace_{TraceOperation::DeserializeFrom};
+};
+
+template <typename Type>
+struct DeserializeFieldsFrom {
+    static bool
+    start(SaxContext &ctx, Type &out, const SaxEvent &e)
+    {
+        out = Type{};
+
+        if (e.kind != SaxEvent::Kind::StartObject) {
+            TraceScope<Type> trace(TraceOperation::DeserializeFrom);
+            trace.setError(true);
+            ctx.reportError();
+            ctx.skip(e);
+            return true;
+        }
+
+        ctx.push<FieldsFrame<Type>>(out, ctx.error());
+        return true;
+    }
+};
+
+}  // namespace detail
+
+// Like Deserialize<Type>::into, but also collects the names of unknown
+// members and missing fields into report
+template <typename Type, typename RJValue>
+inline void
+DeserializeFieldsInto(Type &target, const RJValue &value, bool *error,
+                      FieldReport *report)
+{
+    // Documents are decoded as the values they are
+    using ValueType = typename RJValue::ValueType;
+
+    detail::DeserializeFields<Type, ValueType>::intoWithReport(target, value,
+                                                               error, report);
+}
+
+}  // namespace pajlada
+
+#define PAJLADA_SERIALIZE_PARENS ()
+
+// Rescans its arguments 4^4 = 256 times, enough for 256 fields
+#define PAJLADA_SERIALIZE_EXPAND(...)  \
+    PAJLADA_SERIALIZE_EXPAND3(         \
+        PAJLADA_SERIALIZE_EXPAND3(     \
+            PAJLADA_SERIALIZE_EXPAND3( \
+                PAJLADA_SERIALIZE_EXPAND3(__VA_ARGS__))))
+#define PAJLADA_SERIALIZE_EXPAND3(...)  \
+    PAJLADA_SERIALIZE_EXPAND2(          \
+        PAJLADA_SERIALIZE_EXPAND2(      \
+            PAJLADA_SERIALIZE_EXPAND2(  \
+                PAJLADA_SERIALIZE_EXPAND2(__VA_ARGS__))))
+#define PAJLADA_SERIALIZE_EXPAND2(...) \
+    PAJLADA_SERIALIZE_EXPAND1(         \
+        PAJLADA_SERIALIZE_EXPAND1(     \
+            PAJLADA_SERIALIZE_EXPAND1( \
+                PAJLADA_SERIALIZE_EXPAND1(__VA_ARGS__))))
+#define PAJLADA_SERIALIZE_EXPAND1(...) __VA_ARGS__
+
+// Expands to macro(Type, field) for every field, separated by commas
+#define PAJLADA_SERIALIZE_FOR_EACH(macro, Type, ...) \
+    __VA_OPT__(PAJLADA_SERIALIZE_EXPAND(             \
+        PAJLADA_SERIALIZE_FOR_EACH_HELPER(macro, Type, __VA_ARGS__)))
+#define PAJLADA_SERIALIZE_FOR_EACH_HELPER(macro, Type, field, ...) \
+    macro(Type, field) __VA_OPT__(                                 \
+        , PAJLADA_SERIALIZE_FOR_EACH_AGAIN PAJLADA_SERIALIZE_PARENS( \
+              macro, Type, __VA_ARGS__))
+#define PAJLADA_SERIALIZE_FOR_EACH_AGAIN() PAJLADA_SERIALIZE_FOR_EACH_HELPER
+
+#define PAJLADA_SERIALIZE_FIELD(Type, field) \
+    ::pajlada::detail::MakeField(#field, &Type::field)
+
+#define PAJLADA_SERIALIZE_FIELDS(Type, ...)                                  \
+    template <>                                                              \
+    struct pajlada::Fields<Type> {                                           \
+        static constexpr auto value = std::make_tuple(                       \
+            PAJLADA_SERIALIZE_FOR_EACH(PAJLADA_SERIALIZE_FIELD, Type,        \
+                                       __VA_ARGS__));                        \
+    };                                                                       \
+    template <>                                                              \
+    struct pajlada::JsonKinds<Type> {                                        \
+        static constexpr unsigned value = ::pajlada::JsonKind::Object;       \
+    };                                                                       \
+    template <typename RJValue>                                              \
+    struct pajlada::Serialize<Type, RJValue>                                 \
+        : ::pajlada::detail::SerializeFields<Type, RJValue> {                \
+    };                                                                       \
+    template <typename RJValue>                                              \
+    struct pajlada::Deserialize<Type, RJValue>                               \
+        : ::pajlada::detail::DeserializeFields<Type, RJValue> {              \
+    };                                                                       \
+    template <>                                                              \
+    struct pajlada::SerializeTo<Type>                                        \
+        : ::pajlada::detail::SerializeFieldsTo<Type> {                       \
+    };                                                                       \
+    template <>                                                              \
+    struct pajlada::DeserializeFrom<Type>                                    \
+        : ::pajlada::detail::DeserializeFieldsFrom<Type> {                   \
+    }
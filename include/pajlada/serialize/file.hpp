@@ -0,0 +1,371 @@
+#pragma once
+
+#include <rapidjson/document.h>
+#include <rapidjson/filewritestream.h>
+#include <rapidjson/writer.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <pajlada/serialize/common.hpp>
+#include <pajlada/serialize/deserialize.hpp>
+#include <pajlada/serialize/serialize-to.hpp>
+#include <pajlada/serialize/trace.hpp>
+#include <string>
+#include <system_error>
+
+#if defined(_WIN32)
+#include <fstream>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Loading values from and saving them to JSON files.
+//
+//   FileStats stats;
+//   bool error = false;
+//   auto settings = LoadFile<Settings>("settings.json", &error, &stats);
+//
+//   settings.volume = 11;
+//   if (!SaveFile("settings.json", settings, &stats)) {
+//       ...
+//   }
+
+namespace pajlada {
+
+// Where the time went in LoadFile/SaveFile
+struct FileStats {
+    // Size of the file that was read or written
+    size_t bytes = 0;
+
+    // LoadFile: mapping (or reading) the file
+    std::chrono::nanoseconds read{};
+    // LoadFile: parsing the JSON
+    std::chrono::nanoseconds parse{};
+    // LoadFile: Deserialize
+    // SaveFile: SerializeTo, including writing out the full buffers
+    std::chrono::nanoseconds convert{};
+    // SaveFile: flushing, syncing and renaming the file into place
+    std::chrono::nanoseconds sync{};
+
+    std::chrono::nanoseconds
+    total() const
+    {
+        return this->read + this->parse + this->convert + this->sync;
+    }
+};
+
+namespace detail {
+
+using FileClock = std::chrono::steady_clock;
+
+// Size of the buffer SaveFile writes through
+inline constexpr size_t FileWriteBufferSize = 256 * 1024;
+
+// A file's contents followed by at least one '\0', as needed by ParseInsitu.
+// Where mmap is available the file is mapped copy-on-write, so parsing
+// insitu never touches the file itself
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::filesystem::path &path)
+    {
+#if defined(_WIN32)
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            return;
+        }
+        this->buffer_.assign(std::istreambuf_iterator<char>(in),
+                             std::istreambuf_iterator<char>());
+        this->ok_ = !in.bad();
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+
+        struct stat st {};
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            return;
+        }
+        this->size_ = static_cast<size_t>(st.st_size);
+
+        // Reserve the whole range as zeroed anonymous memory first, with at
+        // least one page more than the file needs. The file is mapped over
+        // the start of it, so the byte after the end of the file is always a
+        // '\0', even if the file ends on a page boundary
+        auto page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        this->length_ = (this->size_ / page + 1) * page;
+
+        void *base = ::mmap(nullptr, this->length_, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            ::close(fd);
+            return;
+        }
+        this->data_ = static_cast<char *>(base);
+
+        if (this->size_ > 0 &&
+            ::mmap(base, this->size_, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            ::close(fd);
+            return;
+        }
+
+        ::close(fd);
+        this->ok_ = true;
+#endif
+    }
+
+    ~MappedFile()
+    {
+#if !defined(_WIN32)
+        if (this->data_ != nullptr) {
+            ::munmap(this->data_, this->length_);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool
+    ok() const
+    {
+        return this->ok_;
+    }
+
+    char *
+    data()
+    {
+#if defined(_WIN32)
+        return this->buffer_.data();
+#else
+        return this->data_;
+#endif
+    }
+
+    size_t
+    size() const
+    {
+#if defined(_WIN32)
+        return this->buffer_.size();
+#else
+        return this->size_;
+#endif
+    }
+
+private:
+    bool ok_ = false;
+#if defined(_WIN32)
+    std::string buffer_;
+#else
+    char *data_ = nullptr;
+    size_t size_ = 0;
+    size_t length_ = 0;
+#endif
+};
+
+#if !defined(_WIN32)
+// umask can only be read by setting it, which races with other threads
+// creating files. It's read once during static initialization instead, before
+// any threads of the program's own are running
+inline mode_t
+ReadUmask()
+{
+    mode_t mask = ::umask(0);
+    ::umask(mask);
+    return mask;
+}
+
+inline const mode_t ProcessUmask = ReadUmask();
+#endif
+
+// Creates a file with a unique name next to path, for SaveFile to write to
+// before renaming it over path. It gets the permissions of the file at path
+// if there is one, or those fopen would have given a new file otherwise.
+// Returns nullptr on failure, with nothing left behind
+inline std::FILE *
+CreateTemporary(const std::filesystem::path &path,
+                std::filesystem::path &temporary)
+{
+#if defined(_WIN32)
+    std::wstring name = path.native() + L".XXXXXX";
+    if (::_wmktemp_s(name.data(), name.size() + 1) != 0) {
+        return nullptr;
+    }
+    temporary = name;
+    return ::_wfopen(name.c_str(), L"wbx");
+#else
+    std::string name = path.native() + ".XXXXXX";
+    int fd = ::mkstemp(name.data());
+    if (fd < 0) {
+        return nullptr;
+    }
+    temporary = name;
+
+    struct stat st {};
+    mode_t mode = ::stat(path.c_str(), &st) == 0
+                      ? st.st_mode & 07777
+                      : 0666 & ~ProcessUmask;
+    bool ok = ::fchmod(fd, mode) == 0;
+
+    std::FILE *fp = ok ? ::fdopen(fd, "wb") : nullptr;
+    if (fp == nullptr) {
+        ::close(fd);
+        std::error_code ec;
+        std::filesystem::remove(temporary, ec);
+    }
+    return fp;
+#endif
+}
+
+// Makes sure everything written to fp made it to the disk
+inline bool
+SyncFile(std::FILE *fp)
+{
+    if (std::fflush(fp) != 0) {
+        return false;
+    }
+
+#if defined(_WIN32)
+    return ::_commit(::_fileno(fp)) == 0;
+#else
+    return ::fsync(::fileno(fp)) == 0;
+#endif
+}
+
+// Makes sure a rename in directory made it to the disk
+inline void
+SyncDirectory([[maybe_unused]] const std::filesystem::path &directory)
+{
+#if !defined(_WIN32)
+    int fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+#endif
+}
+
+}  // namespace detail
+
+// Loads the JSON file at path into a Type.
+// The file is memory mapped and parsed insitu, so strings are only copied
+// once, when they're deserialized. Since the mapping is gone once this
+// returns, Type must not contain any std::string_view, see LoadInsitu for
+// that.
+template <typename Type, unsigned parseFlags = rapidjson::kParseDefaultFlags>
+Type
+LoadFile(const std::filesystem::path &path, bool *error = nullptr,
+         FileStats *stats = nullptr)
+{
+    FileStats ignored;
+    auto &s = stats != nullptr ? *stats : ignored;
+    s = {};
+
+    detail::TraceScope<Type> trace(TraceOperation::LoadFile);
+    trace.watchError(error);
+
+    auto start = detail::FileClock::now();
+    detail::MappedFile file(path);
+    auto mapped = detail::FileClock::now();
+    s.read = mapped - start;
+
+    if (!file.ok()) {
+        trace.setError(true);
+        PAJLADA_REPORT_ERROR(error)
+        return Type{};
+    }
+    s.bytes = file.size();
+    trace.setBytes(s.bytes);
+
+    rapidjson::Document d;
+    d.ParseInsitu<parseFlags>(file.data());
+    auto parsed = detail::FileClock::now();
+    s.parse = parsed - mapped;
+
+    if (d.HasParseError()) {
+        trace.setError(true);
+        PAJLADA_REPORT_ERROR(error)
+        return Type{};
+    }
+
+    auto ret = Deserialize<Type>::get(d, error);
+    s.convert = detail::FileClock::now() - parsed;
+
+    return ret;
+}
+
+// Saves value to the JSON file at path.
+// The JSON is written straight to a uniquely named temporary file next to
+// path through a large buffer, synced to disk, and then renamed over path. A
+// crash midway through leaves either the old or the new file, never a mix of
+// both.
+// Returns false if anything failed, in which case path is left untouched
+template <typename Type>
+bool
+SaveFile(const std::filesystem::path &path, const Type &value,
+         FileStats *stats = nullptr)
+{
+    FileStats ignored;
+    auto &s = stats != nullptr ? *stats : ignored;
+    s = {};
+
+    // Cleared once the file is in place
+    detail::TraceScope<Type> trace(TraceOperation::SaveFile);
+    trace.setError(true);
+
+    auto start = detail::FileClock::now();
+
+    std::filesystem::path temporary;
+    std::FILE *fp = detail::CreateTemporary(path, temporary);
+    if (fp == nullptr) {
+        return false;
+    }
+
+    auto buffer = std::make_unique<char[]>(detail::FileWriteBufferSize);
+    rapidjson::FileWriteStream stream(fp, buffer.get(),
+                                      detail::FileWriteBufferSize);
+    rapidjson::Writer<rapidjson::FileWriteStream> writer(stream);
+
+    bool ok = SerializeTo<Type>::write(value, writer);
+    auto written = detail::FileClock::now();
+    s.convert = written - start;
+
+    stream.Flush();
+    ok = ok && std::ferror(fp) == 0 && detail::SyncFile(fp);
+    auto size = std::ftell(fp);
+    ok = std::fclose(fp) == 0 && ok;
+
+    std::error_code ec;
+    if (ok) {
+        std::filesystem::rename(temporary, path, ec);
+        ok = !ec;
+    }
+    if (!ok) {
+        std::filesystem::remove(temporary, ec);
+        return false;
+    }
+
+    detail::SyncDirectory(path.parent_path());
+
+    s.bytes = size > 0 ? static_cast<size_t>(size) : 0;
+    s.sync = detail::FileClock::now() - written;
+
+    trace.setBytes(s.bytes);
+    trace.setError(false);
+
+    return true;
+}
+
+}  // namespace pajlada
@@ -0,0 +1,310 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <version>
+
+#ifdef __cpp_lib_flat_map
+#include <flat_map>
+#endif
+
+// FlatMap is std::flat_map where the standard library has it. Elsewhere it's
+// a small stand-in built the same way, on a sorted container of keys with a
+// container of values next to it, so code using it works with both. It has
+// the parts of std::flat_map's interface that the (de-)serializers and most
+// callers need:
+//
+//   keys(), values(), key_comp(), std::move(map).extract() and
+//   replace(keys, values), which takes keys that are sorted and unique
+//   begin(), end(), size(), empty(), clear()
+//   find, contains, at, operator[], try_emplace and operator==
+//
+// Its iterators are forward iterators over std::pair<const Key &, T &>.
+namespace pajlada {
+
+#ifdef __cpp_lib_flat_map
+
+template <typename Key, typename T, typename Compare = std::less<Key>,
+          typename KeyContainer = std::vector<Key>,
+          typename MappedContainer = std::vector<T>>
+using FlatMap = std::flat_map<Key, T, Compare, KeyContainer, MappedContainer>;
+
+#else
+
+template <typename Key, typename T, typename Compare = std::less<Key>,
+          typename KeyContainer = std::vector<Key>,
+          typename MappedContainer = std::vector<T>>
+class FlatMap
+{
+    template <bool Const>
+    class Iterator;
+
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<Key, T>;
+    using key_compare = Compare;
+    using key_container_type = KeyContainer;
+    using mapped_container_type = MappedContainer;
+    using size_type = size_t;
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    struct containers {
+        key_container_type keys;
+        mapped_container_type values;
+    };
+
+    FlatMap() = default;
+
+    // For duplicate keys the first one wins
+    FlatMap(std::initializer_list<value_type> init)
+    {
+        for (const auto &[key, value] : init) {
+            this->try_emplace(key, value);
+        }
+    }
+
+    const key_container_type &
+    keys() const noexcept
+    {
+        return this->keys_;
+    }
+
+    const mapped_container_type &
+    values() const noexcept
+    {
+        return this->values_;
+    }
+
+    key_compare
+    key_comp() const
+    {
+        return this->compare_;
+    }
+
+    // Leaves the map empty
+    containers
+    extract() &&
+    {
+        containers ret{std::move(this->keys_), std::move(this->values_)};
+        this->clear();
+        return ret;
+    }
+
+    void
+    replace(key_container_type &&keys, mapped_container_type &&values)
+    {
+        this->keys_ = std::move(keys);
+        this->values_ = std::move(values);
+    }
+
+    iterator
+    begin()
+    {
+        return {this, 0};
+    }
+
+    iterator
+    end()
+    {
+        return {this, this->size()};
+    }
+
+    const_iterator
+    begin() const
+    {
+        return {this, 0};
+    }
+
+    const_iterator
+    end() const
+    {
+        return {this, this->size()};
+    }
+
+    size_type
+    size() const noexcept
+    {
+        return this->keys_.size();
+    }
+
+    bool
+    empty() const noexcept
+    {
+        return this->keys_.empty();
+    }
+
+    void
+    clear() noexcept
+    {
+        this->keys_.clear();
+        this->values_.clear();
+    }
+
+    iterator
+    find(const Key &key)
+    {
+        auto index = this->lowerBound(key);
+        return {this, this->found(index, key) ? index : this->size()};
+    }
+
+    const_iterator
+    find(const Key &key) const
+    {
+        auto index = this->lowerBound(key);
+        return {this, this->found(index, key) ? index : this->size()};
+    }
+
+    bool
+    contains(const Key &key) const
+    {
+        return this->found(this->lowerBound(key), key);
+    }
+
+    T &
+    at(const Key &key)
+    {
+        auto index = this->lowerBound(key);
+        if (!this->found(index, key)) {
+            throw std::out_of_range("FlatMap::at");
+        }
+        return this->values_[index];
+    }
+
+    const T &
+    at(const Key &key) const
+    {
+        auto index = this->lowerBound(key);
+        if (!this->found(index, key)) {
+            throw std::out_of_range("FlatMap::at");
+        }
+        return this->values_[index];
+    }
+
+    T &
+    operator[](const Key &key)
+    {
+        return (*this->try_emplace(key).first).second;
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool>
+    try_emplace(const Key &key, Args &&...args)
+    {
+        auto index = this->lowerBound(key);
+        if (this->found(index, key)) {
+            return {{this, index}, false};
+        }
+
+        auto offset = static_cast<std::ptrdiff_t>(index);
+        this->keys_.insert(this->keys_.begin() + offset, key);
+        this->values_.emplace(this->values_.begin() + offset,
+                              std::forward<Args>(args)...);
+        return {{this, index}, true};
+    }
+
+    bool
+    operator==(const FlatMap &other) const
+    {
+        return this->keys_ == other.keys_ && this->values_ == other.values_;
+    }
+
+private:
+    template <bool Const>
+    class Iterator
+    {
+        using Map = std::conditional_t<Const, const FlatMap, FlatMap>;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+        using value_type = std::pair<Key, T>;
+        using reference =
+            std::pair<const Key &, std::conditional_t<Const, const T &, T &>>;
+
+        // The pair of references lives in here
+        struct pointer {
+            reference ref;
+
+            const reference *
+            operator->() const
+            {
+                return &this->ref;
+            }
+        };
+
+        Iterator() = default;
+
+        Iterator(Map *map, size_t index)
+            : map_(map)
+            , index_(index)
+        {
+        }
+
+        reference
+        operator*() const
+        {
+            return {this->map_->keys_[this->index_],
+                    this->map_->values_[this->index_]};
+        }
+
+        pointer
+        operator->() const
+        {
+            return {**this};
+        }
+
+        Iterator &
+        operator++()
+        {
+            ++this->index_;
+            return *this;
+        }
+
+        Iterator
+        operator++(int)
+        {
+            auto ret = *this;
+            ++this->index_;
+            return ret;
+        }
+
+        bool operator==(const Iterator &other) const = default;
+
+    private:
+        Map *map_ = nullptr;
+        size_t index_ = 0;
+    };
+
+    size_t
+    lowerBound(const Key &key) const
+    {
+        return static_cast<size_t>(
+            std::lower_bound(this->keys_.begin(), this->keys_.end(), key,
+                             this->compare_) -
+            this->keys_.begin());
+    }
+
+    bool
+    found(size_t index, const Key &key) const
+    {
+        return index < this->keys_.size() &&
+               !this->compare_(key, this->keys_[index]);
+    }
+
+    key_container_type keys_;
+    mapped_container_type values_;
+    [[no_unique_address]] key_compare compare_;
+};
+
+#endif
+
+}  // namespace pajlada
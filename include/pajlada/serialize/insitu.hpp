@@ -0,0 +1,120 @@
+#pragma once
+
+#include <rapidjson/document.h>
+
+#include <functional>
+#include <memory>
+#include <pajlada/serialize/common.hpp>
+#include <pajlada/serialize/deserialize.hpp>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace pajlada {
+
+// Zero-copy loading.
+// The JSON text is parsed insitu: rapidjson unescapes strings inside the
+// input buffer itself, so every string in the DOM points into that buffer.
+// std::string_view values (and string_view map keys) deserialized from it
+// therefore never copy anything. The buffer is owned by the returned
+// InsituValue, which keeps it alive for as long as any copy of the value
+// exists. The DOM itself is thrown away once the value is deserialized.
+
+template <typename Type>
+class InsituValue
+{
+public:
+    InsituValue() = default;
+
+    Type &
+    get()
+    {
+        return this->value_;
+    }
+
+    const Type &
+    get() const
+    {
+        return this->value_;
+    }
+
+    Type &
+    operator*()
+    {
+        return this->value_;
+    }
+
+    const Type &
+    operator*() const
+    {
+        return this->value_;
+    }
+
+    Type *
+    operator->()
+    {
+        return &this->value_;
+    }
+
+    const Type *
+    operator->() const
+    {
+        return &this->value_;
+    }
+
+    // Returns true if view points into the buffer owned by this value, i.e.
+    // it stays valid for as long as this value (or a copy of it) exists
+    bool
+    owns(std::string_view view) const
+    {
+        if (!this->buffer_ || view.data() == nullptr) {
+            return false;
+        }
+
+        const auto *begin = this->buffer_->data();
+        const auto *end = begin + this->buffer_->size();
+
+        // std::less gives a total order even for unrelated pointers
+        return !std::less<const char *>{}(view.data(), begin) &&
+               !std::less<const char *>{}(end, view.data() + view.size());
+    }
+
+    // Size of the owned (now unescaped) JSON text
+    size_t
+    bufferSize() const
+    {
+        return this->buffer_ ? this->buffer_->size() : 0;
+    }
+
+private:
+    template <typename T, unsigned parseFlags>
+    friend InsituValue<T> LoadInsitu(std::string json, bool *error);
+
+    // Held through a pointer so moving the InsituValue never moves the
+    // characters (short strings live inside std::string itself)
+    std::shared_ptr<std::string> buffer_;
+    Type value_{};
+};
+
+// Parse json insitu and deserialize it into Type.
+// json is taken by value so callers can move their buffer in without a copy
+template <typename Type, unsigned parseFlags = rapidjson::kParseDefaultFlags>
+InsituValue<Type>
+LoadInsitu(std::string json, bool *error = nullptr)
+{
+    InsituValue<Type> ret;
+    ret.buffer_ = std::make_shared<std::string>(std::move(json));
+
+    rapidjson::Document d;
+    d.ParseInsitu<parseFlags>(ret.buffer_->data());
+    if (d.HasParseError()) {
+        PAJLADA_REPORT_ERROR(error)
+        return ret;
+    }
+
+    detail::DeserializeInto<Type, rapidjson::Value>(ret.value_, d, error);
+
+    return ret;
+}
+
+}  // namespace pajlada
@@ -4,17 +4,11 @@
 
 #pragma once
 
-#ifdef PAJLADA_SERIALIZE_LOG_VERBOSE
-
-#include <source_location>  // IWYU pragma: keep
-#include <string_view>      // IWYU pragma: keep
-
-#endif
+#include <source_location>
+#include <string_view>
 
 namespace pajlada::internal {
 
-#ifdef PAJLADA_SERIALIZE_LOG_VERBOSE
-
 template <typename T>
 constexpr std::string_view type_name();
 
@@ -65,6 +59,4 @@ type_name()
     return wrapped_name.substr(prefix_length, type_name_length);
 }
 
-#endif
-
 }  // namespace pajlada::internal
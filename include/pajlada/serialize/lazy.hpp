@@ -0,0 +1,353 @@
+#pragma once
+
+#include <rapidjson/document.h>
+#include <rapidjson/reader.h>
+#include <rapidjson/writer.h>
+
+#include <cstddef>
+#include <optional>
+#include <pajlada/serialize/common.hpp>
+#include <pajlada/serialize/deserialize-from.hpp>
+#include <pajlada/serialize/deserialize.hpp>
+#include <pajlada/serialize/serialize-to.hpp>
+#include <pajlada/serialize/serialize.hpp>
+#include <pajlada/serialize/variant.hpp>
+#include <string>
+#include <utility>
+
+namespace pajlada {
+
+// A value that is only deserialized once it's needed.
+//
+// Loading a Lazy<Type> keeps a compact copy of its JSON text instead of
+// decoding it. The first get() decodes the text, and as long as the value
+// isn't changed through set or mutate it is saved from the same text again,
+// without being serialized. Sections of a document most code never looks at
+// cost one copy of their text on load and on save, e.g.
+//
+//   struct Config {
+//       std::string name;
+//       Lazy<std::map<std::string, PluginSettings>> plugins;
+//       Lazy<std::vector<HistoryEntry>> history;
+//   };
+//
+// Errors in the deferred JSON are reported by get and mutate rather than on
+// load. Like Tracked, get() writes to the value on first use, so a Lazy must
+// not be read from several threads at once until it has been decoded.
+template <typename Type>
+class Lazy
+{
+public:
+    Lazy()
+        : value_(std::in_place)
+    {
+    }
+
+    explicit Lazy(Type value)
+        : value_(std::move(value))
+    {
+    }
+
+    // Creates a value to be decoded from json on first use
+    static Lazy
+    fromJson(std::string json)
+    {
+        Lazy ret;
+        ret.setJson(std::move(json));
+        return ret;
+    }
+
+    // Returns the value, decoding it first if this is the first access
+    const Type &
+    get(bool *error = nullptr) const
+    {
+        this->decode();
+        if (this->failed_) {
+            PAJLADA_REPORT_ERROR(error)
+        }
+
+        return *this->value_;
+    }
+
+    const Type &
+    operator*() const
+    {
+        return this->get();
+    }
+
+    const Type *
+    operator->() const
+    {
+        return &this->get();
+    }
+
+    // Gives write access to the value. The JSON it was loaded from is thrown
+    // away, so the value is serialized from now on
+    Type &
+    mutate(bool *error = nullptr)
+    {
+        this->get(error);
+        this->json_.clear();
+        this->json_.shrink_to_fit();
+        return *this->value_;
+    }
+
+    void
+    set(Type value)
+    {
+        this->value_ = std::move(value);
+        this->failed_ = false;
+        this->json_.clear();
+        this->json_.shrink_to_fit();
+    }
+
+    // Drops the value and replaces it with json, to be decoded on first use
+    void
+    setJson(std::string json)
+    {
+        this->value_.reset();
+        this->failed_ = false;
+        this->json_ = std::move(json);
+    }
+
+    // Returns true if the value has been decoded (or was never loaded)
+    bool
+    decoded() const
+    {
+        return this->value_.has_value();
+    }
+
+    // The JSON text the value was loaded from, or an empty string if it was
+    // changed since
+    const std::string &
+    json() const
+    {
+        return this->json_;
+    }
+
+private:
+    void
+    decode() const
+    {
+        if (this->value_.has_value()) {
+            return;
+        }
+
+        // The text was written by rapidjson, so it can't contain a '\0'.
+        // Doubles are read back exactly, like they were before the value was
+        // deferred
+        rapidjson::Document d;
+        d.Parse<rapidjson::kParseFullPrecisionFlag>(this->json_.c_str());
+        if (d.HasParseError()) {
+            this->failed_ = true;
+            this->value_.emplace();
+            return;
+        }
+
+        this->value_ = Deserialize<Type>::get(d, &this->failed_);
+    }
+
+    mutable std::optional<Type> value_;
+    mutable bool failed_ = false;
+    std::string json_;
+};
+
+namespace detail {
+
+// Lets a rapidjson::Writer write straight into a std::string
+class StringWriteStream
+{
+public:
+    using Ch = char;
+
+    explicit StringWriteStream(std::string &out)
+        : out_(out)
+    {
+    }
+
+    void
+    Put(char c)
+    {
+        this->out_.push_back(c);
+    }
+
+    void
+    Flush()
+    {
+    }
+
+private:
+    std::string &out_;
+};
+
+template <typename Handler>
+inline bool
+WriteSaxEvent(Handler &handler, const SaxEvent &e)
+{
+    auto size = static_cast<rapidjson::SizeType>(e.str.size());
+
+    switch (e.kind) {
+        case SaxEvent::Kind::Null:
+            return handler.Null();
+        case SaxEvent::Kind::Bool:
+            return handler.Bool(e.b);
+        case SaxEvent::Kind::Int:
+            return handler.Int(e.i);
+        case SaxEvent::Kind::Uint:
+            return handler.Uint(e.u);
+        case SaxEvent::Kind::Int64:
+            return handler.Int64(e.i64);
+        case SaxEvent::Kind::Uint64:
+            return handler.Uint64(e.u64);
+        case SaxEvent::Kind::Double:
+            return handler.Double(e.d);
+        case SaxEvent::Kind::String:
+            return handler.String(e.str.data(), size, true);
+        case SaxEvent::Kind::Key:
+            return handler.Key(e.str.data(), size, true);
+        case SaxEvent::Kind::StartObject:
+            return handler.StartObject();
+        case SaxEvent::Kind::EndObject:
+            return handler.EndObject(e.count);
+        case SaxEvent::Kind::StartArray:
+            return handler.StartArray();
+        case SaxEvent::Kind::EndArray:
+            return handler.EndArray(e.count);
+    }
+
+    return false;
+}
+
+// Writes the events of one object/array back out as JSON text for a Lazy
+template <typename Type>
+class LazyFrame : public SaxFrame
+{
+public:
+    LazyFrame(Lazy<Type> &out, const SaxEvent &start)
+        : out_(out)
+    {
+        WriteSaxEvent(this->writer_, start);
+    }
+
+    bool
+    event(SaxContext &ctx, const SaxEvent &e) override
+    {
+        WriteSaxEvent(this->writer_, e);
+
+        if (e.kind == SaxEvent::Kind::StartObject ||
+            e.kind == SaxEvent::Kind::StartArray) {
+            ++this->depth_;
+        } else if (e.isEnd()) {
+            if (this->depth_ == 0) {
+                this->out_.setJson(std::move(this->json_));
+                ctx.pop();
+                return true;
+            }
+            --this->depth_;
+        }
+
+        return true;
+    }
+
+private:
+    Lazy<Type> &out_;
+    size_t depth_ = 0;
+
+    std::string json_;
+    StringWriteStream stream_{json_};
+    rapidjson::Writer<StringWriteStream> writer_{stream_};
+};
+
+}  // namespace detail
+
+template <typename Type>
+struct JsonKinds<Lazy<Type>> {
+    static constexpr unsigned value = JsonKinds<Type>::value;
+};
+
+template <typename Type, typename RJValue>
+struct Serialize<Lazy<Type>, RJValue> {
+    static RJValue
+    get(const Lazy<Type> &value, typename RJValue::AllocatorType &a)
+    {
+        if (value.json().empty()) {
+            return Serialize<Type, RJValue>::get(value.get(), a);
+        }
+
+        // Parsing the text straight into a's memory is cheaper than decoding
+        // and serializing the value
+        rapidjson::GenericDocument<typename RJValue::EncodingType,
+                                   typename RJValue::AllocatorType>
+            d(&a);
+        d.template Parse<rapidjson::kParseFullPrecisionFlag>(
+            value.json().c_str());
+        if (d.HasParseError()) {
+            return Serialize<Type, RJValue>::get(value.get(), a);
+        }
+
+        RJValue ret;
+        ret.Swap(d);
+        return ret;
+    }
+};
+
+template <typename Type, typename RJValue>
+struct Deserialize<Lazy<Type>, RJValue> {
+    // Only copies the JSON text of value, which is never reported as an error
+    static Lazy<Type>
+    get(const RJValue &value, bool * /*error*/ = nullptr)
+    {
+        std::string json;
+        detail::StringWriteStream stream(json);
+        rapidjson::Writer<detail::StringWriteStream> writer(stream);
+        value.Accept(writer);
+
+        return Lazy<Type>::fromJson(std::move(json));
+    }
+};
+
+template <typename Type>
+struct SerializeTo<Lazy<Type>> {
+    template <typename Handler>
+    static bool
+    write(const Lazy<Type> &value, Handler &handler)
+    {
+        const auto &json = value.json();
+        if (json.empty()) {
+            return SerializeTo<Type>::write(value.get(), handler);
+        }
+
+        if constexpr (detail::IsWriter<Handler>) {
+            return handler.RawValue(json.data(), json.size(),
+                                    detail::RawValueType(json[0]));
+        } else {
+            rapidjson::Reader reader;
+            rapidjson::StringStream stream(json.c_str());
+            auto result = reader.Parse<rapidjson::kParseFullPrecisionFlag>(
+                stream, handler);
+            return !result.IsError();
+        }
+    }
+};
+
+template <typename Type>
+struct DeserializeFrom<Lazy<Type>> {
+    static bool
+    start(SaxContext &ctx, Lazy<Type> &out, const SaxEvent &e)
+    {
+        if (!e.isScalar()) {
+            ctx.push<detail::LazyFrame<Type>>(out, e);
+            return true;
+        }
+
+        std::string json;
+        detail::StringWriteStream stream(json);
+        rapidjson::Writer<detail::StringWriteStream> writer(stream);
+        detail::WriteSaxEvent(writer, e);
+
+        out.setJson(std::move(json));
+        return true;
+    }
+};
+
+}  // namespace pajlada
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <cstddef>
+#include <istream>
+#include <iterator>
+#include <ostream>
+#include <pajlada/serialize/arena.hpp>
+#include <pajlada/serialize/common.hpp>
+#include <pajlada/serialize/deserialize.hpp>
+#include <pajlada/serialize/serialize-to.hpp>
+#include <string>
+
+// Streams of records stored as newline delimited JSON (one JSON value per
+// line, see https://github.com/ndjson/ndjson-spec)
+//
+//   std::ofstream out("events.ndjson", std::ios::app);
+//   ndjson::Writer<Event> writer(out);
+//   writer.write(event);
+//
+//   std::ifstream in("events.ndjson");
+//   for (const auto &event : ndjson::Reader<Event>(in)) {
+//       replay(event);
+//   }
+//
+// Neither side keeps more than one record around, and the buffers used for
+// it are reused from one record to the next.
+namespace pajlada::ndjson {
+
+template <typename Type>
+class Writer
+{
+public:
+    explicit Writer(std::ostream &out)
+        : out_(out)
+    {
+    }
+
+    Writer(const Writer &) = delete;
+    Writer &operator=(const Writer &) = delete;
+
+    // Appends record as a line of its own. Returns false if record couldn't
+    // be serialized or the stream failed
+    bool
+    write(const Type &record)
+    {
+        this->buffer_.Clear();
+        this->writer_.Reset(this->buffer_);
+
+        if (!SerializeTo<Type>::write(record, this->writer_)) {
+            return false;
+        }
+        // The writer escapes newlines inside strings, so this is the only
+        // one in the line
+        this->buffer_.Put('\n');
+
+        this->out_.write(this->buffer_.GetString(),
+                         static_cast<std::streamsize>(this->buffer_.GetSize()));
+        if (!this->out_) {
+            return false;
+        }
+
+        ++this->count_;
+        return true;
+    }
+
+    void
+    flush()
+    {
+        this->out_.flush();
+    }
+
+    // Number of records written
+    size_t
+    count() const
+    {
+        return this->count_;
+    }
+
+private:
+    std::ostream &out_;
+    rapidjson::StringBuffer buffer_;
+    rapidjson::Writer<rapidjson::StringBuffer> writer_{buffer_};
+    size_t count_ = 0;
+};
+
+// Reads records one line at a time. Each line is parsed insitu from a line
+// buffer into an ArenaAllocator, both of which are reused for every record,
+// so apart from the records themselves a warmed up reader doesn't allocate.
+// Records are decoded with Deserialize::get rather than into, so members
+// missing from one record never carry over from the one before.
+//
+// Lines that aren't valid JSON or can't be decoded as Type are skipped and
+// reported through error. Blank lines are skipped silently.
+//
+// The reader is an input range: it can be iterated over once, and the
+// current record is only valid until the iterator is advanced.
+template <typename Type>
+class Reader
+{
+public:
+    using JsonValue =
+        rapidjson::GenericValue<rapidjson::UTF8<>, ArenaAllocator>;
+
+    class iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Type *;
+        using reference = const Type &;
+
+        iterator() = default;
+
+        explicit iterator(Reader *reader)
+            : reader_(reader)
+        {
+        }
+
+        reference
+        operator*() const
+        {
+            return this->reader_->current();
+        }
+
+        pointer
+        operator->() const
+        {
+            return &this->reader_->current();
+        }
+
+        iterator &
+        operator++()
+        {
+            if (!this->reader_->next()) {
+                this->reader_ = nullptr;
+            }
+            return *this;
+        }
+
+        void
+        operator++(int)
+        {
+            ++*this;
+        }
+
+        friend bool
+        operator==(const iterator &it, std::default_sentinel_t)
+        {
+            return it.reader_ == nullptr;
+        }
+
+    private:
+        Reader *reader_ = nullptr;
+    };
+
+    explicit Reader(std::istream &in, bool *error = nullptr)
+        : in_(in)
+        , error_(error)
+    {
+    }
+
+    Reader(const Reader &) = delete;
+    Reader &operator=(const Reader &) = delete;
+
+    // Moves on to the next record. Returns false once the stream is
+    // exhausted
+    bool
+    next()
+    {
+        while (std::getline(this->in_, this->line_)) {
+            ++this->lineNumber_;
+
+            if (this->line_.find_first_not_of(" \t\r") == std::string::npos) {
+                continue;
+            }
+
+            // The values of the previous record point into the arena
+            this->document_.SetNull();
+            this->allocator_.Reset();
+
+            this->document_.template ParseInsitu<rapidjson::kParseDefaultFlags>(
+                this->line_.data());
+            if (this->document_.HasParseError()) {
+                this->skip();
+                continue;
+            }
+
+            bool recordError = false;
+            this->current_ = Deserialize<Type, JsonValue>::get(
+                this->document_, &recordError);
+            if (recordError) {
+                this->skip();
+                continue;
+            }
+
+            return true;
+        }
+
+        return false;
+    }
+
+    const Type &
+    current() const
+    {
+        return this->current_;
+    }
+
+    // Line the current record was read from, starting at 1
+    size_t
+    lineNumber() const
+    {
+        return this->lineNumber_;
+    }
+
+    // Number of lines that were skipped because of an error
+    size_t
+    skipped() const
+    {
+        return this->skipped_;
+    }
+
+    // Reads the first record
+    iterator
+    begin()
+    {
+        iterator it(this);
+        ++it;
+        return it;
+    }
+
+    std::default_sentinel_t
+    end() const
+    {
+        return {};
+    }
+
+private:
+    void
+    skip()
+    {
+        ++this->skipped_;
+        PAJLADA_REPORT_ERROR(this->error_)
+    }
+
+    std::istream &in_;
+    bool *error_;
+
+    std::string line_;
+    ArenaAllocator allocator_;
+    rapidjson::GenericDocument<rapidjson::UTF8<>, ArenaAllocator> document_{
+        &allocator_};
+    Type current_{};
+
+    size_t lineNumber_ = 0;
+    size_t skipped_ = 0;
+};
+
+}  // namespace pajlada::ndjson
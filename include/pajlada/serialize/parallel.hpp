@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace pajlada {
+
+// Executor for the parallel (de-)serialization functions, e.g.
+//
+//   ThreadPool pool;
+//   auto records = Deserialize<std::vector<Record>>::getParallel(d, pool,
+//                                                               &error);
+//
+// Serializing in parallel goes through SerializeTo<T>::writeParallel, which
+// writes straight to a handler. There is no DOM equivalent: every chunk
+// would have to be built in an allocator of its own and copied into the
+// caller's afterwards, which costs more than it saves.
+//
+// Any type with the same two functions can be used instead:
+//   size_t concurrency() const
+//       number of tasks that can run at the same time
+//   void run(size_t count, Task task)
+//       calls task(i) for every i in [0, count) and returns once they're done
+//
+// The thread calling run works on the tasks as well, so a pool of N threads
+// only starts N - 1 of its own. Tasks are handed out one at a time from a
+// shared counter, so threads that finish early keep taking tasks until none
+// are left. Tasks must not throw, and run must not be called from a task.
+//
+// Using this needs linking to Threads::Threads on some platforms.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(size_t threadCount = DefaultThreadCount())
+    {
+        threadCount = std::max<size_t>(threadCount, 1);
+
+        this->workers_.reserve(threadCount - 1);
+        for (size_t i = 1; i < threadCount; ++i) {
+            this->workers_.emplace_back([this] {
+                this->workerLoop();
+            });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard lock(this->mutex_);
+            this->stopping_ = true;
+        }
+        this->wake_.notify_all();
+
+        for (auto &worker : this->workers_) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    static size_t
+    DefaultThreadCount()
+    {
+        return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+
+    size_t
+    concurrency() const
+    {
+        return this->workers_.size() + 1;
+    }
+
+    template <typename Task>
+    void
+    run(size_t count, Task &&task)
+    {
+        using TaskType = std::remove_reference_t<Task>;
+
+        // One job at a time
+        std::lock_guard runLock(this->runMutex_);
+
+        Job job;
+        job.count = count;
+        job.context = &task;
+        job.invoke = [](void *context, size_t i) {
+            (*static_cast<TaskType *>(context))(i);
+        };
+
+        {
+            std::lock_guard lock(this->mutex_);
+            this->job_ = &job;
+            ++this->generation_;
+        }
+        this->wake_.notify_all();
+
+        Work(job);
+
+        // Every task has been taken, wait for the workers that are still
+        // busy with theirs
+        std::unique_lock lock(this->mutex_);
+        this->idle_.wait(lock, [this] {
+            return this->active_ == 0;
+        });
+        this->job_ = nullptr;
+    }
+
+private:
+    struct Job {
+        size_t count = 0;
+        std::atomic<size_t> next{0};
+        void *context = nullptr;
+        void (*invoke)(void *, size_t) = nullptr;
+    };
+
+    static void
+    Work(Job &job)
+    {
+        for (;;) {
+            auto i = job.next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= job.count) {
+                return;
+            }
+            job.invoke(job.context, i);
+        }
+    }
+
+    void
+    workerLoop()
+    {
+        size_t seen = 0;
+
+        std::unique_lock lock(this->mutex_);
+        for (;;) {
+            this->wake_.wait(lock, [this, seen] {
+                return this->stopping_ ||
+                       (this->job_ != nullptr && this->generation_ != seen);
+            });
+            if (this->stopping_) {
+                return;
+            }
+
+            seen = this->generation_;
+            auto *job = this->job_;
+            ++this->active_;
+
+            lock.unlock();
+            Work(*job);
+            lock.lock();
+
+            if (--this->active_ == 0) {
+                this->idle_.notify_all();
+            }
+        }
+    }
+
+    std::vector<std::thread> workers_;
+
+    std::mutex runMutex_;
+
+    // Guards everything below
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    Job *job_ = nullptr;
+    size_t generation_ = 0;
+    size_t active_ = 0;
+    bool stopping_ = false;
+};
+
+}  // namespace pajlada
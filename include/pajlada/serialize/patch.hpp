@@ -0,0 +1,829 @@
+#pragma once
+
+#include <rapidjson/document.h>
+
+#include <algorithm>
+#include <any>
+#include <array>
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <pajlada/serialize/common.hpp>
+#include <pajlada/serialize/deserialize.hpp>
+#include <pajlada/serialize/error-path.hpp>
+#include <pajlada/serialize/fields.hpp>
+#include <pajlada/serialize/serialize.hpp>
+#include <pajlada/serialize/tracked.hpp>
+#include <pajlada/serialize/variant.hpp>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Deltas between two values of the same type as JSON Patch (RFC 6902)
+// documents.
+//
+//   auto patch = Diff(saved, settings);
+//   send(patch);
+//
+//   // On the other end
+//   bool error = false;
+//   ApplyPatch(settings, patch, &error);
+//
+// Diff walks both values through Patch<Type>, which descends into maps,
+// vectors, arrays, pairs, optionals, variants, Tracked values and structs
+// using PAJLADA_SERIALIZE_FIELDS, and only serializes the parts that differ.
+// Anything else (including std::any) is compared as a whole and replaced if it
+// changed.
+//
+// ApplyPatch updates the typed value in place, following the path of each
+// operation through the same containers and deserializing only the values the
+// operations carry. It supports every operation of RFC 6902.
+namespace pajlada {
+
+template <typename Type, typename Enable = void>
+struct Patch;
+
+// A single operation of a patch, as seen by Patch<Type>::apply while it walks
+// down the path
+struct PatchOperation {
+    enum class Kind {
+        Add,
+        Remove,
+        Replace,
+        Test,
+        // Serializes the target into result, used for copy and move
+        Get,
+    };
+
+    Kind kind = Kind::Add;
+
+    // Unescaped tokens of the path
+    std::vector<std::string> path;
+
+    // How many tokens of the path have been followed
+    size_t depth = 0;
+
+    // The value of add, replace and test
+    const rapidjson::Value *value = nullptr;
+
+    rapidjson::Document *result = nullptr;
+
+    // Returns true if the path ends at the value being visited
+    bool
+    atTarget() const
+    {
+        return this->depth == this->path.size();
+    }
+
+    // Returns true if the path ends at a child of the value being visited,
+    // which is what add and remove on containers look for
+    bool
+    atParent() const
+    {
+        return this->depth + 1 == this->path.size();
+    }
+
+    const std::string &
+    token() const
+    {
+        return this->path[this->depth];
+    }
+};
+
+// Collects the operations of a patch while Patch<Type>::diff walks two values
+class PatchBuilder
+{
+public:
+    explicit PatchBuilder(rapidjson::Document &patch)
+        : patch_(patch)
+    {
+        this->patch_.SetArray();
+    }
+
+    // Runs fn with the object member key appended to the current path
+    template <typename Fn>
+    void
+    atKey(std::string_view key, Fn &&fn)
+    {
+        auto length = this->path_.size();
+        detail::AppendPointerToken(this->path_, key);
+        fn();
+        this->path_.resize(length);
+    }
+
+    // Integer and enum map keys are appended as their digits, the same as
+    // the member names they're serialized to
+    template <typename Key, typename Fn,
+              typename std::enable_if<detail::IsNumberKey<Key>>::type * =
+                  nullptr>
+    void
+    atKey(Key key, Fn &&fn)
+    {
+        char buffer[detail::MaxNumberKeyLength];
+        auto length = detail::FormatNumberKey(key, buffer);
+        this->atKey(std::string_view(buffer, length), std::forward<Fn>(fn));
+    }
+
+    // Runs fn with the array index appended to the current path
+    template <typename Fn>
+    void
+    atIndex(size_t index, Fn &&fn)
+    {
+        auto length = this->path_.size();
+        this->path_ += '/';
+        this->path_ += std::to_string(index);
+        fn();
+        this->path_.resize(length);
+    }
+
+    template <typename Type>
+    void
+    add(const Type &value)
+    {
+        auto v = Serialize<Type>::get(value, this->patch_.GetAllocator());
+        this->append("add", &v);
+    }
+
+    void
+    remove()
+    {
+        this->append("remove", nullptr);
+    }
+
+    template <typename Type>
+    void
+    replace(const Type &value)
+    {
+        auto v = Serialize<Type>::get(value, this->patch_.GetAllocator());
+        this->append("replace", &v);
+    }
+
+private:
+    void
+    append(const char *op, rapidjson::Value *value)
+    {
+        auto &a = this->patch_.GetAllocator();
+
+        rapidjson::Value operation(rapidjson::kObjectType);
+        detail::MemberReserve(operation, value != nullptr ? 3 : 2, a);
+        operation.AddMember("op", rapidjson::StringRef(op), a);
+
+        rapidjson::Value path(
+            this->path_.data(),
+            static_cast<rapidjson::SizeType>(this->path_.size()), a);
+        operation.AddMember("path", path, a);
+
+        if (value != nullptr) {
+            operation.AddMember("value", *value, a);
+        }
+
+        this->patch_.PushBack(operation, a);
+    }
+
+    rapidjson::Document &patch_;
+    std::string path_;
+};
+
+namespace detail {
+
+// Compares two values that Patch can't look into
+template <typename Type>
+inline bool
+PatchEqual(const Type &a, const Type &b)
+{
+    if constexpr (std::equality_comparable<Type>) {
+        return a == b;
+    } else {
+        rapidjson::Document d;
+        return Serialize<Type>::get(a, d.GetAllocator()) ==
+               Serialize<Type>::get(b, d.GetAllocator());
+    }
+}
+
+// Parses an array index token, which RFC 6901 doesn't allow leading zeros in
+inline bool
+PatchIndex(std::string_view token, size_t &index)
+{
+    if (token.empty() || (token.size() > 1 && token[0] == '0')) {
+        return false;
+    }
+
+    const auto *end = token.data() + token.size();
+    auto [ptr, ec] = std::from_chars(token.data(), end, index);
+    return ec == std::errc() && ptr == end;
+}
+
+// Parses a JSON pointer (RFC 6901) into its unescaped tokens
+inline bool
+PatchPath(const rapidjson::Value &pointer, std::vector<std::string> &tokens)
+{
+    if (!pointer.IsString()) {
+        return false;
+    }
+
+    std::string_view s(pointer.GetString(), pointer.GetStringLength());
+    tokens.clear();
+
+    if (s.empty()) {
+        return true;
+    }
+    if (s[0] != '/') {
+        return false;
+    }
+
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '/') {
+            tokens.emplace_back();
+        } else if (s[i] != '~') {
+            tokens.back() += s[i];
+        } else if (i + 1 < s.size() && s[i + 1] == '0') {
+            tokens.back() += '~';
+            ++i;
+        } else if (i + 1 < s.size() && s[i + 1] == '1') {
+            tokens.back() += '/';
+            ++i;
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template <typename Type>
+inline bool
+DecodePatchValue(const PatchOperation &op, Type &out)
+{
+    bool error = false;
+    auto value = Deserialize<Type>::get(*op.value, &error);
+    if (error) {
+        return false;
+    }
+
+    out = std::move(value);
+    return true;
+}
+
+// Applies an operation whose path ends at target
+template <typename Type>
+inline bool
+ApplyPatchAt(Type &target, PatchOperation &op)
+{
+    switch (op.kind) {
+        case PatchOperation::Kind::Add:
+        case PatchOperation::Kind::Replace:
+            return DecodePatchValue(op, target);
+
+        case PatchOperation::Kind::Test: {
+            rapidjson::Document d;
+            return Serialize<Type>::get(target, d.GetAllocator()) == *op.value;
+        }
+
+        case PatchOperation::Kind::Get: {
+            // The target may be removed before the result is used, so
+            // strings it references have to be copied
+            rapidjson::Document d;
+            auto value = Serialize<Type>::get(target, d.GetAllocator());
+            op.result->CopyFrom(value, op.result->GetAllocator(), true);
+            return true;
+        }
+
+        case PatchOperation::Kind::Remove:
+            // Only containers can remove their children
+            return false;
+    }
+
+    return false;
+}
+
+// Follows the next token of the path into child
+template <typename Type>
+inline bool
+ApplyPatchToChild(Type &child, PatchOperation &op)
+{
+    ++op.depth;
+    bool ok = Patch<Type>::apply(child, op);
+    --op.depth;
+
+    return ok;
+}
+
+// Applies an operation to a struct using PAJLADA_SERIALIZE_FIELDS. Fields
+// can't be removed, and adding one replaces it
+template <typename Type>
+inline bool
+ApplyPatchToFields(Type &target, PatchOperation &op)
+{
+    auto index = FieldIndex<Type>(op.token());
+    if (index == FieldCount<Type> ||
+        (op.atParent() && op.kind == PatchOperation::Kind::Remove)) {
+        return false;
+    }
+
+    bool ok = false;
+    size_t i = 0;
+    std::apply(
+        [&](const auto &...field) {
+            ((i++ == index && (ok = ApplyPatchToChild(target.*field.member,
+                                                      op),
+                               true)) ||
+             ...);
+        },
+        Fields<Type>::value);
+
+    return ok;
+}
+
+}  // namespace detail
+
+// Values Patch can't look into are compared and replaced as a whole
+template <typename Type, typename Enable>
+struct Patch {
+    static void
+    diff(const Type &from, const Type &to, PatchBuilder &patch)
+    {
+        if constexpr (detail::HasFields<Type>) {
+            std::apply(
+                [&](const auto &...field) {
+                    (diffField(from, to, field, patch), ...);
+                },
+                Fields<Type>::value);
+        } else if (!detail::PatchEqual(from, to)) {
+            patch.replace(to);
+        }
+    }
+
+    static bool
+    apply(Type &target, PatchOperation &op)
+    {
+        if (op.atTarget()) {
+            return detail::ApplyPatchAt(target, op);
+        }
+
+        if constexpr (detail::HasFields<Type>) {
+            return detail::ApplyPatchToFields(target, op);
+        } else {
+            return false;
+        }
+    }
+
+private:
+    template <typename Member>
+    static void
+    diffField(const Type &from, const Type &to,
+              const Field<Type, Member> &field, PatchBuilder &patch)
+    {
+        patch.atKey(field.name, [&] {
+            Patch<Member>::diff(from.*field.member, to.*field.member, patch);
+        });
+    }
+};
+
+template <typename Key, typename ValueType>
+struct Patch<std::map<Key, ValueType>> {
+    using Map = std::map<Key, ValueType>;
+
+    static void
+    diff(const Map &from, const Map &to, PatchBuilder &patch)
+    {
+        // Both maps are sorted, so they can be walked side by side
+        auto a = from.begin();
+        auto b = to.begin();
+
+        while (a != from.end() || b != to.end()) {
+            if (b == to.end() || (a != from.end() && a->first < b->first)) {
+                patch.atKey(a->first, [&] {
+                    patch.remove();
+                });
+                ++a;
+            } else if (a == from.end() || b->first < a->first) {
+                patch.atKey(b->first, [&] {
+                    patch.add(b->second);
+                });
+                ++b;
+            } else {
+                patch.atKey(a->first, [&] {
+                    Patch<ValueType>::diff(a->second, b->second, patch);
+                });
+                ++a;
+                ++b;
+            }
+        }
+    }
+
+    static bool
+    apply(Map &target, PatchOperation &op)
+    {
+        if (op.atTarget()) {
+            return detail::ApplyPatchAt(target, op);
+        }
+
+        if constexpr (detail::IsNumberKey<Key>) {
+            Key key{};
+            if (!detail::ParseNumberKey(op.token(), key)) {
+                return false;
+            }
+            return applyAt(target, key, op);
+        } else {
+            return applyAt(target, op.token(), op);
+        }
+    }
+
+    // Applies op to the entry for key, which is the parsed token for number
+    // keys and the token itself otherwise
+    template <typename KeyArg>
+    static bool
+    applyAt(Map &target, const KeyArg &key, PatchOperation &op)
+    {
+        auto it = target.find(key);
+
+        if (op.atParent() && op.kind == PatchOperation::Kind::Add) {
+            ValueType value{};
+            if (!detail::DecodePatchValue(op, value)) {
+                return false;
+            }
+
+            if (it != target.end()) {
+                it->second = std::move(value);
+                return true;
+            }
+
+            if constexpr (std::is_same_v<Key, std::string_view>) {
+                // Nothing would own the new key
+                return false;
+            } else {
+                target.emplace(key, std::move(value));
+                return true;
+            }
+        }
+
+        if (it == target.end()) {
+            return false;
+        }
+
+        if (op.atParent() && op.kind == PatchOperation::Kind::Remove) {
+            target.erase(it);
+            return true;
+        }
+
+        return detail::ApplyPatchToChild(it->second, op);
+    }
+};
+
+template <typename ValueType>
+struct Patch<std::vector<ValueType>> {
+    static void
+    diff(const std::vector<ValueType> &from, const std::vector<ValueType> &to,
+         PatchBuilder &patch)
+    {
+        auto common = std::min(from.size(), to.size());
+
+        for (size_t i = 0; i < common; ++i) {
+            patch.atIndex(i, [&] {
+                Patch<ValueType>::diff(from[i], to[i], patch);
+            });
+        }
+
+        for (size_t i = common; i < to.size(); ++i) {
+            patch.atIndex(i, [&] {
+                patch.add(static_cast<const ValueType &>(to[i]));
+            });
+        }
+
+        // Remove from the back so the indices stay valid
+        for (size_t i = from.size(); i > common; --i) {
+            patch.atIndex(i - 1, [&] {
+                patch.remove();
+            });
+        }
+    }
+
+    static bool
+    apply(std::vector<ValueType> &target, PatchOperation &op)
+    {
+        if (op.atTarget()) {
+            return detail::ApplyPatchAt(target, op);
+        }
+
+        size_t index = 0;
+        if (op.atParent() && op.kind == PatchOperation::Kind::Add) {
+            if (op.token() == "-") {
+                index = target.size();
+            } else if (!detail::PatchIndex(op.token(), index) ||
+                       index > target.size()) {
+                return false;
+            }
+
+            ValueType value{};
+            if (!detail::DecodePatchValue(op, value)) {
+                return false;
+            }
+
+            target.insert(target.begin() + static_cast<ptrdiff_t>(index),
+                          std::move(value));
+            return true;
+        }
+
+        if (!detail::PatchIndex(op.token(), index) || index >= target.size()) {
+            return false;
+        }
+
+        if (op.atParent() && op.kind == PatchOperation::Kind::Remove) {
+            target.erase(target.begin() + static_cast<ptrdiff_t>(index));
+            return true;
+        }
+
+        if constexpr (std::is_same_v<ValueType, bool>) {
+            bool value = target[index];
+            bool ok = detail::ApplyPatchToChild(value, op);
+            target[index] = value;
+            return ok;
+        } else {
+            return detail::ApplyPatchToChild(target[index], op);
+        }
+    }
+};
+
+template <typename ValueType, size_t Size>
+struct Patch<std::array<ValueType, Size>> {
+    static void
+    diff(const std::array<ValueType, Size> &from,
+         const std::array<ValueType, Size> &to, PatchBuilder &patch)
+    {
+        for (size_t i = 0; i < Size; ++i) {
+            patch.atIndex(i, [&] {
+                Patch<ValueType>::diff(from[i], to[i], patch);
+            });
+        }
+    }
+
+    static bool
+    apply(std::array<ValueType, Size> &target, PatchOperation &op)
+    {
+        if (op.atTarget()) {
+            return detail::ApplyPatchAt(target, op);
+        }
+
+        // The size is fixed, so elements can only be replaced
+        size_t index = 0;
+        if (!detail::PatchIndex(op.token(), index) || index >= Size ||
+            (op.atParent() && (op.kind == PatchOperation::Kind::Add ||
+                               op.kind == PatchOperation::Kind::Remove))) {
+            return false;
+        }
+
+        return detail::ApplyPatchToChild(target[index], op);
+    }
+};
+
+template <typename Arg1, typename Arg2>
+struct Patch<std::pair<Arg1, Arg2>> {
+    static void
+    diff(const std::pair<Arg1, Arg2> &from, const std::pair<Arg1, Arg2> &to,
+         PatchBuilder &patch)
+    {
+        patch.atIndex(0, [&] {
+            Patch<Arg1>::diff(from.first, to.first, patch);
+        });
+        patch.atIndex(1, [&] {
+            Patch<Arg2>::diff(from.second, to.second, patch);
+        });
+    }
+
+    static bool
+    apply(std::pair<Arg1, Arg2> &target, PatchOperation &op)
+    {
+        if (op.atTarget()) {
+            return detail::ApplyPatchAt(target, op);
+        }
+
+        if (op.atParent() && (op.kind == PatchOperation::Kind::Add ||
+                              op.kind == PatchOperation::Kind::Remove)) {
+            return false;
+        }
+
+        if (op.token() == "0") {
+            return detail::ApplyPatchToChild(target.first, op);
+        }
+        if (op.token() == "1") {
+            return detail::ApplyPatchToChild(target.second, op);
+        }
+
+        return false;
+    }
+};
+
+// Optionals are null or their value, so paths go straight through them
+template <class InnerType>
+struct Patch<std::optional<InnerType>> {
+    static void
+    diff(const std::optional<InnerType> &from,
+         const std::optional<InnerType> &to, PatchBuilder &patch)
+    {
+        if (from.has_value() && to.has_value()) {
+            Patch<InnerType>::diff(*from, *to, patch);
+        } else if (from.has_value() != to.has_value()) {
+            patch.replace(to);
+        }
+    }
+
+    static bool
+    apply(std::optional<InnerType> &target, PatchOperation &op)
+    {
+        if (op.atTarget()) {
+            return detail::ApplyPatchAt(target, op);
+        }
+
+        if (!target.has_value()) {
+            return false;
+        }
+
+        return Patch<InnerType>::apply(*target, op);
+    }
+};
+
+// Paths go straight through untagged variants, and through the value member
+// of tagged ones. Switching to another alternative replaces the variant
+template <class... InnerTypes>
+struct Patch<std::variant<InnerTypes...>> {
+    using Variant = std::variant<InnerTypes...>;
+
+    static constexpr bool Tagged = VariantTag<Variant>::enabled;
+
+    static void
+    diff(const Variant &from, const Variant &to, PatchBuilder &patch)
+    {
+        if (from.index() != to.index()) {
+            patch.replace(to);
+            return;
+        }
+
+        std::visit(
+            [&](const auto &a) {
+                using ActualType = std::decay_t<decltype(a)>;
+                const auto &b = std::get<ActualType>(to);
+
+                if constexpr (Tagged) {
+                    patch.atKey(detail::VariantValueKey, [&] {
+                        Patch<ActualType>::diff(a, b, patch);
+                    });
+                } else {
+                    Patch<ActualType>::diff(a, b, patch);
+                }
+            },
+            from);
+    }
+
+    static bool
+    apply(Variant &target, PatchOperation &op)
+    {
+        if (op.atTarget()) {
+            return detail::ApplyPatchAt(target, op);
+        }
+
+        if constexpr (Tagged) {
+            if (op.token() != detail::VariantValueKey ||
+                (op.atParent() && op.kind == PatchOperation::Kind::Remove)) {
+                return false;
+            }
+        }
+
+        return std::visit(
+            [&](auto &alternative) {
+                using ActualType = std::decay_t<decltype(alternative)>;
+
+                if constexpr (Tagged) {
+                    return detail::ApplyPatchToChild(alternative, op);
+                } else {
+                    return Patch<ActualType>::apply(alternative, op);
+                }
+            },
+            target);
+    }
+};
+
+// Tracked values are marked dirty by every operation that reaches them
+template <typename Type>
+struct Patch<Tracked<Type>> {
+    static void
+    diff(const Tracked<Type> &from, const Tracked<Type> &to,
+         PatchBuilder &patch)
+    {
+        Patch<Type>::diff(from.get(), to.get(), patch);
+    }
+
+    static bool
+    apply(Tracked<Type> &target, PatchOperation &op)
+    {
+        return Patch<Type>::apply(target.mutate(), op);
+    }
+};
+
+// Returns the JSON Patch (RFC 6902) that turns from into to.
+// Values in the patch are serialized with Serialize, so string_views in to
+// are referenced rather than copied, and the patch must not outlive them.
+template <typename Type>
+inline rapidjson::Document
+Diff(const Type &from, const Type &to)
+{
+    rapidjson::Document patch;
+    PatchBuilder builder(patch);
+    Patch<Type>::diff(from, to, builder);
+
+    return patch;
+}
+
+// Applies the JSON Patch (RFC 6902) patch to target.
+// Operations are applied in order until one fails, which is reported through
+// error. The operations before it stay applied, so apply the patch to a copy
+// if it has to be all or nothing.
+template <typename Type>
+inline void
+ApplyPatch(Type &target, const rapidjson::Value &patch, bool *error = nullptr)
+{
+    if (!patch.IsArray()) {
+        PAJLADA_REPORT_ERROR(error)
+        return;
+    }
+
+    PatchOperation op;
+    std::vector<std::string> from;
+    rapidjson::Document moved;
+
+    // Runs op from the root of target
+    auto run = [&](PatchOperation::Kind kind) {
+        op.kind = kind;
+        op.depth = 0;
+        return Patch<Type>::apply(target, op);
+    };
+
+    for (const auto &operation : patch.GetArray()) {
+        if (!operation.IsObject()) {
+            PAJLADA_REPORT_ERROR(error)
+            return;
+        }
+
+        auto name = operation.FindMember("op");
+        auto path = operation.FindMember("path");
+        if (name == operation.MemberEnd() || !name->value.IsString() ||
+            path == operation.MemberEnd() ||
+            !detail::PatchPath(path->value, op.path)) {
+            PAJLADA_REPORT_ERROR(error)
+            return;
+        }
+
+        std::string_view kind(name->value.GetString(),
+                              name->value.GetStringLength());
+
+        auto value = operation.FindMember("value");
+        op.value = value != operation.MemberEnd() ? &value->value : nullptr;
+
+        bool ok = false;
+        if (kind == "add" || kind == "replace" || kind == "test") {
+            if (op.value != nullptr) {
+                ok = run(kind == "add"       ? PatchOperation::Kind::Add
+                         : kind == "replace" ? PatchOperation::Kind::Replace
+                                             : PatchOperation::Kind::Test);
+            }
+        } else if (kind == "remove") {
+            ok = run(PatchOperation::Kind::Remove);
+        } else if (kind == "move" || kind == "copy") {
+            auto source = operation.FindMember("from");
+            ok = source != operation.MemberEnd() &&
+                 detail::PatchPath(source->value, from);
+
+            // A value can't be moved into one of its own children
+            if (ok && kind == "move" && from.size() < op.path.size() &&
+                std::equal(from.begin(), from.end(), op.path.begin())) {
+                ok = false;
+            }
+
+            if (ok) {
+                std::swap(op.path, from);
+                op.result = &moved;
+                ok = run(PatchOperation::Kind::Get);
+                if (ok && kind == "move") {
+                    ok = run(PatchOperation::Kind::Remove);
+                }
+                std::swap(op.path, from);
+
+                op.value = &moved;
+                ok = ok && run(PatchOperation::Kind::Add);
+            }
+        }
+
+        if (!ok) {
+            PAJLADA_REPORT_ERROR(error)
+            return;
+        }
+    }
+}
+
+}  // namespace pajlada
@@ -0,0 +1,682 @@
+#pragma once
+
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <any>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <pajlada/serialize/serialize.hpp>
+#include <pajlada/serialize/trace.hpp>
+#include <pajlada/serialize/variant.hpp>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+namespace pajlada {
+
+// SerializeTo is the streaming counterpart of Serialize.
+// Instead of building a rapidjson::Value tree, it emits SAX events straight
+// into a rapidjson Handler (e.g. a rapidjson::Writer), so no intermediate DOM
+// is ever allocated.
+//
+// Every specialization returns false as soon as the handler returns false,
+// following rapidjson's Handler convention.
+
+// Types without a streaming specialization are serialized through the DOM
+// using their Serialize specialization, and then replayed into the handler
+template <typename Type, typename Enable = void>
+struct SerializeTo {
+    template <typename Handler>
+    static bool
+    write(const Type &value, Handler &handler)
+    {
+        rapidjson::Document d;
+
+        return Serialize<Type>::get(value, d.GetAllocator()).Accept(handler);
+    }
+};
+
+template <>
+struct SerializeTo<bool> {
+    template <typename Handler>
+    static bool
+    write(const bool &value, Handler &handler)
+    {
+        return handler.Bool(value);
+    }
+};
+
+template <typename Type>
+struct SerializeTo<
+    Type, typename std::enable_if<std::is_integral<Type>::value &&
+                                  std::is_signed<Type>::value>::type> {
+    template <typename Handler>
+    static bool
+    write(const Type &value, Handler &handler)
+    {
+        if constexpr (sizeof(Type) <= sizeof(int)) {
+            return handler.Int(value);
+        } else {
+            return handler.Int64(static_cast<int64_t>(value));
+        }
+    }
+};
+
+template <typename Type>
+struct SerializeTo<
+    Type, typename std::enable_if<std::is_integral<Type>::value &&
+                                  std::is_unsigned<Type>::value &&
+                                  !std::is_same<Type, bool>::value>::type> {
+    template <typename Handler>
+    static bool
+    write(const Type &value, Handler &handler)
+    {
+        if constexpr (sizeof(Type) <= sizeof(unsigned)) {
+            return handler.Uint(value);
+        } else {
+            return handler.Uint64(static_cast<uint64_t>(value));
+        }
+    }
+};
+
+template <typename Type>
+struct SerializeTo<
+    Type, typename std::enable_if<std::is_floating_point<Type>::value>::type> {
+    template <typename Handler>
+    static bool
+    write(const Type &value, Handler &handler)
+    {
+        if (std::isnan(value) || std::isinf(value)) {
+            return handler.Null();
+        }
+
+        return handler.Double(static_cast<double>(value));
+    }
+};
+
+template <>
+struct SerializeTo<std::string> {
+    template <typename Handler>
+    static bool
+    write(const std::string &value, Handler &handler)
+    {
+        return handler.String(value.data(),
+                              static_cast<rapidjson::SizeType>(value.size()),
+                              true);
+    }
+};
+
+template <>
+struct SerializeTo<std::string_view> {
+    template <typename Handler>
+    static bool
+    write(const std::string_view &value, Handler &handler)
+    {
+        // Same workaround as Serialize<std::string_view>: never hand the
+        // handler a null pointer for an empty string
+        const auto *data = value.data();
+        return handler.String(data ? data : "",
+                              static_cast<rapidjson::SizeType>(value.size()),
+                              true);
+    }
+};
+
+template <typename Arg1, typename Arg2>
+struct SerializeTo<std::pair<Arg1, Arg2>> {
+    template <typename Handler>
+    static bool
+    write(const std::pair<Arg1, Arg2> &value, Handler &handler)
+    {
+        return handler.StartArray() &&
+               SerializeTo<Arg1>::write(value.first, handler) &&
+               SerializeTo<Arg2>::write(value.second, handler) &&
+               handler.EndArray(2);
+    }
+};
+
+namespace detail {
+
+// Type of the JSON value text starts with, as needed by Handler::RawValue
+inline rapidjson::Type
+RawValueType(char first)
+{
+    switch (first) {
+        case '{':
+            return rapidjson::kObjectType;
+        case '[':
+            return rapidjson::kArrayType;
+        case '"':
+            return rapidjson::kStringType;
+        case 't':
+            return rapidjson::kTrueType;
+        case 'f':
+            return rapidjson::kFalseType;
+        case 'n':
+            return rapidjson::kNullType;
+        default:
+            return rapidjson::kNumberType;
+    }
+}
+
+template <typename Handler>
+inline constexpr bool IsWriter = false;
+
+// Only plain writers, a PrettyWriter would leave raw values unindented
+template <typename OutputStream, typename TargetEncoding,
+          typename StackAllocator, unsigned writeFlags>
+inline constexpr bool
+    IsWriter<rapidjson::Writer<OutputStream, rapidjson::UTF8<>,
+                               TargetEncoding, StackAllocator, writeFlags>> =
+        true;
+
+// Writes an array of integers for a rapidjson::Writer.
+// The numbers are formatted into a local buffer with std::to_chars and handed
+// to the writer a buffer at a time through RawValue, rather than going
+// through the writer's bookkeeping for every single number. The writer puts a
+// comma between two raw values just like between two numbers, so the output
+// is the same
+template <typename Type, typename Handler>
+inline bool
+WriteIntegers(const Type *values, size_t size, Handler &handler)
+{
+    // Fits the longest integer (INT64_MIN) and a comma
+    constexpr size_t MaxLength = 21;
+
+    if (!handler.StartArray()) {
+        return false;
+    }
+
+    char buffer[4096];
+    size_t i = 0;
+    while (i < size) {
+        char *p = buffer;
+        for (; i < size && p + MaxLength <= std::end(buffer); ++i) {
+            if (p != buffer) {
+                *p++ = ',';
+            }
+            p = std::to_chars(p, std::end(buffer), values[i]).ptr;
+        }
+
+        if (!handler.RawValue(buffer, static_cast<size_t>(p - buffer),
+                              rapidjson::kNumberType)) {
+            return false;
+        }
+    }
+
+    return handler.EndArray(static_cast<rapidjson::SizeType>(size));
+}
+
+// Values written by writeParallel on other threads, kept as JSON text until
+// they're handed to the real handler in order
+class RawChunk
+{
+public:
+    RawChunk() = default;
+
+    RawChunk(const RawChunk &) = delete;
+    RawChunk &operator=(const RawChunk &) = delete;
+
+    template <typename Type>
+    void
+    write(const Type &value)
+    {
+        // Every value is a root of its own
+        this->writer_.Reset(this->buffer_);
+        if (!SerializeTo<Type>::write(value, this->writer_)) {
+            this->ok_ = false;
+        }
+        this->ends_.push_back(this->buffer_.GetSize());
+    }
+
+    bool
+    ok() const
+    {
+        return this->ok_;
+    }
+
+    size_t
+    size() const
+    {
+        return this->ends_.size();
+    }
+
+    // Passes the value at index on to handler
+    template <typename Handler>
+    bool
+    writeTo(size_t index, Handler &handler) const
+    {
+        auto begin = index == 0 ? 0 : this->ends_[index - 1];
+        const auto *json = this->buffer_.GetString() + begin;
+
+        return handler.RawValue(json, this->ends_[index] - begin,
+                                RawValueType(json[0]));
+    }
+
+private:
+    rapidjson::StringBuffer buffer_;
+    rapidjson::Writer<rapidjson::StringBuffer> writer_{buffer_};
+    std::vector<size_t> ends_;
+    bool ok_ = true;
+};
+
+// Writes write(element) for every element of container into one RawChunk
+// per chunk on executor
+template <typename Container, typename Executor, typename Write>
+inline std::vector<RawChunk>
+WriteRawChunks(const Container &container, const ChunkPlan &chunks,
+               Executor &executor, Write write)
+{
+    // std::map can't skip ahead, so find where each chunk starts up front
+    std::vector<typename Container::const_iterator> starts;
+    starts.reserve(chunks.count);
+    auto start = container.begin();
+    size_t position = 0;
+    for (size_t chunk = 0; chunk < chunks.count; ++chunk) {
+        auto begin = chunks.range(chunk).first;
+        std::advance(start, begin - position);
+        position = begin;
+        starts.push_back(start);
+    }
+
+    std::vector<RawChunk> parts(chunks.count);
+
+    executor.run(chunks.count, [&](size_t chunk) {
+        auto [begin, end] = chunks.range(chunk);
+        auto element = starts[chunk];
+        for (size_t i = begin; i < end; ++i, ++element) {
+            write(parts[chunk], *element);
+        }
+    });
+
+    return parts;
+}
+
+template <typename Handler, typename Key,
+          typename std::enable_if<IsStringKey<Key>>::type * = nullptr>
+inline bool
+WriteKey(Handler &handler, const Key &key)
+{
+    const auto *data = key.data();
+    return handler.Key(data ? data : "",
+                       static_cast<rapidjson::SizeType>(key.size()), true);
+}
+
+template <typename Handler, typename Key,
+          typename std::enable_if<IsNumberKey<Key>>::type * = nullptr>
+inline bool
+WriteKey(Handler &handler, Key key)
+{
+    char buffer[MaxNumberKeyLength];
+    auto length = FormatNumberKey(key, buffer);
+    return handler.Key(buffer, static_cast<rapidjson::SizeType>(length), true);
+}
+
+}  // namespace detail
+
+template <typename Key, typename ValueType>
+struct SerializeTo<
+    std::map<Key, ValueType>,
+    typename std::enable_if<detail::IsMapKey<Key>>::type> {
+    template <typename Handler>
+    static bool
+    write(const std::map<Key, ValueType> &value, Handler &handler)
+    {
+        if (!handler.StartObject()) {
+            return false;
+        }
+
+        for (const auto &[key, innerValue] : value) {
+            if (!detail::WriteKey(handler, key)) {
+                return false;
+            }
+            if (!SerializeTo<ValueType>::write(innerValue, handler)) {
+                return false;
+            }
+        }
+
+        return handler.EndObject(
+            static_cast<rapidjson::SizeType>(value.size()));
+    }
+
+    // Writes the values on executor, see ThreadPool in parallel.hpp.
+    // Each chunk is written by a rapidjson::Writer into a buffer of its own,
+    // and handed to handler through RawValue. The output is the same as
+    // write's when handler is a rapidjson::Writer with the default flags
+    template <typename Handler, typename Executor>
+    static bool
+    writeParallel(const std::map<Key, ValueType> &value, Handler &handler,
+                  Executor &executor)
+    {
+        auto chunks =
+            detail::PlanChunks(value.size(), executor.concurrency());
+        if (chunks.count <= 1) {
+            return write(value, handler);
+        }
+
+        auto parts = detail::WriteRawChunks(
+            value, chunks, executor,
+            [](detail::RawChunk &part, const auto &entry) {
+                part.write(entry.second);
+            });
+
+        if (!handler.StartObject()) {
+            return false;
+        }
+
+        auto entry = value.begin();
+        for (const auto &part : parts) {
+            if (!part.ok()) {
+                return false;
+            }
+            for (size_t i = 0; i < part.size(); ++i, ++entry) {
+                if (!detail::WriteKey(handler, entry->first) ||
+                    !part.writeTo(i, handler)) {
+                    return false;
+                }
+            }
+        }
+
+        return handler.EndObject(
+            static_cast<rapidjson::SizeType>(value.size()));
+    }
+};
+
+template <typename ValueType>
+struct SerializeTo<std::vector<ValueType>> {
+    template <typename Handler>
+    static bool
+    write(const std::vector<ValueType> &value, Handler &handler)
+    {
+        if constexpr (detail::IsInteger<ValueType> &&
+                      detail::IsWriter<Handler>) {
+            return detail::WriteIntegers(value.data(), value.size(), handler);
+        }
+
+        if (!handler.StartArray()) {
+            return false;
+        }
+
+        for (const auto &innerValue : value) {
+            if (!SerializeTo<ValueType>::write(innerValue, handler)) {
+                return false;
+            }
+        }
+
+        return handler.EndArray(static_cast<rapidjson::SizeType>(value.size()));
+    }
+
+    // Writes the elements on executor, see ThreadPool in parallel.hpp.
+    // Each chunk is written by a rapidjson::Writer into a buffer of its own,
+    // and handed to handler through RawValue. The output is the same as
+    // write's when handler is a rapidjson::Writer with the default flags
+    template <typename Handler, typename Executor>
+    static bool
+    writeParallel(const std::vector<ValueType> &value, Handler &handler,
+                  Executor &executor)
+    {
+        auto chunks =
+            detail::PlanChunks(value.size(), executor.concurrency());
+        if (chunks.count <= 1) {
+            return write(value, handler);
+        }
+
+        auto parts = detail::WriteRawChunks(
+            value, chunks, executor,
+            [](detail::RawChunk &part, const ValueType &element) {
+                part.write(element);
+            });
+
+        if (!handler.StartArray()) {
+            return false;
+        }
+
+        for (const auto &part : parts) {
+            if (!part.ok()) {
+                return false;
+            }
+            for (size_t i = 0; i < part.size(); ++i) {
+                if (!part.writeTo(i, handler)) {
+                    return false;
+                }
+            }
+        }
+
+        return handler.EndArray(static_cast<rapidjson::SizeType>(value.size()));
+    }
+};
+
+template <typename ValueType, size_t Size>
+struct SerializeTo<std::array<ValueType, Size>> {
+    template <typename Handler>
+    static bool
+    write(const std::array<ValueType, Size> &value, Handler &handler)
+    {
+        if constexpr (detail::IsInteger<ValueType> &&
+                      detail::IsWriter<Handler>) {
+            return detail::WriteIntegers(value.data(), Size, handler);
+        }
+
+        if (!handler.StartArray()) {
+            return false;
+        }
+
+        for (const auto &innerValue : value) {
+            if (!SerializeTo<ValueType>::write(innerValue, handler)) {
+                return false;
+            }
+        }
+
+        return handler.EndArray(static_cast<rapidjson::SizeType>(Size));
+    }
+};
+
+namespace detail {
+
+// Passes what the registered writers write on to Handler
+template <typename Handler>
+class AnySinkFor final : public AnySink
+{
+public:
+    explicit AnySinkFor(Handler &handler)
+        : handler_(handler)
+    {
+    }
+
+    bool
+    Null() override
+    {
+        return this->handler_.Null();
+    }
+
+    bool
+    Bool(bool b) override
+    {
+        return this->handler_.Bool(b);
+    }
+
+    bool
+    Int(int i) override
+    {
+        return this->handler_.Int(i);
+    }
+
+    bool
+    Uint(unsigned u) override
+    {
+        return this->handler_.Uint(u);
+    }
+
+    bool
+    Int64(int64_t i) override
+    {
+        return this->handler_.Int64(i);
+    }
+
+    bool
+    Uint64(uint64_t u) override
+    {
+        return this->handler_.Uint64(u);
+    }
+
+    bool
+    Double(double d) override
+    {
+        return this->handler_.Double(d);
+    }
+
+    bool
+    RawNumber(const char *str, rapidjson::SizeType length, bool copy) override
+    {
+        return this->handler_.RawNumber(str, length, copy);
+    }
+
+    bool
+    String(const char *str, rapidjson::SizeType length, bool copy) override
+    {
+        return this->handler_.String(str, length, copy);
+    }
+
+    bool
+    StartObject() override
+    {
+        return this->handler_.StartObject();
+    }
+
+    bool
+    Key(const char *str, rapidjson::SizeType length, bool copy) override
+    {
+        return this->handler_.Key(str, length, copy);
+    }
+
+    bool
+    EndObject(rapidjson::SizeType memberCount) override
+    {
+        return this->handler_.EndObject(memberCount);
+    }
+
+    bool
+    StartArray() override
+    {
+        return this->handler_.StartArray();
+    }
+
+    bool
+    EndArray(rapidjson::SizeType elementCount) override
+    {
+        return this->handler_.EndArray(elementCount);
+    }
+
+private:
+    Handler &handler_;
+};
+
+}  // namespace detail
+
+template <>
+struct SerializeTo<std::any> {
+    template <typename Handler>
+    static bool
+    write(const std::any &value, Handler &handler)
+    {
+        if (!value.has_value()) {
+            return handler.Null();
+        }
+
+        auto write = AnyRegistry<>::instance().findWriter(value.type());
+        if (write == nullptr) {
+            return handler.Null();
+        }
+
+        // std::any values nested inside this one are written to the same sink
+        if constexpr (std::is_base_of<detail::AnySink, Handler>::value) {
+            return write(value, handler);
+        } else {
+            detail::AnySinkFor<Handler> sink(handler);
+            return write(value, sink);
+        }
+    }
+};
+
+template <class... InnerTypes>
+struct SerializeTo<std::variant<InnerTypes...>> {
+    template <typename Handler>
+    static bool
+    write(const std::variant<InnerTypes...> &value, Handler &handler)
+    {
+        using Variant = std::variant<InnerTypes...>;
+
+        // A handler that gave up counts as an error
+        detail::TraceScope<Variant> trace(TraceOperation::SerializeTo);
+        trace.setError(true);
+
+        auto writeInner = [&handler, &value] {
+            return std::visit(
+                [&handler](const auto &arg) -> bool {
+                    using ActualType = std::decay_t<decltype(arg)>;
+                    return SerializeTo<ActualType>::write(arg, handler);
+                },
+                value);
+        };
+
+        if constexpr (!VariantTag<Variant>::enabled) {
+            bool ok = writeInner();
+            trace.setError(!ok);
+            return ok;
+        } else {
+            const auto &typeKey = detail::VariantTypeKey;
+            const auto &valueKey = detail::VariantValueKey;
+
+            if (!handler.StartObject() ||
+                !handler.Key(typeKey.data(),
+                             static_cast<rapidjson::SizeType>(typeKey.size()),
+                             false)) {
+                return false;
+            }
+
+            bool tagWritten = false;
+            if constexpr (detail::HasVariantNames<Variant>) {
+                const auto &name = VariantTag<Variant>::names[value.index()];
+                tagWritten = handler.String(
+                    name.data(), static_cast<rapidjson::SizeType>(name.size()),
+                    false);
+            } else {
+                tagWritten = handler.Uint64(value.index());
+            }
+
+            bool ok =
+                tagWritten &&
+                handler.Key(valueKey.data(),
+                            static_cast<rapidjson::SizeType>(valueKey.size()),
+                            false) &&
+                writeInner() && handler.EndObject(2);
+            trace.setError(!ok);
+            return ok;
+        }
+    }
+};
+
+template <class InnerType>
+struct SerializeTo<std::optional<InnerType>> {
+    template <typename Handler>
+    static bool
+    write(const std::optional<InnerType> &value, Handler &handler)
+    {
+        if (value.has_value()) {
+            return SerializeTo<InnerType>::write(value.value(), handler);
+        }
+
+        return handler.Null();
+    }
+};
+
+}  // namespace pajlada
@@ -5,12 +5,20 @@
 #include <any>
 #include <cassert>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <map>
 #include <optional>
 #include <pajlada/serialize/common.hpp>
-#include <pajlada/serialize/internal.hpp>
+#include <pajlada/serialize/trace.hpp>
+#include <pajlada/serialize/variant.hpp>
 #include <stdexcept>
+#include <string>
+#include <string_view>
+#include <typeindex>
 #include <typeinfo>
+#include <unordered_map>
 #include <variant>
 #include <vector>
 
@@ -28,6 +36,10 @@ inline void PushBack(RJValue &array, const Type &value,
 
 }  // namespace detail
 
+// Defined in serialize-to.hpp
+template <typename Type, typename Enable>
+struct SerializeTo;
+
 // Serialize is called when a settings value is being saved
 
 // Create a rapidjson::Value from the templated value
@@ -75,7 +87,8 @@ struct Serialize<std::string, RJValue> {
     static RJValue
     get(const std::string &value, typename RJValue::AllocatorType &a)
     {
-        RJValue ret(value.c_str(), a);
+        RJValue ret(value.data(),
+                    static_cast<rapidjson::SizeType>(value.size()), a);
 
         return ret;
     }
@@ -103,6 +116,7 @@ struct Serialize<std::pair<Arg1, Arg2>, RJValue> {
     get(const std::pair<Arg1, Arg2> &value, typename RJValue::AllocatorType &a)
     {
         RJValue ret(rapidjson::kArrayType);
+        ret.Reserve(2, a);
 
         ret.PushBack(Serialize<Arg1, RJValue>::get(value.first, a), a);
         ret.PushBack(Serialize<Arg2, RJValue>::get(value.second, a), a);
@@ -111,6 +125,38 @@ struct Serialize<std::pair<Arg1, Arg2>, RJValue> {
     }
 };
 
+namespace detail {
+
+// Member name for a map key
+template <typename RJValue>
+inline RJValue
+MapKey(const std::string &key, typename RJValue::AllocatorType &a)
+{
+    return RJValue(key.data(), static_cast<rapidjson::SizeType>(key.size()),
+                   a);
+}
+
+template <typename RJValue>
+inline RJValue
+MapKey(std::string_view key, typename RJValue::AllocatorType &a)
+{
+    return Serialize<std::string_view, RJValue>::get(key, a);
+}
+
+// Number keys are formatted on the stack, the only allocation is the name's
+// copy in a
+template <typename RJValue, typename Key,
+          typename std::enable_if<IsNumberKey<Key>>::type * = nullptr>
+inline RJValue
+MapKey(Key key, typename RJValue::AllocatorType &a)
+{
+    char buffer[MaxNumberKeyLength];
+    auto length = FormatNumberKey(key, buffer);
+    return RJValue(buffer, static_cast<rapidjson::SizeType>(length), a);
+}
+
+}  // namespace detail
+
 template <typename ValueType, typename RJValue>
 struct Serialize<std::map<std::string, ValueType>, RJValue> {
     static RJValue
@@ -118,10 +164,57 @@ struct Serialize<std::map<std::string, ValueType>, RJValue> {
         typename RJValue::AllocatorType &a)
     {
         RJValue ret(rapidjson::kObjectType);
+        detail::MemberReserve(
+            ret, static_cast<rapidjson::SizeType>(value.size()), a);
+
+        for (const auto &[key, innerValue] : value) {
+            ret.AddMember(detail::MapKey<RJValue>(key, a).Move(),
+                          Serialize<ValueType, RJValue>::get(innerValue, a),
+                          a);
+        }
+
+        return ret;
+    }
+};
+
+template <typename ValueType, typename RJValue>
+struct Serialize<std::map<std::string_view, ValueType>, RJValue> {
+    static RJValue
+    get(const std::map<std::string_view, ValueType> &value,
+        typename RJValue::AllocatorType &a)
+    {
+        RJValue ret(rapidjson::kObjectType);
+        detail::MemberReserve(
+            ret, static_cast<rapidjson::SizeType>(value.size()), a);
+
+        for (const auto &[key, innerValue] : value) {
+            ret.AddMember(
+                Serialize<std::string_view, RJValue>::get(key, a).Move(),
+                Serialize<ValueType, RJValue>::get(innerValue, a), a);
+        }
+
+        return ret;
+    }
+};
+
+// Integer and enum keys, written as their digits
+template <typename Key, typename ValueType, typename RJValue>
+struct Serialize<std::map<Key, ValueType>, RJValue> {
+    static_assert(detail::IsNumberKey<Key>,
+                  "Map keys must be strings, integers or enums");
+
+    static RJValue
+    get(const std::map<Key, ValueType> &value,
+        typename RJValue::AllocatorType &a)
+    {
+        RJValue ret(rapidjson::kObjectType);
+        detail::MemberReserve(
+            ret, static_cast<rapidjson::SizeType>(value.size()), a);
 
-        for (auto it = value.begin(); it != value.end(); ++it) {
-            detail::AddMember<ValueType, RJValue>(ret, it->first.c_str(),
-                                                  it->second, a);
+        for (const auto &[key, innerValue] : value) {
+            ret.AddMember(detail::MapKey<RJValue>(key, a).Move(),
+                          Serialize<ValueType, RJValue>::get(innerValue, a),
+                          a);
         }
 
         return ret;
@@ -134,6 +227,7 @@ struct Serialize<std::vector<ValueType>, RJValue> {
     get(const std::vector<ValueType> &value, typename RJValue::AllocatorType &a)
     {
         RJValue ret(rapidjson::kArrayType);
+        ret.Reserve(static_cast<rapidjson::SizeType>(value.size()), a);
 
         for (const auto &innerValue : value) {
             detail::PushBack(ret, innerValue, a);
@@ -150,6 +244,7 @@ struct Serialize<std::array<ValueType, Size>, RJValue> {
         typename RJValue::AllocatorType &a)
     {
         RJValue ret(rapidjson::kArrayType);
+        ret.Reserve(static_cast<rapidjson::SizeType>(Size), a);
 
         for (size_t i = 0; i < Size; i++) {
             detail::PushBack(ret, value[i], a);
@@ -159,44 +254,172 @@ struct Serialize<std::array<ValueType, Size>, RJValue> {
     }
 };
 
+namespace detail {
+
+template <typename Type, typename RJValue>
+RJValue
+SerializeAnyAs(const std::any &value, typename RJValue::AllocatorType &a)
+{
+    // any_cast on a pointer never copies the contained value
+    return Serialize<Type, RJValue>::get(*std::any_cast<Type>(&value), a);
+}
+
+template <typename RJValue>
+RJValue
+SerializeAnyCString(const std::any &value, typename RJValue::AllocatorType &a)
+{
+    return Serialize<std::string_view, RJValue>::get(
+        *std::any_cast<const char *>(&value), a);
+}
+
+// A SAX handler that std::any values are written to, so the registered
+// writers don't need to know the type of the handler behind it
+class AnySink
+{
+public:
+    virtual ~AnySink() = default;
+
+    virtual bool Null() = 0;
+    virtual bool Bool(bool b) = 0;
+    virtual bool Int(int i) = 0;
+    virtual bool Uint(unsigned u) = 0;
+    virtual bool Int64(int64_t i) = 0;
+    virtual bool Uint64(uint64_t u) = 0;
+    virtual bool Double(double d) = 0;
+    virtual bool RawNumber(const char *str, rapidjson::SizeType length,
+                           bool copy) = 0;
+    virtual bool String(const char *str, rapidjson::SizeType length,
+                        bool copy) = 0;
+    virtual bool StartObject() = 0;
+    virtual bool Key(const char *str, rapidjson::SizeType length,
+                     bool copy) = 0;
+    virtual bool EndObject(rapidjson::SizeType memberCount) = 0;
+    virtual bool StartArray() = 0;
+    virtual bool EndArray(rapidjson::SizeType elementCount) = 0;
+};
+
+// Writes the Type held by value using SerializeTo<As>
+template <typename Type, typename As = Type>
+bool
+WriteAnyAs(const std::any &value, AnySink &sink)
+{
+    return SerializeTo<As, void>::write(*std::any_cast<Type>(&value), sink);
+}
+
+}  // namespace detail
+
+// Maps the type held by a std::any to the functions serializing it, one
+// building a DOM value for Serialize and one writing it to a handler for
+// SerializeTo.
+// There is one registry per RJValue type, and it starts out knowing about the
+// types Deserialize<std::any> produces (plus float and const char *).
+// SerializeTo always uses the registry for rapidjson::Value.
+//
+// Registering types is not thread-safe, so do it before serializing anything
+// on other threads
+template <typename RJValue = rapidjson::Value>
+class AnyRegistry
+{
+public:
+    using Function = RJValue (*)(const std::any &,
+                                 typename RJValue::AllocatorType &);
+    using WriteFunction = bool (*)(const std::any &, detail::AnySink &);
+
+    static AnyRegistry &
+    instance()
+    {
+        static AnyRegistry registry;
+        return registry;
+    }
+
+    // Serialize std::any values holding a Type using Serialize<Type, RJValue>
+    // and SerializeTo<Type>
+    template <typename Type>
+    void
+    add()
+    {
+        this->entries_[std::type_index(typeid(Type))] = {
+            &detail::SerializeAnyAs<Type, RJValue>,
+            &detail::WriteAnyAs<Type>,
+        };
+    }
+
+    // Returns nullptr if type isn't registered
+    Function
+    find(const std::type_info &type) const
+    {
+        const auto *entry = this->entry(type);
+        return entry != nullptr ? entry->serialize : nullptr;
+    }
+
+    // Returns nullptr if type isn't registered
+    WriteFunction
+    findWriter(const std::type_info &type) const
+    {
+        const auto *entry = this->entry(type);
+        return entry != nullptr ? entry->write : nullptr;
+    }
+
+private:
+    struct Entry {
+        Function serialize;
+        WriteFunction write;
+    };
+
+    AnyRegistry()
+    {
+        this->add<int>();
+        this->add<float>();
+        this->add<double>();
+        this->add<bool>();
+        this->add<std::string>();
+        this->add<std::map<std::string, std::any>>();
+        this->add<std::vector<std::any>>();
+        this->add<std::vector<std::string>>();
+        this->entries_[std::type_index(typeid(const char *))] = {
+            &detail::SerializeAnyCString<RJValue>,
+            &detail::WriteAnyAs<const char *, std::string_view>,
+        };
+    }
+
+    const Entry *
+    entry(const std::type_info &type) const
+    {
+        auto it = this->entries_.find(std::type_index(type));
+        if (it == this->entries_.end()) {
+            return nullptr;
+        }
+
+        return &it->second;
+    }
+
+    std::unordered_map<std::type_index, Entry> entries_;
+};
+
+// Make std::any values holding a Type serializable
+template <typename Type, typename RJValue = rapidjson::Value>
+void
+RegisterAnyType()
+{
+    AnyRegistry<RJValue>::instance().template add<Type>();
+}
+
 template <typename RJValue>
 struct Serialize<std::any, RJValue> {
     static RJValue
     get(const std::any &value, typename RJValue::AllocatorType &a)
     {
-        using std::any_cast;
-
         if (!value.has_value()) {
             return RJValue(rapidjson::kNullType);
         }
 
-        if (value.type() == typeid(int)) {
-            return Serialize<int, RJValue>::get(any_cast<int>(value), a);
-        } else if (value.type() == typeid(float)) {
-            return Serialize<float, RJValue>::get(any_cast<float>(value), a);
-        } else if (value.type() == typeid(double)) {
-            return Serialize<double, RJValue>::get(any_cast<double>(value), a);
-        } else if (value.type() == typeid(bool)) {
-            return Serialize<bool, RJValue>::get(any_cast<bool>(value), a);
-        } else if (value.type() == typeid(std::string)) {
-            return Serialize<std::string, RJValue>::get(
-                any_cast<std::string>(value), a);
-        } else if (value.type() == typeid(const char *)) {
-            return Serialize<std::string, RJValue>::get(
-                any_cast<const char *>(value), a);
-        } else if (value.type() == typeid(std::map<std::string, std::any>)) {
-            return Serialize<std::map<std::string, std::any>, RJValue>::get(
-                any_cast<std::map<std::string, std::any>>(value), a);
-        } else if (value.type() == typeid(std::vector<std::any>)) {
-            return Serialize<std::vector<std::any>, RJValue>::get(
-                any_cast<std::vector<std::any>>(value), a);
-        } else if (value.type() == typeid(std::vector<std::string>)) {
-            return Serialize<std::vector<std::string>, RJValue>::get(
-                any_cast<std::vector<std::string>>(value), a);
-        } else {
-            // PS_DEBUG("[std::any] Serialize: Unknown type of value");
+        if (auto serialize =
+                AnyRegistry<RJValue>::instance().find(value.type())) {
+            return serialize(value, a);
         }
 
+        // PS_DEBUG("[std::any] Serialize: Unknown type of value");
+
         return RJValue(rapidjson::kNullType);
     }
 };
@@ -207,14 +430,46 @@ struct Serialize<std::variant<InnerTypes...>, RJValue> {
     get(const std::variant<InnerTypes...> &value,
         typename RJValue::AllocatorType &a)
     {
-        PSE_DEBUG("serializing variant");
+        detail::TraceScope<std::variant<InnerTypes...>> trace(
+            TraceOperation::Serialize);
+        const auto used = trace.allocatorSize(a);
 
-        return std::visit(
+        auto inner = std::visit(
             [&a](auto &&arg) -> RJValue {
                 using ActualType = std::decay_t<decltype(arg)>;
-                return Serialize<ActualType>::get(arg, a);
+                return Serialize<ActualType, RJValue>::get(arg, a);
             },
             value);
+
+        if constexpr (!VariantTag<std::variant<InnerTypes...>>::enabled) {
+            trace.setBytes(trace.allocatorSize(a) - used);
+            return inner;
+        } else {
+            using Variant = std::variant<InnerTypes...>;
+
+            RJValue ret(rapidjson::kObjectType);
+            detail::MemberReserve(ret, 2, a);
+
+            RJValue tag;
+            if constexpr (detail::HasVariantNames<Variant>) {
+                const auto &name = VariantTag<Variant>::names[value.index()];
+                tag.SetString(rapidjson::StringRef(
+                    name.data(),
+                    static_cast<rapidjson::SizeType>(name.size())));
+            } else {
+                tag.SetUint64(value.index());
+            }
+
+            ret.AddMember(rapidjson::StringRef(detail::VariantTypeKey.data(),
+                                               detail::VariantTypeKey.size()),
+                          tag, a);
+            ret.AddMember(rapidjson::StringRef(detail::VariantValueKey.data(),
+                                               detail::VariantValueKey.size()),
+                          inner, a);
+
+            trace.setBytes(trace.allocatorSize(a) - used);
+            return ret;
+        }
     }
 };
 
@@ -224,11 +479,8 @@ struct Serialize<std::optional<InnerType>, RJValue> {
     get(const std::optional<InnerType> &value,
         typename RJValue::AllocatorType &a)
     {
-        PSE_DEBUG("serializing optional '" << internal::type_name<InnerType>()
-                                           << '\'');
-
         if (value.has_value()) {
-            return Serialize<InnerType>::get(value.value(), a);
+            return Serialize<InnerType, RJValue>::get(value.value(), a);
         }
 
         return RJValue{rapidjson::kNullType};
@@ -260,3 +512,6 @@ PushBack(RJValue &array, const Type &value, typename RJValue::AllocatorType &a)
 }  // namespace detail
 
 }  // namespace pajlada
+
+// The std::any writers AnyRegistry keeps need SerializeTo
+#include <pajlada/serialize/serialize-to.hpp>
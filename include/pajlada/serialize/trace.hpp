@@ -0,0 +1,226 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <pajlada/serialize/internal-typename.hpp>
+#include <string_view>
+
+// Counting and timing what the library does, per type.
+//
+// Tracing is compiled in by defining PAJLADA_SERIALIZE_TRACE, which must be
+// done the same way for every translation unit. Without it the hooks compile
+// to nothing. With it, every traced call hands a TraceRecord to the sink
+// installed with SetTraceSink, or costs an atomic load if there is none:
+//
+//   class Counters : public pajlada::TraceSink
+//   {
+//   public:
+//       void
+//       record(const pajlada::TraceRecord &record) override
+//       {
+//           // e.g. add to a table of this thread's counters, keyed by
+//           // record.type, and sum up the tables when they're dumped
+//       }
+//   };
+//
+//   Counters counters;
+//   pajlada::SetTraceSink(&counters);
+//
+// Traced are structs using PAJLADA_SERIALIZE_FIELDS (all four operations),
+// std::variant (Serialize, Deserialize and SerializeTo), and LoadFile and
+// SaveFile for the type they load or save. Nested values are traced as
+// well, and the time and bytes of a call include theirs.
+
+namespace pajlada {
+
+enum class TraceOperation {
+    Serialize,
+    Deserialize,
+    SerializeTo,
+    DeserializeFrom,
+    LoadFile,
+    SaveFile,
+};
+
+// There's exactly one TraceType per traced type, so sinks can key their
+// tables by its address instead of hashing the name
+struct TraceType {
+    // As given by internal::type_name, e.g. "std::variant<int, bool>"
+    std::string_view name;
+};
+
+// One traced call
+struct TraceRecord {
+    const TraceType *type = nullptr;
+    TraceOperation operation = TraceOperation::Serialize;
+
+    std::chrono::nanoseconds elapsed{};
+
+    // Serialize: what the value took from its allocator, if the allocator
+    // keeps count (rapidjson::MemoryPoolAllocator, ArenaAllocator).
+    // LoadFile/SaveFile: the size of the file
+    size_t bytes = 0;
+
+    // Deserialize of a std::variant: how many alternatives were tried, the
+    // one that matched included
+    size_t alternatives = 0;
+
+    // Errors are seen through the error flag passed to the call, so they're
+    // missed for calls without one, or whose flag was set already
+    bool error = false;
+};
+
+class TraceSink
+{
+public:
+    virtual ~TraceSink() = default;
+
+    // Called on the thread that made the call when it returns. Calls from
+    // getParallel and the like come from several threads at once
+    virtual void record(const TraceRecord &record) = 0;
+};
+
+namespace detail {
+
+#ifdef PAJLADA_SERIALIZE_TRACE
+inline constexpr bool TraceEnabled = true;
+#else
+inline constexpr bool TraceEnabled = false;
+#endif
+
+inline std::atomic<TraceSink *> CurrentTraceSink{nullptr};
+
+template <typename Type>
+inline constexpr TraceType TraceTypeOf{internal::type_name<Type>()};
+
+// Measures one traced call of Type from construction to destruction, and
+// hands the record to the sink that was installed when it started
+template <typename Type, bool Enabled = TraceEnabled>
+class TraceScope
+{
+public:
+    explicit TraceScope(TraceOperation operation)
+        : sink_(CurrentTraceSink.load(std::memory_order_acquire))
+    {
+        if (this->sink_ != nullptr) {
+            this->record_.type = &TraceTypeOf<Type>;
+            this->record_.operation = operation;
+            this->start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+    ~TraceScope()
+    {
+        if (this->sink_ == nullptr) {
+            return;
+        }
+
+        this->record_.elapsed = std::chrono::steady_clock::now() -
+                                this->start_;
+        this->record_.error = this->record_.error ||
+                              (this->watched_ != nullptr && *this->watched_ &&
+                               !this->watchedWasSet_);
+        this->sink_->record(this->record_);
+    }
+
+    // Counts the call as failed if error gets set before it returns
+    void
+    watchError(const bool *error)
+    {
+        this->watched_ = error;
+        this->watchedWasSet_ = error != nullptr && *error;
+    }
+
+    void
+    setError(bool error)
+    {
+        this->record_.error = error;
+    }
+
+    void
+    setBytes(size_t bytes)
+    {
+        this->record_.bytes = bytes;
+    }
+
+    void
+    addAlternative()
+    {
+        ++this->record_.alternatives;
+    }
+
+    // What a has handed out so far, or 0 if it doesn't keep count. The
+    // difference before and after the call is passed to setBytes
+    template <typename Allocator>
+    size_t
+    allocatorSize(const Allocator &a) const
+    {
+        if constexpr (requires { a.Size(); }) {
+            if (this->sink_ != nullptr) {
+                return a.Size();
+            }
+        }
+        return 0;
+    }
+
+private:
+    TraceSink *sink_;
+    TraceRecord record_;
+    std::chrono::steady_clock::time_point start_;
+    const bool *watched_ = nullptr;
+    bool watchedWasSet_ = false;
+};
+
+// Without PAJLADA_SERIALIZE_TRACE every hook is empty
+template <typename Type>
+class TraceScope<Type, false>
+{
+public:
+    explicit TraceScope(TraceOperation /*operation*/)
+    {
+    }
+
+    void
+    watchError(const bool * /*error*/)
+    {
+    }
+
+    void
+    setError(bool /*error*/)
+    {
+    }
+
+    void
+    setBytes(size_t /*bytes*/)
+    {
+    }
+
+    void
+    addAlternative()
+    {
+    }
+
+    template <typename Allocator>
+    size_t
+    allocatorSize(const Allocator & /*a*/) const
+    {
+        return 0;
+    }
+};
+
+}  // namespace detail
+
+// Installs sink for every thread, replacing the previous one which is
+// returned. nullptr turns tracing off. The sink must outlive the calls
+// that were started while it was installed
+inline TraceSink *
+SetTraceSink(TraceSink *sink)
+{
+    return detail::CurrentTraceSink.exchange(sink, std::memory_order_acq_rel);
+}
+
+}  // namespace pajlada
@@ -0,0 +1,328 @@
+#pragma once
+
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <pajlada/serialize/common.hpp>
+#include <pajlada/serialize/deserialize-from.hpp>
+#include <pajlada/serialize/deserialize.hpp>
+#include <pajlada/serialize/serialize-to.hpp>
+#include <pajlada/serialize/serialize.hpp>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace pajlada {
+
+namespace detail {
+
+// The JSON text a Tracked value was last written as. The text of tracked
+// values inside it isn't copied, it stays in their own caches and is
+// referenced from here
+struct TrackedText {
+    // The value's own text, without the tracked values inside it
+    std::string text;
+    // The tracked values inside, with the offset in text they go at
+    std::vector<std::pair<size_t, std::shared_ptr<const TrackedText>>> children;
+    // Length of the whole text, 0 if the value couldn't be written
+    size_t size = 0;
+    rapidjson::Type type = rapidjson::kNullType;
+
+    void
+    appendTo(std::string &out) const
+    {
+        size_t offset = 0;
+        for (const auto &[at, child] : this->children) {
+            out.append(this->text, offset, at - offset);
+            child->appendTo(out);
+            offset = at;
+        }
+        out.append(this->text, offset);
+    }
+};
+
+// Writes a value into a TrackedText, referencing the caches of the tracked
+// values inside it instead of copying their text
+class TrackedWriter : public rapidjson::Writer<rapidjson::StringBuffer>
+{
+public:
+    TrackedWriter(rapidjson::StringBuffer &buffer, TrackedText &out)
+        : rapidjson::Writer<rapidjson::StringBuffer>(buffer)
+        , buffer_(buffer)
+        , out_(out)
+    {
+    }
+
+    bool
+    splice(std::shared_ptr<const TrackedText> child)
+    {
+        if (child->size == 0) {
+            // The value couldn't be written
+            return false;
+        }
+
+        // Only writes the separator in front of the value
+        if (!this->RawValue("", 0, child->type)) {
+            return false;
+        }
+
+        this->out_.children.emplace_back(this->buffer_.GetSize(),
+                                         std::move(child));
+        return true;
+    }
+
+private:
+    rapidjson::StringBuffer &buffer_;
+    TrackedText &out_;
+};
+
+// Writes just like the rapidjson::Writer it is
+template <>
+inline constexpr bool IsWriter<TrackedWriter> = true;
+
+}  // namespace detail
+
+// A value that remembers what it was last serialized to.
+//
+// Serializing a Tracked<Type> that hasn't changed since it was last
+// serialized reuses the JSON text from last time instead of serializing the
+// value again: Serialize parses the text into the caller's allocator,
+// SerializeTo hands it to a rapidjson::Writer as a raw value.
+//
+// Changes have to go through set or mutate so the cache can be thrown away.
+// Nesting tracked values keeps saves cheap for large trees, e.g.
+//
+//   using Channel = Tracked<ChannelSettings>;
+//   Tracked<std::map<std::string, Channel>> channels;
+//
+//   // Only this channel is serialized again on the next save, the others
+//   // come from their caches
+//   channels.mutate()["forsen"].mutate().highlight = true;
+//
+// The cache of a tracked value only holds its own text, the text of tracked
+// values inside it is referenced from their caches, so every part of a tree
+// is kept once no matter how deep it is nested.
+//
+// The cache makes serializing a const Tracked a write, so a Tracked must
+// not be serialized from several threads at once.
+template <typename Type>
+class Tracked
+{
+public:
+    Tracked() = default;
+
+    explicit Tracked(Type value)
+        : value_(std::move(value))
+    {
+    }
+
+    // Copies and moves start out without a cache
+    Tracked(const Tracked &other)
+        : value_(other.value_)
+    {
+    }
+
+    Tracked(Tracked &&other) noexcept
+        : value_(std::move(other.value_))
+    {
+        other.markDirty();
+    }
+
+    Tracked &
+    operator=(const Tracked &other)
+    {
+        this->value_ = other.value_;
+        this->markDirty();
+        return *this;
+    }
+
+    Tracked &
+    operator=(Tracked &&other) noexcept
+    {
+        this->value_ = std::move(other.value_);
+        this->markDirty();
+        other.markDirty();
+        return *this;
+    }
+
+    const Type &
+    get() const
+    {
+        return this->value_;
+    }
+
+    const Type &
+    operator*() const
+    {
+        return this->value_;
+    }
+
+    const Type *
+    operator->() const
+    {
+        return &this->value_;
+    }
+
+    void
+    set(Type value)
+    {
+        this->value_ = std::move(value);
+        this->markDirty();
+    }
+
+    // Marks the value as changed and gives write access to it. The reference
+    // must not be held on to past the next time the value is serialized
+    Type &
+    mutate()
+    {
+        this->markDirty();
+        return this->value_;
+    }
+
+    // Throws away what the value was last serialized to
+    void
+    markDirty()
+    {
+        this->text_.reset();
+    }
+
+    // Returns true if the value changed since it was last serialized
+    bool
+    dirty() const
+    {
+        return this->text_ == nullptr;
+    }
+
+    // Returns the cached text, writing the value again if it changed
+    const std::shared_ptr<const detail::TrackedText> &
+    cachedText() const
+    {
+        if (!this->text_) {
+            auto text = std::make_shared<detail::TrackedText>();
+            rapidjson::StringBuffer buffer;
+            detail::TrackedWriter writer(buffer, *text);
+            if (SerializeTo<Type>::write(this->value_, writer)) {
+                text->text.assign(buffer.GetString(), buffer.GetSize());
+                text->size = text->text.size();
+                for (const auto &[at, child] : text->children) {
+                    text->size += child->size;
+                }
+                text->type = !text->children.empty() &&
+                                     text->children.front().first == 0
+                                 ? text->children.front().second->type
+                                 : detail::RawValueType(text->text[0]);
+            } else {
+                // A size of 0 tells SerializeTo the value can't be written
+                text->children.clear();
+            }
+            this->text_ = std::move(text);
+        }
+
+        return this->text_;
+    }
+
+    // Bytes of text held by the cache, not counting the tracked values
+    // inside it
+    size_t
+    cacheSize() const
+    {
+        return this->text_ ? this->text_->text.size() : 0;
+    }
+
+private:
+    Type value_{};
+
+    mutable std::shared_ptr<const detail::TrackedText> text_;
+};
+
+template <typename Type>
+struct JsonKinds<Tracked<Type>> {
+    static constexpr unsigned value = JsonKinds<Type>::value;
+};
+
+template <typename Type, typename RJValue>
+struct Serialize<Tracked<Type>, RJValue> {
+    static RJValue
+    get(const Tracked<Type> &value, typename RJValue::AllocatorType &a)
+    {
+        const auto &text = value.cachedText();
+        if (text->size == 0) {
+            return Serialize<Type, RJValue>::get(value.get(), a);
+        }
+
+        // Parsing the text straight into a's memory never converts
+        // anything, which makes it cheaper than serializing the value
+        std::string json;
+        json.reserve(text->size);
+        text->appendTo(json);
+
+        rapidjson::GenericDocument<typename RJValue::EncodingType,
+                                   typename RJValue::AllocatorType>
+            d(&a);
+        d.template Parse<rapidjson::kParseFullPrecisionFlag>(json.c_str());
+
+        RJValue ret;
+        ret.Swap(d);
+        return ret;
+    }
+};
+
+template <typename Type, typename RJValue>
+struct Deserialize<Tracked<Type>, RJValue> {
+    static Tracked<Type>
+    get(const RJValue &value, bool *error = nullptr)
+    {
+        return Tracked<Type>(Deserialize<Type, RJValue>::get(value, error));
+    }
+
+    static void
+    into(Tracked<Type> &target, const RJValue &value, bool *error = nullptr)
+    {
+        detail::DeserializeInto<Type, RJValue>(target.mutate(), value, error);
+    }
+};
+
+template <typename Type>
+struct SerializeTo<Tracked<Type>> {
+    template <typename Handler>
+    static bool
+    write(const Tracked<Type> &value, Handler &handler)
+    {
+        if constexpr (std::is_same_v<Handler, detail::TrackedWriter>) {
+            // Writing the cache of a tracked value this one is inside of
+            return handler.splice(value.cachedText());
+        } else if constexpr (detail::IsWriter<Handler>) {
+            const auto &text = value.cachedText();
+            if (text->size == 0) {
+                // The value couldn't be written
+                return false;
+            }
+
+            if (text->children.empty()) {
+                return handler.RawValue(text->text.data(), text->size,
+                                        text->type);
+            }
+
+            std::string json;
+            json.reserve(text->size);
+            text->appendTo(json);
+            return handler.RawValue(json.data(), json.size(), text->type);
+        } else {
+            return SerializeTo<Type>::write(value.get(), handler);
+        }
+    }
+};
+
+template <typename Type>
+struct DeserializeFrom<Tracked<Type>> {
+    static bool
+    start(SaxContext &ctx, Tracked<Type> &out, const SaxEvent &e)
+    {
+        return DeserializeFrom<Type>::start(ctx, out.mutate(), e);
+    }
+};
+
+}  // namespace pajlada
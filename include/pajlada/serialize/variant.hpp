@@ -0,0 +1,198 @@
+#pragma once
+
+#include <rapidjson/document.h>
+
+#include <any>
+#include <array>
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace pajlada {
+
+// Bits describing the kinds of JSON value a type can be deserialized from
+struct JsonKind {
+    static constexpr unsigned Null = 1U << 0;
+    static constexpr unsigned Bool = 1U << 1;
+    static constexpr unsigned Number = 1U << 2;
+    static constexpr unsigned String = 1U << 3;
+    static constexpr unsigned Array = 1U << 4;
+    static constexpr unsigned Object = 1U << 5;
+
+    static constexpr unsigned All =
+        Null | Bool | Number | String | Array | Object;
+};
+
+// JsonKinds<Type>::value is the set of JsonKind bits Deserialize<Type> may
+// accept. Untagged std::variant decoding skips alternatives that can't match
+// the value at hand, so specializing this for your own types (e.g. as
+// JsonKind::Object) saves decoding attempts that are bound to fail.
+// Types without a specialization are assumed to accept anything.
+template <typename Type, typename Enable = void>
+struct JsonKinds {
+    static constexpr unsigned value = JsonKind::All;
+};
+
+template <>
+struct JsonKinds<bool> {
+    static constexpr unsigned value = JsonKind::Bool | JsonKind::Number;
+};
+
+template <typename Type>
+struct JsonKinds<
+    Type, typename std::enable_if<std::is_integral<Type>::value &&
+                                  !std::is_same<Type, bool>::value>::type> {
+    static constexpr unsigned value = JsonKind::Number;
+};
+
+// null is deserialized as NaN
+template <>
+struct JsonKinds<float> {
+    static constexpr unsigned value = JsonKind::Null | JsonKind::Number;
+};
+
+template <>
+struct JsonKinds<double> {
+    static constexpr unsigned value = JsonKind::Null | JsonKind::Number;
+};
+
+template <>
+struct JsonKinds<std::string> {
+    static constexpr unsigned value = JsonKind::String;
+};
+
+template <>
+struct JsonKinds<std::string_view> {
+    static constexpr unsigned value = JsonKind::String;
+};
+
+template <typename Key, typename ValueType>
+struct JsonKinds<std::map<Key, ValueType>> {
+    static constexpr unsigned value = JsonKind::Object;
+};
+
+template <typename ValueType>
+struct JsonKinds<std::vector<ValueType>> {
+    static constexpr unsigned value = JsonKind::Array;
+};
+
+template <typename ValueType, size_t Size>
+struct JsonKinds<std::array<ValueType, Size>> {
+    static constexpr unsigned value = JsonKind::Array;
+};
+
+template <typename Arg1, typename Arg2>
+struct JsonKinds<std::pair<Arg1, Arg2>> {
+    static constexpr unsigned value = JsonKind::Array;
+};
+
+template <>
+struct JsonKinds<std::any> {
+    static constexpr unsigned value = JsonKind::All & ~JsonKind::Null;
+};
+
+template <class InnerType>
+struct JsonKinds<std::optional<InnerType>> {
+    static constexpr unsigned value =
+        JsonKind::Null | JsonKinds<InnerType>::value;
+};
+
+// Opt-in tagged encoding for a std::variant. Specialize this with
+// enabled = true to (de-)serialize the variant as
+//   {"type": <tag>, "value": <alternative>}
+// where tag is the index of the alternative, or its name if names is given:
+//
+//   template <>
+//   struct pajlada::VariantTag<Shape> {
+//       static constexpr bool enabled = true;
+//       static constexpr std::array<std::string_view, 2> names{
+//           "circle",
+//           "square",
+//       };
+//   };
+//
+// Decoding a tagged variant only ever decodes the alternative named by tag.
+template <typename Variant>
+struct VariantTag {
+    static constexpr bool enabled = false;
+};
+
+template <class... InnerTypes>
+struct JsonKinds<std::variant<InnerTypes...>> {
+    static constexpr unsigned value =
+        VariantTag<std::variant<InnerTypes...>>::enabled
+            ? JsonKind::Object
+            : (JsonKinds<InnerTypes>::value | ...);
+};
+
+namespace detail {
+
+inline constexpr std::string_view VariantTypeKey = "type";
+inline constexpr std::string_view VariantValueKey = "value";
+
+template <typename Variant>
+inline constexpr bool HasVariantNames =
+    requires { VariantTag<Variant>::names; };
+
+template <typename RJValue>
+inline unsigned
+JsonKindOf(const RJValue &value)
+{
+    if (value.IsNull()) {
+        return JsonKind::Null;
+    } else if (value.IsBool()) {
+        return JsonKind::Bool;
+    } else if (value.IsNumber()) {
+        return JsonKind::Number;
+    } else if (value.IsString()) {
+        return JsonKind::String;
+    } else if (value.IsArray()) {
+        return JsonKind::Array;
+    }
+
+    return JsonKind::Object;
+}
+
+// Returns the index of the alternative named by the tag, or
+// std::variant_npos if the tag doesn't name one
+template <typename Variant, typename RJValue>
+inline size_t
+VariantIndexFromTag(const RJValue &tag)
+{
+    if constexpr (HasVariantNames<Variant>) {
+        static_assert(VariantTag<Variant>::names.size() ==
+                          std::variant_size<Variant>::value,
+                      "VariantTag::names must name every alternative");
+
+        if (!tag.IsString()) {
+            return std::variant_npos;
+        }
+
+        std::string_view name(tag.GetString(), tag.GetStringLength());
+        const auto &names = VariantTag<Variant>::names;
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (names[i] == name) {
+                return i;
+            }
+        }
+
+        return std::variant_npos;
+    } else {
+        if (!tag.IsUint64() ||
+            tag.GetUint64() >= std::variant_size<Variant>::value) {
+            return std::variant_npos;
+        }
+
+        return static_cast<size_t>(tag.GetUint64());
+    }
+}
+
+}  // namespace detail
+
+}  // namespace pajlada
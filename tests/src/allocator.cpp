@@ -0,0 +1,126 @@
+#include "common.hpp"
+
+#include <gtest/gtest.h>
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <cstring>
+#include <map>
+#include <optional>
+#include <pajlada/serialize.hpp>
+#include <pajlada/serialize/arena.hpp>
+#include <string>
+#include <variant>
+#include <vector>
+
+using namespace pajlada;
+using namespace test;
+
+namespace {
+
+using ArenaValue = rapidjson::GenericValue<rapidjson::UTF8<>, ArenaAllocator>;
+using ArenaDocument =
+    rapidjson::GenericDocument<rapidjson::UTF8<>, ArenaAllocator>;
+using CrtValue =
+    rapidjson::GenericValue<rapidjson::UTF8<>, rapidjson::CrtAllocator>;
+
+using Settings = std::map<
+    std::string,
+    std::variant<int, std::string, std::optional<std::vector<std::string>>>>;
+
+const Settings settings{
+    {"a", 1},
+    {"b", "forsen"},
+    {"c", std::vector<std::string>{"x", "y"}},
+    {"d", std::nullopt},
+};
+
+}  // namespace
+
+TEST(Allocator, Arena)
+{
+    ArenaAllocator arena;
+
+    auto value = Serialize<Settings, ArenaValue>::get(settings, arena);
+    EXPECT_EQ(Print(value),
+              R"({"a":1,"b":"forsen","c":["x","y"],"d":null})");
+    EXPECT_GT(arena.Size(), 0);
+
+    bool error = false;
+    auto out = Deserialize<Settings, ArenaValue>::get(value, &error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(out, settings);
+}
+
+TEST(Allocator, ArenaReset)
+{
+    ArenaAllocator arena(256);
+
+    {
+        auto value = Serialize<Settings, ArenaValue>::get(settings, arena);
+    }
+    auto used = arena.Size();
+    auto capacity = arena.Capacity();
+    EXPECT_GT(used, 0);
+    EXPECT_GE(capacity, used);
+
+    arena.Reset();
+    EXPECT_EQ(arena.Size(), 0);
+
+    // The same work fits in the blocks left over from the first round
+    for (int i = 0; i < 10; ++i) {
+        {
+            auto value = Serialize<Settings, ArenaValue>::get(settings, arena);
+            EXPECT_EQ(Print(value),
+                      R"({"a":1,"b":"forsen","c":["x","y"],"d":null})");
+        }
+        EXPECT_EQ(arena.Size(), used);
+        arena.Reset();
+    }
+    EXPECT_EQ(arena.Capacity(), capacity);
+}
+
+TEST(Allocator, ArenaRealloc)
+{
+    ArenaAllocator arena(64);
+
+    auto *a = static_cast<char *>(arena.Malloc(8));
+    std::memcpy(a, "forsen", 7);
+
+    // The last allocation grows in place
+    EXPECT_EQ(arena.Realloc(a, 8, 16), a);
+
+    // Growing past the end of the block moves it, keeping the contents
+    auto *b = static_cast<char *>(arena.Realloc(a, 16, 128));
+    EXPECT_NE(a, b);
+    EXPECT_STREQ(b, "forsen");
+
+    EXPECT_EQ(arena.Malloc(0), nullptr);
+}
+
+TEST(Allocator, ArenaDocument)
+{
+    ArenaDocument d;
+    d.Parse(R"({"a":1,"b":"forsen","c":["x","y"],"d":null})");
+    ASSERT_FALSE(d.HasParseError());
+
+    bool error = false;
+    auto out = Deserialize<Settings, ArenaValue>::get(d, &error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(out, settings);
+}
+
+TEST(Allocator, Crt)
+{
+    rapidjson::CrtAllocator a;
+
+    auto value = Serialize<Settings, CrtValue>::get(settings, a);
+    EXPECT_EQ(Print(value),
+              R"({"a":1,"b":"forsen","c":["x","y"],"d":null})");
+
+    bool error = false;
+    auto out = Deserialize<Settings, CrtValue>::get(value, &error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(out, settings);
+}
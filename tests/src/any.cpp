@@ -0,0 +1,150 @@
+#include "common.hpp"
+
+#include <gtest/gtest.h>
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <any>
+#include <map>
+#include <pajlada/serialize.hpp>
+#include <string>
+#include <vector>
+
+using namespace pajlada;
+using namespace test;
+
+namespace {
+
+using AnyMap = std::map<std::string, std::any>;
+using AnyVector = std::vector<std::any>;
+
+// Counts how often it's copied, to make sure serializing never copies what
+// the std::any holds
+struct Counted {
+    static inline int copies = 0;
+
+    int value = 0;
+
+    explicit Counted(int _value)
+        : value(_value)
+    {
+    }
+
+    Counted(const Counted &other)
+        : value(other.value)
+    {
+        ++copies;
+    }
+
+    Counted &
+    operator=(const Counted &other)
+    {
+        this->value = other.value;
+        ++copies;
+        return *this;
+    }
+};
+
+struct Unregistered {
+};
+
+// Counts which of its serializers are used
+struct Streamed {
+    static inline int built = 0;
+    static inline int written = 0;
+};
+
+}  // namespace
+
+namespace pajlada {
+
+template <typename RJValue>
+struct Serialize<Counted, RJValue> {
+    static RJValue
+    get(const Counted &value, typename RJValue::AllocatorType &a)
+    {
+        return Serialize<int, RJValue>::get(value.value, a);
+    }
+};
+
+template <typename RJValue>
+struct Serialize<Streamed, RJValue> {
+    static RJValue
+    get(const Streamed &, typename RJValue::AllocatorType &)
+    {
+        ++Streamed::built;
+        return RJValue("built");
+    }
+};
+
+template <>
+struct SerializeTo<Streamed> {
+    template <typename Handler>
+    static bool
+    write(const Streamed &, Handler &handler)
+    {
+        ++Streamed::written;
+        return handler.String("written", 7, false);
+    }
+};
+
+}  // namespace pajlada
+
+TEST(AnyRegistry, Builtin)
+{
+    AnyMap in{
+        {"a", 1},
+        {"b", "forsen"},
+        {"c", AnyVector{true, 1.5, std::string("x")}},
+        {"d", std::vector<std::string>{"y"}},
+        {"e", std::any{}},
+    };
+
+    EXPECT_EQ(Stringify(in),
+              R"({"a":1,"b":"forsen","c":[true,1.5,"x"],"d":["y"],"e":null})");
+    EXPECT_EQ(Write(in), Stringify(in));
+}
+
+TEST(AnyRegistry, UserType)
+{
+    AnyMap in{{"a", Counted{1}}, {"b", Unregistered{}}};
+
+    // Unknown types are serialized as null
+    EXPECT_EQ(Stringify(in), R"({"a":null,"b":null})");
+
+    RegisterAnyType<Counted>();
+
+    EXPECT_EQ(Stringify(in), R"({"a":1,"b":null})");
+    EXPECT_EQ(Write(in), R"({"a":1,"b":null})");
+}
+
+TEST(AnyRegistry, NoCopies)
+{
+    RegisterAnyType<Counted>();
+
+    AnyMap in{
+        {"a", AnyMap{{"b", AnyVector{Counted{1}, AnyMap{{"c", Counted{2}}}}}}},
+    };
+
+    Counted::copies = 0;
+    EXPECT_EQ(Stringify(in), R"({"a":{"b":[1,{"c":2}]}})");
+    EXPECT_EQ(Write(in), R"({"a":{"b":[1,{"c":2}]}})");
+    EXPECT_EQ(Counted::copies, 0);
+}
+
+TEST(AnyRegistry, WriteStreams)
+{
+    RegisterAnyType<Streamed>();
+
+    AnyVector in{Streamed{}, AnyMap{{"a", Streamed{}}}};
+
+    Streamed::built = 0;
+    Streamed::written = 0;
+    EXPECT_EQ(Write(in), R"(["written",{"a":"written"}])");
+    EXPECT_EQ(Streamed::written, 2);
+    EXPECT_EQ(Streamed::built, 0);
+
+    EXPECT_EQ(Stringify(in), R"(["built",{"a":"built"}])");
+    EXPECT_EQ(Streamed::built, 2);
+}
@@ -0,0 +1,152 @@
+#include "common.hpp"
+
+#include <gtest/gtest.h>
+#include <rapidjson/document.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <cstdint>
+#include <pajlada/serialize.hpp>
+#include <pajlada/serialize/base64.hpp>
+#include <pajlada/serialize/fields.hpp>
+#include <string>
+#include <vector>
+
+using namespace pajlada;
+using namespace test;
+
+namespace {
+
+struct Emote {
+    std::string name;
+    Base64<std::vector<uint8_t>> image;
+};
+
+using Bytes = Base64<std::vector<uint8_t>>;
+using CrtValue =
+    rapidjson::GenericValue<rapidjson::UTF8<>, rapidjson::CrtAllocator>;
+
+}  // namespace
+
+PAJLADA_SERIALIZE_FIELDS(Emote, name, image);
+
+namespace {
+
+Bytes
+MakeBytes(const std::string &text)
+{
+    return {std::vector<uint8_t>(text.begin(), text.end())};
+}
+
+}  // namespace
+
+TEST(Base64, Encode)
+{
+    // RFC 4648 test vectors
+    EXPECT_EQ(Write(MakeBytes("")), R"("")");
+    EXPECT_EQ(Write(MakeBytes("f")), R"("Zg==")");
+    EXPECT_EQ(Write(MakeBytes("fo")), R"("Zm8=")");
+    EXPECT_EQ(Write(MakeBytes("foo")), R"("Zm9v")");
+    EXPECT_EQ(Write(MakeBytes("foob")), R"("Zm9vYg==")");
+    EXPECT_EQ(Write(MakeBytes("fooba")), R"("Zm9vYmE=")");
+    EXPECT_EQ(Write(MakeBytes("foobar")), R"("Zm9vYmFy")");
+
+    EXPECT_EQ(Stringify(MakeBytes("foobar")), R"("Zm9vYmFy")");
+    EXPECT_EQ((Stringify<Bytes, CrtValue>(MakeBytes("fooba"))),
+              R"("Zm9vYmE=")");
+
+    Bytes all;
+    for (int i = 0; i < 256; ++i) {
+        all.value.push_back(static_cast<uint8_t>(i));
+    }
+    auto json = Write(all);
+    EXPECT_EQ(json.size(), 344 + 2);
+    EXPECT_EQ(json.substr(0, 9), R"("AAECAwQF)");
+    EXPECT_EQ(json.substr(json.size() - 9), R"(/P3+/w==")");
+}
+
+TEST(Base64, ElementsAreLittleEndian)
+{
+    Base64<std::vector<uint32_t>> numbers{{0x01020304, 0xFFFFFFFF}};
+    EXPECT_EQ(Write(numbers), R"("BAMCAf////8=")");
+
+    bool error = false;
+    EXPECT_EQ(Parse<decltype(numbers)>(R"("BAMCAf////8=")", error), numbers);
+    EXPECT_FALSE(error);
+
+    Base64<std::vector<double>> doubles{{1.5, -0.0, 1e300}};
+    EXPECT_EQ(Parse<decltype(doubles)>(Write(doubles).c_str(), error),
+              doubles);
+    EXPECT_FALSE(error);
+}
+
+TEST(Base64, Decode)
+{
+    bool error = false;
+    EXPECT_EQ(Parse<Bytes>(R"("Zm9vYmE=")", error), MakeBytes("fooba"));
+    EXPECT_FALSE(error);
+
+    // Padding is optional
+    EXPECT_EQ(Parse<Bytes>(R"("Zm9vYg")", error), MakeBytes("foob"));
+    EXPECT_EQ(Parse<Bytes>(R"("")", error), MakeBytes(""));
+    EXPECT_FALSE(error);
+
+    // The array form is still accepted
+    EXPECT_EQ(Parse<Bytes>("[102, 111, 111]", error), MakeBytes("foo"));
+    EXPECT_EQ(ParseStream<Bytes>("[102, 111, 111]", error),
+              MakeBytes("foo"));
+    EXPECT_FALSE(error);
+
+    EXPECT_EQ(ParseStream<Bytes>(R"("Zm9vYmFy")", error), MakeBytes("foobar"));
+    EXPECT_FALSE(error);
+}
+
+TEST(Base64, Errors)
+{
+    auto check = [](const char *json) {
+        bool error = false;
+        auto value = Parse<Bytes>(json, error);
+        EXPECT_TRUE(error) << json;
+        EXPECT_TRUE(value.value.empty()) << json;
+
+        error = false;
+        value = ParseStream<Bytes>(json, error);
+        EXPECT_TRUE(error) << json;
+        EXPECT_TRUE(value.value.empty()) << json;
+    };
+
+    check(R"("Zm9vY")");
+    check(R"("Zm9v=mFy")");
+    check(R"("Zm9vYm$y")");
+    check(R"("Zm9vYmFy====")");
+    check(R"("Zg=")");
+    check("5");
+    check("{}");
+
+    // 5 bytes can't be split into uint32_t
+    bool error = false;
+    Parse<Base64<std::vector<uint32_t>>>(R"("Zm9vYmE=")", error);
+    EXPECT_TRUE(error);
+}
+
+TEST(Base64, Fields)
+{
+    Emote emote{"forsenE", MakeBytes("\x89PNG")};
+    const char *json = R"({"name":"forsenE","image":"iVBORw=="})";
+    EXPECT_EQ(Write(emote), json);
+
+    bool error = false;
+    auto loaded = Parse<Emote>(json, error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(loaded.image, emote.image);
+
+    loaded = ParseStream<Emote>(json, error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(loaded.image, emote.image);
+
+    rapidjson::StringBuffer buffer;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+    EXPECT_TRUE(SerializeTo<Bytes>::write(emote.image, writer));
+    EXPECT_EQ(std::string(buffer.GetString()), R"("iVBORw==")");
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <gtest/gtest.h>
+#include <rapidjson/document.h>
+#include <rapidjson/reader.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <pajlada/serialize.hpp>
+#include <string>
+
+// Helpers shared by the tests, for getting JSON text in and out of the
+// different (de-)serializers
+namespace test {
+
+// value as JSON text
+template <typename RJValue>
+std::string
+Print(const RJValue &value)
+{
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    value.Accept(writer);
+    return {buffer.GetString(), buffer.GetSize()};
+}
+
+// What SerializeTo<Type>::write writes
+template <typename Type>
+std::string
+Write(const Type &value)
+{
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    EXPECT_TRUE(pajlada::SerializeTo<Type>::write(value, writer));
+    return {buffer.GetString(), buffer.GetSize()};
+}
+
+// What Serialize<Type, RJValue>::get builds, as JSON text
+template <typename Type, typename RJValue = rapidjson::Value>
+std::string
+Stringify(const Type &value)
+{
+    typename RJValue::AllocatorType a;
+    return Print(pajlada::Serialize<Type, RJValue>::get(value, a));
+}
+
+inline rapidjson::Document
+ParseDocument(const char *json)
+{
+    rapidjson::Document d;
+    d.Parse(json);
+    EXPECT_FALSE(d.HasParseError()) << json;
+    return d;
+}
+
+// Decoded by Deserialize<Type>::get
+template <typename Type>
+Type
+Parse(const char *json, bool &error)
+{
+    return pajlada::Deserialize<Type>::get(ParseDocument(json), &error);
+}
+
+// Decoded by DeserializeStream
+template <typename Type>
+Type
+ParseStream(const char *json, bool &error)
+{
+    Type out{};
+    rapidjson::StringStream ss(json);
+    pajlada::DeserializeStream(ss, out, &error);
+    return out;
+}
+
+}  // namespace test
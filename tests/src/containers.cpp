@@ -0,0 +1,239 @@
+#include "common.hpp"
+
+#include <gtest/gtest.h>
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <deque>
+#include <map>
+#include <pajlada/serialize.hpp>
+#include <pajlada/serialize/containers.hpp>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <variant>
+#include <vector>
+
+using namespace pajlada;
+using namespace test;
+
+namespace {
+
+// Checks that value is read back the same through DOM and SAX, and that both
+// write the same JSON
+template <typename Type>
+void
+RoundTrip(const Type &value)
+{
+    auto json = Write(value);
+    EXPECT_EQ(Stringify(value), json);
+
+    bool error = false;
+    EXPECT_EQ(Parse<Type>(json.c_str(), error), value) << json;
+    EXPECT_EQ(ParseStream<Type>(json.c_str(), error), value) << json;
+    EXPECT_FALSE(error) << json;
+}
+
+}  // namespace
+
+TEST(Containers, Deque)
+{
+    std::deque<int> numbers{1, 2, 3};
+    EXPECT_EQ(Write(numbers), "[1,2,3]");
+    RoundTrip(numbers);
+    RoundTrip(std::deque<std::string>{"a", "b"});
+    RoundTrip(std::deque<std::vector<bool>>{{true}, {}, {false, true}});
+
+    // Existing elements are overwritten in place
+    rapidjson::Document d;
+    d.Parse("[4, 5]");
+    bool error = false;
+    Deserialize<std::deque<int>>::into(numbers, d, &error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(numbers, (std::deque<int>{4, 5}));
+
+    Parse<std::deque<int>>(R"({"a": 1})", error);
+    EXPECT_TRUE(error);
+}
+
+TEST(Containers, Set)
+{
+    std::set<std::string> names{"forsen", "pajlada", "a"};
+    EXPECT_EQ(Write(names), R"(["a","forsen","pajlada"])");
+    RoundTrip(names);
+    RoundTrip(std::set<int>{});
+
+    // Unsorted input and duplicates are fine
+    bool error = false;
+    EXPECT_EQ(Parse<std::set<int>>("[3, 1, 2, 1]", error),
+              (std::set<int>{1, 2, 3}));
+    EXPECT_EQ(ParseStream<std::set<int>>("[3, 1, 2, 1]", error),
+              (std::set<int>{1, 2, 3}));
+    EXPECT_FALSE(error);
+
+    EXPECT_EQ(ParseStream<std::set<std::vector<int>>>("[[2], [1, 2], []]",
+                                                      error),
+              (std::set<std::vector<int>>{{}, {1, 2}, {2}}));
+    EXPECT_FALSE(error);
+
+    EXPECT_TRUE(ParseStream<std::set<int>>("[1, \"2\"]", error).size() <= 2);
+    EXPECT_TRUE(error);
+}
+
+TEST(Containers, UnorderedSet)
+{
+    std::unordered_set<std::string> names{"forsen", "pajlada", "a"};
+    RoundTrip(names);
+    RoundTrip(std::unordered_set<int>{5});
+
+    bool error = false;
+    EXPECT_EQ(Parse<std::unordered_set<int>>("[3, 1, 3]", error),
+              (std::unordered_set<int>{1, 3}));
+    EXPECT_EQ(ParseStream<std::unordered_set<int>>("[3, 1, 3]", error),
+              (std::unordered_set<int>{1, 3}));
+    EXPECT_FALSE(error);
+
+    ParseStream<std::unordered_set<int>>("5", error);
+    EXPECT_TRUE(error);
+}
+
+TEST(Containers, UnorderedMap)
+{
+    using Map = std::unordered_map<std::string, std::vector<int>>;
+
+    Map map{{"a", {1}}, {"b", {}}, {"c", {2, 3}}};
+    RoundTrip(map);
+    RoundTrip(Map{});
+
+    bool error = false;
+    const char *json = R"({"b": [1], "a": [2], "b": [3]})";
+    EXPECT_EQ(Parse<Map>(json, error), (Map{{"a", {2}}, {"b", {1}}}));
+    EXPECT_EQ(ParseStream<Map>(json, error), (Map{{"a", {2}}, {"b", {1}}}));
+    EXPECT_FALSE(error);
+
+    Parse<Map>(R"({"a": 1})", error);
+    EXPECT_TRUE(error);
+
+    error = false;
+    ParseStream<Map>("[]", error);
+    EXPECT_TRUE(error);
+}
+
+TEST(Containers, UnorderedMapInto)
+{
+    using Map = std::unordered_map<std::string, std::vector<int>>;
+
+    Map map{{"kept", {1, 2, 3}}, {"removed", {4}}};
+    const auto *keptData = map["kept"].data();
+
+    rapidjson::Document d;
+    d.Parse(R"({"kept": [5, 6], "added": [7]})");
+
+    bool error = false;
+    Deserialize<Map>::into(map, d, &error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(map, (Map{{"kept", {5, 6}}, {"added", {7}}}));
+
+    // The entry kept its node, and the vector its storage
+    EXPECT_EQ(map["kept"].data(), keptData);
+}
+
+TEST(Containers, UnorderedMapOfStringViews)
+{
+    using Map = std::unordered_map<std::string_view, std::string_view>;
+
+    bool error = false;
+    auto loaded =
+        LoadInsitu<Map>(R"({"forsen": "a", "pajlada": "b", "forsen": "c"})",
+                        &error);
+    EXPECT_FALSE(error);
+    ASSERT_EQ(loaded->size(), 2);
+    EXPECT_EQ(loaded->at("forsen"), "a");
+    EXPECT_TRUE(loaded.owns(loaded->begin()->first));
+
+    // Keys copied out of the event can't be viewed
+    ParseStream<Map>(R"({"a": "b"})", error);
+    EXPECT_TRUE(error);
+}
+
+TEST(Containers, FlatMap)
+{
+    using Map = FlatMap<std::string, std::vector<int>>;
+
+    Map map{{"c", {2, 3}}, {"a", {1}}, {"b", {}}};
+    EXPECT_EQ(Write(map), R"({"a":[1],"b":[],"c":[2,3]})");
+    RoundTrip(map);
+    RoundTrip(Map{});
+    RoundTrip(FlatMap<int, std::string>{{-1, "a"}, {10, "b"}, {2, "c"}});
+
+    // Unsorted input is sorted once, for duplicate keys the first one wins
+    bool error = false;
+    const char *json = R"({"b": [1], "c": [4], "a": [2], "b": [3]})";
+    Map expected{{"a", {2}}, {"b", {1}}, {"c", {4}}};
+    EXPECT_EQ(Parse<Map>(json, error), expected);
+    EXPECT_EQ(ParseStream<Map>(json, error), expected);
+    EXPECT_FALSE(error);
+
+    // Already sorted input with a duplicate at the end
+    json = R"({"a": [1], "b": [2], "b": [3]})";
+    expected = Map{{"a", {1}}, {"b", {2}}};
+    EXPECT_EQ(Parse<Map>(json, error), expected);
+    EXPECT_EQ(ParseStream<Map>(json, error), expected);
+    EXPECT_FALSE(error);
+
+    Parse<Map>(R"({"a": 1})", error);
+    EXPECT_TRUE(error);
+
+    error = false;
+    auto numbers =
+        ParseStream<FlatMap<int, int>>(R"({"2": 2, "x": 0, "1": 1})", error);
+    EXPECT_TRUE(error);
+    EXPECT_EQ(numbers, (FlatMap<int, int>{{1, 1}, {2, 2}}));
+}
+
+TEST(Containers, FlatMapInto)
+{
+    using Map = FlatMap<std::string, int>;
+
+    Map map{{"a", 1}, {"b", 2}, {"c", 3}, {"d", 4}};
+
+    rapidjson::Document d;
+    d.Parse(R"({"d": 5, "a": 6})");
+
+    bool error = false;
+    Deserialize<Map>::into(map, d, &error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(map, (Map{{"a", 6}, {"d", 5}}));
+
+    ASSERT_NE(map.find("d"), map.end());
+    EXPECT_EQ(map.find("d")->second, 5);
+    EXPECT_EQ(map.find("b"), map.end());
+    EXPECT_TRUE(map.contains("a"));
+    EXPECT_EQ(map.at("a"), 6);
+    EXPECT_THROW(map.at("x"), std::out_of_range);
+
+    map["b"] = 7;
+    EXPECT_EQ(map.keys(), (std::vector<std::string>{"a", "b", "d"}));
+    EXPECT_EQ(map.values(), (std::vector<int>{6, 7, 5}));
+}
+
+TEST(Containers, Nested)
+{
+    using Value =
+        std::variant<std::set<int>, std::unordered_map<std::string, int>>;
+    std::map<std::string, std::deque<Value>> nested{
+        {"x", {std::set<int>{1, 2}, std::unordered_map<std::string, int>{}}},
+    };
+
+    auto json = Write(nested);
+    EXPECT_EQ(json, R"({"x":[[1,2],{}]})");
+
+    bool error = false;
+    EXPECT_EQ(Parse<decltype(nested)>(json.c_str(), error), nested);
+    EXPECT_EQ(ParseStream<decltype(nested)>(json.c_str(), error), nested);
+    EXPECT_FALSE(error);
+}
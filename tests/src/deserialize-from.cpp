@@ -0,0 +1,196 @@
+#include "common.hpp"
+
+#include <gtest/gtest.h>
+#include <rapidjson/document.h>
+#include <rapidjson/reader.h>
+
+#include <array>
+#include <map>
+#include <optional>
+#include <pajlada/serialize.hpp>
+#include <string>
+#include <variant>
+#include <vector>
+
+using namespace pajlada;
+using namespace test;
+
+namespace {
+
+struct Point {
+    int x = 0;
+    int y = 0;
+
+    bool operator==(const Point &other) const = default;
+};
+
+}  // namespace
+
+namespace pajlada {
+
+template <typename RJValue>
+struct Deserialize<Point, RJValue> {
+    static Point
+    get(const RJValue &value, bool *error = nullptr)
+    {
+        Point ret;
+
+        if (!value.IsObject()) {
+            PAJLADA_REPORT_ERROR(error)
+            return ret;
+        }
+
+        auto x = value.FindMember("x");
+        if (x != value.MemberEnd()) {
+            ret.x = Deserialize<int, RJValue>::get(x->value, error);
+        }
+
+        auto y = value.FindMember("y");
+        if (y != value.MemberEnd()) {
+            ret.y = Deserialize<int, RJValue>::get(y->value, error);
+        }
+
+        return ret;
+    }
+};
+
+}  // namespace pajlada
+
+TEST(DeserializeFrom, Scalars)
+{
+    bool error = false;
+
+    EXPECT_EQ(ParseStream<int>("5", error), 5);
+    EXPECT_EQ(ParseStream<int>("5.6", error), 6);
+    EXPECT_EQ(ParseStream<bool>("true", error), true);
+    EXPECT_EQ(ParseStream<bool>("1", error), true);
+    EXPECT_DOUBLE_EQ(ParseStream<double>("3.14", error), 3.14);
+    EXPECT_EQ(ParseStream<std::string>(R"("forsen")", error), "forsen");
+    EXPECT_FALSE(error);
+
+    EXPECT_EQ(ParseStream<int>(R"("forsen")", error), 0);
+    EXPECT_TRUE(error);
+}
+
+TEST(DeserializeFrom, Vector)
+{
+    bool error = false;
+
+    auto out = ParseStream<std::vector<int>>("[1, 2, 3]", error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(out, (std::vector<int>{1, 2, 3}));
+
+    auto nested = ParseStream<std::vector<std::vector<std::string>>>(
+        R"([["a", "b"], [], ["c"]])", error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(nested, (std::vector<std::vector<std::string>>{
+                          {"a", "b"},
+                          {},
+                          {"c"},
+                      }));
+
+    auto bools = ParseStream<std::vector<bool>>("[true, false, 1]", error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(bools, (std::vector<bool>{true, false, true}));
+
+    out = ParseStream<std::vector<int>>(R"({"a": [1, 2]})", error);
+    EXPECT_TRUE(error);
+    EXPECT_TRUE(out.empty());
+}
+
+TEST(DeserializeFrom, Map)
+{
+    bool error = false;
+
+    auto out = ParseStream<std::map<std::string, std::vector<int>>>(
+        R"({"a": [1, 2], "b": [], "a": [3]})", error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(out, (Parse<std::map<std::string, std::vector<int>>>(
+                       R"({"a": [1, 2], "b": [], "a": [3]})", error)));
+    EXPECT_EQ(out["a"], (std::vector<int>{1, 2}));
+    EXPECT_TRUE(out["b"].empty());
+    EXPECT_FALSE(error);
+}
+
+TEST(DeserializeFrom, ArrayAndPair)
+{
+    bool error = false;
+
+    auto array = ParseStream<std::array<int, 3>>("[1, 2, 3]", error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(array, (std::array<int, 3>{1, 2, 3}));
+
+    array = ParseStream<std::array<int, 3>>("[1, 2]", error);
+    EXPECT_TRUE(error);
+    EXPECT_EQ(array, (std::array<int, 3>{0, 0, 0}));
+
+    error = false;
+    array = ParseStream<std::array<int, 3>>("[1, 2, 3, [4]]", error);
+    EXPECT_TRUE(error);
+    EXPECT_EQ(array, (std::array<int, 3>{0, 0, 0}));
+
+    error = false;
+    auto pair = ParseStream<std::pair<std::string, int>>(R"(["a", 1])", error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(pair, (std::pair<std::string, int>{"a", 1}));
+
+    pair = ParseStream<std::pair<std::string, int>>(R"(["a"])", error);
+    EXPECT_TRUE(error);
+}
+
+TEST(DeserializeFrom, OptionalAndVariant)
+{
+    bool error = false;
+
+    auto optionals =
+        ParseStream<std::vector<std::optional<std::vector<int>>>>(
+            "[null, [1]]", error);
+    EXPECT_FALSE(error);
+    ASSERT_EQ(optionals.size(), 2);
+    EXPECT_FALSE(optionals[0].has_value());
+    EXPECT_EQ(optionals[1], (std::vector<int>{1}));
+
+    using V = std::variant<int, std::string, std::vector<int>>;
+    auto variants = ParseStream<std::vector<V>>(R"([1, "a", [2, 3]])", error);
+    EXPECT_FALSE(error);
+    ASSERT_EQ(variants.size(), 3);
+    EXPECT_EQ(variants[0], V(1));
+    EXPECT_EQ(variants[1], V("a"));
+    EXPECT_EQ(variants[2], V(std::vector<int>{2, 3}));
+}
+
+TEST(DeserializeFrom, UserType)
+{
+    bool error = false;
+
+    // Point only has a Deserialize specialization
+    auto out = ParseStream<std::map<std::string, Point>>(
+        R"({"a": {"x": 1, "y": 2}, "b": {"x": 3, "z": {"w": [1]}}})", error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(out["a"], (Point{1, 2}));
+    EXPECT_EQ(out["b"], (Point{3, 0}));
+}
+
+TEST(DeserializeFrom, Any)
+{
+    bool error = false;
+
+    auto out = ParseStream<std::map<std::string, std::any>>(
+        R"({"a": 1, "b": {"c": [1, "x"]}})", error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(std::any_cast<int>(out["a"]), 1);
+    auto b = std::any_cast<std::map<std::string, std::any>>(out["b"]);
+    auto c = std::any_cast<std::vector<std::any>>(b["c"]);
+    EXPECT_EQ(std::any_cast<std::string>(c[1]), "x");
+}
+
+TEST(DeserializeFrom, ParseError)
+{
+    bool error = false;
+    std::vector<int> out;
+    rapidjson::StringStream ss("[1, 2");
+
+    auto result = DeserializeStream(ss, out, &error);
+    EXPECT_TRUE(result.IsError());
+    EXPECT_TRUE(error);
+}
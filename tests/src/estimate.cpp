@@ -0,0 +1,222 @@
+#include "common.hpp"
+
+#include <gtest/gtest.h>
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <any>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <map>
+#include <optional>
+#include <pajlada/serialize.hpp>
+#include <pajlada/serialize/base64.hpp>
+#include <pajlada/serialize/containers.hpp>
+#include <pajlada/serialize/estimate.hpp>
+#include <pajlada/serialize/fields.hpp>
+#include <pajlada/serialize/tracked.hpp>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+using namespace pajlada;
+using namespace test;
+
+namespace {
+
+struct Emote {
+    std::string name;
+    int width = 0;
+    std::optional<double> scale;
+};
+
+struct Channel {
+    std::string name;
+    std::vector<Emote> emotes;
+    std::map<uint32_t, std::string> badges;
+};
+
+using Shape = std::variant<int, std::string>;
+using UntaggedShape = std::variant<int, std::vector<std::string>>;
+
+}  // namespace
+
+PAJLADA_SERIALIZE_FIELDS(Emote, name, width, scale);
+PAJLADA_SERIALIZE_FIELDS(Channel, name, emotes, badges);
+
+template <>
+struct pajlada::VariantTag<Shape> {
+    static constexpr bool enabled = true;
+    static constexpr std::array<std::string_view, 2> names{
+        "number",
+        "text",
+    };
+};
+
+namespace {
+
+size_t
+CountNodes(const rapidjson::Value &value)
+{
+    size_t count = 1;
+    if (value.IsArray()) {
+        for (const auto &element : value.GetArray()) {
+            count += CountNodes(element);
+        }
+    } else if (value.IsObject()) {
+        for (const auto &member : value.GetObject()) {
+            count += 1 + CountNodes(member.value);
+        }
+    }
+    return count;
+}
+
+// Checks that the estimate of value bounds its text, its tree and what the
+// tree takes from an allocator
+template <typename Type>
+SizeEstimate
+Check(const Type &value)
+{
+    auto estimate = EstimateSize<Type>::get(value);
+    auto json = Write(value);
+    EXPECT_GE(estimate.bytes, json.size()) << json;
+
+    rapidjson::MemoryPoolAllocator<> pool;
+    auto tree = Serialize<Type>::get(value, pool);
+    EXPECT_GE(estimate.nodes, CountNodes(tree)) << json;
+    EXPECT_GE(estimate.allocatorBytes(), pool.Size()) << json;
+
+    return estimate;
+}
+
+}  // namespace
+
+TEST(Estimate, Scalars)
+{
+    EXPECT_EQ(Check(std::numeric_limits<int>::min()).bytes, 11);
+    EXPECT_EQ(Check(std::numeric_limits<int64_t>::min()).bytes, 20);
+    EXPECT_EQ(Check(std::numeric_limits<uint64_t>::max()).bytes, 20);
+    EXPECT_EQ(Check(uint8_t{255}).bytes, 3);
+
+    Check(-std::numeric_limits<double>::denorm_min());
+    Check(-std::numeric_limits<double>::min());
+    Check(-std::numeric_limits<double>::max());
+    Check(-0.1234567890123456789);
+    Check(std::numeric_limits<double>::quiet_NaN());
+    Check(std::numeric_limits<float>::lowest());
+    Check(false);
+
+    EXPECT_EQ(Check(1).nodes, 1);
+}
+
+TEST(Estimate, Strings)
+{
+    // Strings are scanned, so they come out exact
+    std::vector<std::string> values{
+        "", "forsen", "\"quoted\\\"", "tab\tnew\nline",
+        std::string("\0\x01\x1f\x7f", 4), "\xc3\xa5",
+    };
+
+    // Long strings are checked a word at a time, so try every position
+    for (char special : {'\0', '\x1f', '"', '\\', ' ', '\x7f', '\xff'}) {
+        for (size_t i = 0; i < 24; ++i) {
+            std::string value(24, '!');
+            value[i] = special;
+            values.push_back(value);
+        }
+    }
+    for (const auto &value : values) {
+        EXPECT_EQ(Check(value).bytes, Write(value).size()) << value;
+        EXPECT_EQ(Check(std::string_view(value)).bytes, Write(value).size());
+    }
+}
+
+TEST(Estimate, Containers)
+{
+    Check(std::vector<int>{});
+    Check(std::vector<int>{1, -2, 3});
+    Check(std::vector<std::vector<double>>{{}, {1.5}, {2, 3}});
+    Check(std::vector<bool>{true, false});
+    Check(std::vector<std::string>{"a", "b\n"});
+    Check(std::array<uint16_t, 3>{1, 2, 3});
+    Check(std::deque<std::string>{"x"});
+    Check(std::set<int>{5, 6});
+    Check(std::pair<std::string, int>{"a", 1});
+    Check(std::map<std::string, std::vector<int>>{{"a", {1}}, {"b\"", {}}});
+    Check(std::map<int, bool>{{-1, true}, {2, false}});
+    Check(std::unordered_map<std::string, int>{{"a", 1}, {"b", 2}});
+    Check(FlatMap<int, std::string>{{3, "c"}, {-1, "a"}});
+
+    // Every element counts as the longest number of its type
+    EXPECT_EQ(Check(std::vector<uint8_t>(10, 1)).bytes, 2 + 9 + 10 * 3);
+}
+
+TEST(Estimate, Structs)
+{
+    Channel channel{
+        "forsen",
+        {{"forsenE", 28, 1.5}, {"forsenW", 32, std::nullopt}},
+        {{1, "sub"}, {1000, "bits"}},
+    };
+    auto estimate = Check(channel);
+
+    // The names and structure are counted as they are
+    rapidjson::Document d;
+    EXPECT_EQ(estimate.nodes,
+              CountNodes(Serialize<Channel>::get(channel, d.GetAllocator())));
+
+    Check(Shape{5});
+    Check(Shape{"forsen"});
+    Check(UntaggedShape{std::vector<std::string>{"a"}});
+    Check(std::optional<Emote>{});
+    Check(std::vector<std::optional<Shape>>{Shape{1}, std::nullopt});
+}
+
+TEST(Estimate, Fallback)
+{
+    // Types without a specialization are counted exactly, by writing them
+    std::map<std::string, std::any> any{
+        {"a", 1},
+        {"b", std::vector<std::any>{std::string("x"), 2.5, true}},
+    };
+    EXPECT_EQ(Check(any).bytes, Write(any).size());
+    EXPECT_EQ(Check(std::any(std::string("forsen"))).bytes, 8);
+
+    Tracked<std::vector<int>> tracked({1, 2, 3});
+    EXPECT_EQ(Check(tracked).bytes, Write(tracked).size());
+
+    Base64<std::vector<uint8_t>> bytes{{1, 2, 3, 4}};
+    EXPECT_EQ(Check(bytes).bytes, Write(bytes).size());
+}
+
+TEST(Estimate, Presize)
+{
+    std::vector<Channel> channels;
+    for (uint32_t i = 0; i < 500; ++i) {
+        channels.push_back({"channel" + std::to_string(i),
+                            {{"emote", static_cast<int>(i), 0.5}},
+                            {{i, "badge"}}});
+    }
+
+    auto estimate = EstimateSize<decltype(channels)>::get(channels);
+
+    rapidjson::StringBuffer buffer;
+    buffer.Reserve(estimate.bytes + 1);
+    auto capacity = buffer.GetCapacity();
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    EXPECT_TRUE(SerializeTo<decltype(channels)>::write(channels, writer));
+    EXPECT_NE(buffer.GetString(), nullptr);
+    EXPECT_EQ(buffer.GetCapacity(), capacity);
+
+    // The first chunk takes the whole tree
+    rapidjson::MemoryPoolAllocator<> pool(estimate.allocatorBytes());
+    auto tree = Serialize<decltype(channels)>::get(channels, pool);
+    EXPECT_EQ(tree.Size(), channels.size());
+    EXPECT_EQ(pool.Capacity(), estimate.allocatorBytes());
+}
@@ -0,0 +1,343 @@
+#include "common.hpp"
+
+#include <gtest/gtest.h>
+#include <rapidjson/document.h>
+#include <rapidjson/reader.h>
+
+#include <any>
+#include <map>
+#include <pajlada/serialize.hpp>
+#include <pajlada/serialize/fields.hpp>
+#include <pajlada/serialize/parallel.hpp>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Built into its own executable with
+// PAJLADA_ERROR_POLICY=PAJLADA_ERROR_POLICY_FAIL_FAST
+
+using namespace pajlada;
+using namespace test;
+
+namespace {
+
+// Counts how often it's decoded
+struct Counted {
+    static inline int decoded = 0;
+
+    int value = 0;
+};
+
+struct Person {
+    std::string name;
+    std::vector<int> scores;
+};
+
+}  // namespace
+
+template <typename RJValue>
+struct pajlada::Deserialize<Counted, RJValue> {
+    static Counted
+    get(const RJValue &value, bool *error = nullptr)
+    {
+        ++Counted::decoded;
+        return {Deserialize<int, RJValue>::get(value, error)};
+    }
+};
+
+PAJLADA_SERIALIZE_FIELDS(Person, name, scores);
+
+namespace {
+
+// Runs every task on the calling thread, in order
+class InlineExecutor
+{
+public:
+    size_t
+    concurrency() const
+    {
+        return 4;
+    }
+
+    template <typename Task>
+    void
+    run(size_t count, Task &&task)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            task(i);
+        }
+    }
+};
+
+// [[0], [1], ...] with an object at [count - 1][1]
+rapidjson::Document
+MakeNestedArray(size_t count)
+{
+    rapidjson::Document d(rapidjson::kArrayType);
+    auto &a = d.GetAllocator();
+    for (size_t i = 0; i < count; ++i) {
+        rapidjson::Value inner(rapidjson::kArrayType);
+        inner.PushBack(static_cast<int>(i), a);
+        d.PushBack(inner, a);
+    }
+    d[static_cast<rapidjson::SizeType>(count - 1)].PushBack(
+        rapidjson::Value(rapidjson::kObjectType), a);
+    return d;
+}
+
+}  // namespace
+
+static_assert(PAJLADA_ERROR_POLICY == PAJLADA_ERROR_POLICY_FAIL_FAST);
+
+TEST(FailFast, VectorStopsAtFirstError)
+{
+    auto d = ParseDocument(R"([1, "x", 3, 4])");
+
+    bool error = false;
+    auto v = Deserialize<std::vector<int>>::get(d, &error);
+
+    EXPECT_TRUE(error);
+    ASSERT_EQ(v.size(), 4);
+    EXPECT_EQ(v[0], 1);
+    // Never decoded
+    EXPECT_EQ(v[2], 0);
+    EXPECT_EQ(v[3], 0);
+    EXPECT_EQ(ErrorPath::current().toString(), "/1");
+}
+
+TEST(FailFast, SkipsRemainingElements)
+{
+    auto d = ParseDocument(R"([1, 2, "x", 4, 5, 6])");
+
+    Counted::decoded = 0;
+    bool error = false;
+    Deserialize<std::vector<Counted>>::get(d, &error);
+
+    EXPECT_TRUE(error);
+    EXPECT_EQ(Counted::decoded, 3);
+
+    Counted::decoded = 0;
+    error = false;
+    Deserialize<std::array<Counted, 6>>::get(d, &error);
+
+    EXPECT_TRUE(error);
+    EXPECT_EQ(Counted::decoded, 3);
+}
+
+TEST(FailFast, Pair)
+{
+    auto d = ParseDocument(R"(["x", 2])");
+
+    Counted::decoded = 0;
+    bool error = false;
+    Deserialize<std::pair<Counted, Counted>>::get(d, &error);
+
+    EXPECT_TRUE(error);
+    EXPECT_EQ(Counted::decoded, 1);
+    EXPECT_EQ(ErrorPath::current().toString(), "/0");
+}
+
+TEST(FailFast, NestedPath)
+{
+    using Type = std::map<std::string, std::vector<std::vector<int>>>;
+
+    auto d = ParseDocument(R"({"a": [[1], [2]], "b": [[3], [4, "x"]]})");
+
+    bool error = false;
+    Deserialize<Type>::get(d, &error);
+
+    EXPECT_TRUE(error);
+    const auto &path = ErrorPath::current();
+    ASSERT_EQ(path.size(), 3);
+    EXPECT_TRUE(path[0].isKey());
+    EXPECT_EQ(path[0].key, "b");
+    EXPECT_FALSE(path[1].isKey());
+    EXPECT_EQ(path[1].index, 1);
+    EXPECT_EQ(path[2].index, 1);
+    EXPECT_FALSE(path.truncated());
+    EXPECT_EQ(path.toString(), "/b/1/1");
+}
+
+TEST(FailFast, MapInto)
+{
+    auto d = ParseDocument(R"({"a": 1, "b": "x", "c": 3})");
+
+    std::map<std::string, int> target{{"a", 0}, {"b", 0}, {"c", 0}};
+    bool error = false;
+    Deserialize<std::map<std::string, int>>::into(target, d, &error);
+
+    EXPECT_TRUE(error);
+    EXPECT_EQ(target["a"], 1);
+    EXPECT_EQ(target["c"], 0);
+    EXPECT_EQ(ErrorPath::current().toString(), "/b");
+}
+
+TEST(FailFast, InvalidNumberKey)
+{
+    auto d = ParseDocument(R"({"1": 1, "x": 2, "3": 3})");
+
+    bool error = false;
+    auto map = Deserialize<std::map<int, int>>::get(d, &error);
+
+    EXPECT_TRUE(error);
+    EXPECT_EQ(map, (std::map<int, int>{{1, 1}}));
+    EXPECT_EQ(ErrorPath::current().toString(), "/x");
+}
+
+TEST(FailFast, ContainerOfTheWrongKind)
+{
+    auto d = ParseDocument(R"({"a": [1], "b": 2})");
+
+    bool error = false;
+    Deserialize<std::map<std::string, std::vector<int>>>::get(d, &error);
+
+    EXPECT_TRUE(error);
+    EXPECT_EQ(ErrorPath::current().toString(), "/b");
+}
+
+TEST(FailFast, EscapedKeys)
+{
+    auto d = ParseDocument(R"({"a/b~c": [true, "x"]})");
+
+    bool error = false;
+    Deserialize<std::map<std::string, std::vector<bool>>>::get(d, &error);
+
+    EXPECT_TRUE(error);
+    EXPECT_EQ(ErrorPath::current().toString(), "/a~1b~0c/1");
+}
+
+TEST(FailFast, Fields)
+{
+    auto d = ParseDocument(R"({"name": "forsen", "scores": [1, 2, null]})");
+
+    bool error = false;
+    auto person = Deserialize<Person>::get(d, &error);
+
+    EXPECT_TRUE(error);
+    EXPECT_EQ(person.name, "forsen");
+    EXPECT_EQ(ErrorPath::current().toString(), "/scores/2");
+}
+
+TEST(FailFast, RecoveredVariantAlternative)
+{
+    using Type = std::vector<
+        std::variant<std::vector<int>, std::vector<std::string>>>;
+
+    // The first element fails as a vector<int> before it's decoded as a
+    // vector<string>, which must not end up in the path of the real error
+    auto d = ParseDocument(R"([["abc"], 5])");
+
+    bool error = false;
+    Deserialize<Type>::get(d, &error);
+
+    EXPECT_TRUE(error);
+    EXPECT_EQ(ErrorPath::current().toString(), "/1");
+}
+
+TEST(FailFast, PathIsResetForEachDocument)
+{
+    bool error = false;
+    Deserialize<std::vector<std::vector<int>>>::get(
+        ParseDocument(R"([[1, "x"]])"), &error);
+    EXPECT_TRUE(error);
+    EXPECT_EQ(ErrorPath::current().toString(), "/0/1");
+
+    error = false;
+    Deserialize<std::vector<int>>::get(ParseDocument(R"([1, 2])"), &error);
+    EXPECT_FALSE(error);
+    EXPECT_TRUE(ErrorPath::current().empty());
+}
+
+TEST(FailFast, Truncated)
+{
+    std::string json;
+    for (size_t i = 0; i < ErrorPath::MaxDepth + 8; ++i) {
+        json += '[';
+    }
+    json += "null";
+    for (size_t i = 0; i < ErrorPath::MaxDepth + 8; ++i) {
+        json += ']';
+    }
+
+    auto d = ParseDocument(json.c_str());
+
+    bool error = false;
+    Deserialize<std::any>::get(d, &error);
+
+    EXPECT_TRUE(error);
+    const auto &path = ErrorPath::current();
+    EXPECT_TRUE(path.truncated());
+    EXPECT_EQ(path.size(), ErrorPath::MaxDepth);
+}
+
+TEST(FailFast, StreamStopsParsing)
+{
+    std::vector<int> out;
+    bool error = false;
+    rapidjson::StringStream ss(R"([1, "x", 3])");
+    auto result = DeserializeStream(ss, out, &error);
+
+    EXPECT_TRUE(error);
+    EXPECT_EQ(result.Code(), rapidjson::kParseErrorTermination);
+}
+
+TEST(FailFast, ParallelVectorPath)
+{
+    auto d = MakeNestedArray(50000);
+
+    ThreadPool pool(4);
+    bool error = false;
+    Deserialize<std::vector<std::vector<int>>>::getParallel(d, pool, &error);
+
+    EXPECT_TRUE(error);
+    EXPECT_EQ(ErrorPath::current().toString(), "/49999/1");
+
+    // The next document starts with a clean path
+    d[49999].PopBack();
+    error = false;
+    Deserialize<std::vector<std::vector<int>>>::getParallel(d, pool, &error);
+    EXPECT_FALSE(error);
+    EXPECT_TRUE(ErrorPath::current().empty());
+}
+
+TEST(FailFast, ParallelMapPath)
+{
+    rapidjson::Document d(rapidjson::kObjectType);
+    auto &a = d.GetAllocator();
+    for (int i = 0; i < 20000; ++i) {
+        rapidjson::Value key(("key" + std::to_string(i)).c_str(), a);
+        rapidjson::Value value(rapidjson::kArrayType);
+        value.PushBack(i, a);
+        d.AddMember(key, value, a);
+    }
+    d["key15000"].PushBack("x", a);
+
+    ThreadPool pool(4);
+    bool error = false;
+    Deserialize<std::map<std::string, std::vector<int>>>::getParallel(
+        d, pool, &error);
+
+    EXPECT_TRUE(error);
+    EXPECT_EQ(ErrorPath::current().toString(), "/key15000/1");
+}
+
+TEST(FailFast, ParallelStopsEveryChunk)
+{
+    size_t count = 8 * detail::ParallelMinChunkSize;
+    rapidjson::Document d(rapidjson::kArrayType);
+    for (size_t i = 0; i < count; ++i) {
+        d.PushBack(static_cast<int>(i), d.GetAllocator());
+    }
+    d[1].SetString("x");
+
+    InlineExecutor executor;
+    Counted::decoded = 0;
+    bool error = false;
+    Deserialize<std::vector<Counted>>::getParallel(d, executor, &error);
+
+    // The chunks after the first one don't decode anything
+    EXPECT_TRUE(error);
+    EXPECT_EQ(Counted::decoded, 2);
+    EXPECT_EQ(ErrorPath::current().toString(), "/1");
+}
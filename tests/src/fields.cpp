@@ -0,0 +1,254 @@
+#include "common.hpp"
+
+#include <gtest/gtest.h>
+#include <rapidjson/document.h>
+#include <rapidjson/reader.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <map>
+#include <optional>
+#include <pajlada/serialize.hpp>
+#include <pajlada/serialize/fields.hpp>
+#include <string>
+#include <variant>
+#include <vector>
+
+using namespace pajlada;
+using namespace test;
+
+namespace {
+
+struct Inner {
+    int x = 0;
+    std::optional<std::string> label;
+
+    bool operator==(const Inner &other) const = default;
+};
+
+struct Outer {
+    std::string name;
+    std::vector<Inner> inners;
+    std::map<std::string, Inner> byName;
+    double ratio = 0.0;
+    bool enabled = false;
+
+    bool operator==(const Outer &other) const = default;
+};
+
+struct Empty {
+    bool operator==(const Empty &other) const = default;
+};
+
+struct Strict {
+    int a = 0;
+    int b = 0;
+};
+
+// Enough fields for the names to share prefixes and lengths
+struct Wide {
+    int f00 = 0;
+    int f01 = 0;
+    int f02 = 0;
+    int f03 = 0;
+    int f04 = 0;
+    int f05 = 0;
+    int f06 = 0;
+    int f07 = 0;
+    int f08 = 0;
+    int f09 = 0;
+    int f10 = 0;
+    int f11 = 0;
+    int f12 = 0;
+    int f13 = 0;
+    int f14 = 0;
+    int f15 = 0;
+    int f16 = 0;
+    int f17 = 0;
+    int f18 = 0;
+    int f19 = 0;
+    int f20 = 0;
+    int f21 = 0;
+    int f22 = 0;
+    int f23 = 0;
+    int f24 = 0;
+    int f25 = 0;
+    int f26 = 0;
+    int f27 = 0;
+    int f28 = 0;
+    int f29 = 0;
+    int f30 = 0;
+    int f31 = 0;
+    int f32 = 0;
+    int f33 = 0;
+    int f34 = 0;
+    int f35 = 0;
+    int f36 = 0;
+    int f37 = 0;
+    int f38 = 0;
+    int f39 = 0;
+    int f40 = 0;
+    int f41 = 0;
+    int f42 = 0;
+    int f43 = 0;
+    int f44 = 0;
+    int f45 = 0;
+    int f46 = 0;
+    int f47 = 0;
+};
+
+const Outer outer{
+    "forsen",
+    {{1, "a"}, {2, std::nullopt}},
+    {{"b", {3, "c"}}},
+    0.5,
+    true,
+};
+
+const char *const outerJson =
+    R"({"name":"forsen","inners":[{"x":1,"label":"a"},{"x":2,"label":null}],)"
+    R"("byName":{"b":{"x":3,"label":"c"}},"ratio":0.5,"enabled":true})";
+
+}  // namespace
+
+PAJLADA_SERIALIZE_FIELDS(Inner, x, label);
+PAJLADA_SERIALIZE_FIELDS(Outer, name, inners, byName, ratio, enabled);
+PAJLADA_SERIALIZE_FIELDS(Empty);
+PAJLADA_SERIALIZE_FIELDS(Strict, a, b);
+PAJLADA_SERIALIZE_FIELDS(Wide, f00, f01, f02, f03, f04, f05, f06, f07,
+                         f08, f09, f10, f11, f12, f13, f14, f15,
+                         f16, f17, f18, f19, f20, f21, f22, f23,
+                         f24, f25, f26, f27, f28, f29, f30, f31,
+                         f32, f33, f34, f35, f36, f37, f38, f39,
+                         f40, f41, f42, f43, f44, f45, f46, f47);
+
+template <>
+struct pajlada::FieldsOptions<Strict> {
+    static constexpr bool rejectUnknown = true;
+    static constexpr bool requireAll = true;
+};
+
+TEST(Fields, Table)
+{
+    static_assert(detail::FieldCount<Outer> == 5);
+    static_assert(std::get<0>(Fields<Outer>::value).name == "name");
+    static_assert(std::get<0>(Fields<Outer>::value).name.size() == 4);
+    static_assert(detail::FieldIndex<Outer>("ratio") == 3);
+    static_assert(detail::FieldIndex<Outer>("nope") == 5);
+    static_assert(JsonKinds<Outer>::value == JsonKind::Object);
+}
+
+TEST(Fields, Serialize)
+{
+    EXPECT_EQ(Stringify(outer), outerJson);
+    EXPECT_EQ(Write(outer), outerJson);
+
+    EXPECT_EQ(Stringify(Empty{}), "{}");
+    EXPECT_EQ(Write(Empty{}), "{}");
+}
+
+TEST(Fields, Deserialize)
+{
+    bool error = false;
+
+    EXPECT_EQ(Parse<Outer>(outerJson, error), outer);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(ParseStream<Outer>(outerJson, error), outer);
+    EXPECT_FALSE(error);
+
+    // Missing members keep their default, unknown ones are ignored and the
+    // first of duplicate members wins
+    const char *partial = R"({"x":1,"extra":{"y":[1]},"x":2})";
+    EXPECT_EQ(Parse<Inner>(partial, error), (Inner{1, std::nullopt}));
+    EXPECT_EQ(ParseStream<Inner>(partial, error), (Inner{1, std::nullopt}));
+    EXPECT_FALSE(error);
+
+    Parse<Inner>("[]", error);
+    EXPECT_TRUE(error);
+
+    error = false;
+    ParseStream<Inner>("[]", error);
+    EXPECT_TRUE(error);
+}
+
+TEST(Fields, Into)
+{
+    bool error = false;
+
+    Inner target{5, "keep"};
+    rapidjson::Document d;
+    d.Parse(R"({"x":6})");
+    Deserialize<Inner>::into(target, d, &error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(target, (Inner{6, "keep"}));
+}
+
+TEST(Fields, Variant)
+{
+    using V = std::variant<int, Inner>;
+
+    bool error = false;
+    EXPECT_EQ(Parse<V>(R"({"x":3})", error), V(Inner{3, std::nullopt}));
+    EXPECT_EQ(Parse<V>("3", error), V(3));
+    EXPECT_FALSE(error);
+}
+
+TEST(Fields, PerfectHash)
+{
+    using Lookup = detail::FieldLookup<Wide>;
+
+    for (size_t i = 0; i < Lookup::Count; ++i) {
+        EXPECT_EQ(Lookup::find(Lookup::Names[i]), i);
+    }
+    EXPECT_EQ(Lookup::find("f48"), Lookup::Count);
+    EXPECT_EQ(Lookup::find("f0"), Lookup::Count);
+    EXPECT_EQ(Lookup::find(""), Lookup::Count);
+
+    static_assert(detail::FieldIndex<Wide>("f47") == 47);
+
+    bool error = false;
+    auto out = Parse<Wide>(R"({"f47":47,"f00":1,"f23":23,"g":1})", error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(out.f47, 47);
+    EXPECT_EQ(out.f00, 1);
+    EXPECT_EQ(out.f23, 23);
+    EXPECT_EQ(out.f01, 0);
+}
+
+TEST(Fields, Report)
+{
+    bool error = false;
+    rapidjson::Document d;
+    d.Parse(R"({"x":1,"extra":2,"other":[3]})");
+
+    Inner target;
+    FieldReport report;
+    DeserializeFieldsInto(target, d, &error, &report);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(target.x, 1);
+    EXPECT_EQ(report.unknown, (std::vector<std::string>{"extra", "other"}));
+    EXPECT_EQ(report.missing, (std::vector<std::string_view>{"label"}));
+}
+
+TEST(Fields, Options)
+{
+    bool error = false;
+
+    Parse<Strict>(R"({"a":1,"b":2})", error);
+    EXPECT_FALSE(error);
+    ParseStream<Strict>(R"({"a":1,"b":2})", error);
+    EXPECT_FALSE(error);
+
+    Parse<Strict>(R"({"a":1})", error);
+    EXPECT_TRUE(error);
+    error = false;
+    ParseStream<Strict>(R"({"a":1})", error);
+    EXPECT_TRUE(error);
+
+    error = false;
+    Parse<Strict>(R"({"a":1,"b":2,"c":3})", error);
+    EXPECT_TRUE(error);
+    error = false;
+    ParseStream<Strict>(R"({"a":1,"b":2,"c":3})", error);
+    EXPECT_TRUE(error);
+}
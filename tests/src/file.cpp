@@ -0,0 +1,176 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <pajlada/serialize/file.hpp>
+#include <string>
+#include <vector>
+
+using namespace pajlada;
+
+namespace {
+
+class File : public ::testing::Test
+{
+protected:
+    void
+    SetUp() override
+    {
+        this->directory_ = std::filesystem::temp_directory_path() /
+                           ("pajlada-serialize-" +
+                            std::string(::testing::UnitTest::GetInstance()
+                                            ->current_test_info()
+                                            ->name()));
+        std::filesystem::remove_all(this->directory_);
+        std::filesystem::create_directories(this->directory_);
+    }
+
+    void
+    TearDown() override
+    {
+        std::filesystem::remove_all(this->directory_);
+    }
+
+    std::filesystem::path
+    path(const std::string &name) const
+    {
+        return this->directory_ / name;
+    }
+
+    static void
+    WriteText(const std::filesystem::path &path, const std::string &text)
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << text;
+    }
+
+private:
+    std::filesystem::path directory_;
+};
+
+using Settings = std::map<std::string, std::vector<std::string>>;
+
+}  // namespace
+
+TEST_F(File, RoundTrip)
+{
+    Settings settings{
+        {"channels", {"forsen", "pajlada"}},
+        {"empty", {}},
+        {"escaped", {"\"quoted\"\n", "\\u00e5"}},
+    };
+
+    FileStats saveStats;
+    ASSERT_TRUE(SaveFile(this->path("settings.json"), settings, &saveStats));
+    EXPECT_EQ(saveStats.bytes,
+              std::filesystem::file_size(this->path("settings.json")));
+    // Nothing but the file itself is left behind
+    EXPECT_EQ(std::distance(std::filesystem::directory_iterator(
+                                this->path("settings.json").parent_path()),
+                            std::filesystem::directory_iterator()),
+              1);
+
+    FileStats loadStats;
+    bool error = false;
+    auto loaded =
+        LoadFile<Settings>(this->path("settings.json"), &error, &loadStats);
+
+    EXPECT_FALSE(error);
+    EXPECT_EQ(loaded, settings);
+    EXPECT_EQ(loadStats.bytes, saveStats.bytes);
+    EXPECT_GE(loadStats.total(), loadStats.parse);
+}
+
+TEST_F(File, SaveReplacesExistingFile)
+{
+    this->WriteText(this->path("a.json"), "[1, 2, 3, 4, 5, 6, 7, 8, 9]");
+
+    ASSERT_TRUE(SaveFile(this->path("a.json"), std::vector<int>{1}));
+
+    bool error = false;
+    EXPECT_EQ(LoadFile<std::vector<int>>(this->path("a.json"), &error),
+              std::vector<int>{1});
+    EXPECT_FALSE(error);
+}
+
+TEST_F(File, SaveKeepsPermissions)
+{
+    namespace fs = std::filesystem;
+
+    auto path = this->path("a.json");
+    this->WriteText(path, "[]");
+    auto permissions = fs::perms::owner_read | fs::perms::owner_write |
+                       fs::perms::group_read;
+    fs::permissions(path, permissions);
+
+    ASSERT_TRUE(SaveFile(path, std::vector<int>{1}));
+    EXPECT_EQ(fs::status(path).permissions(), permissions);
+}
+
+TEST_F(File, NewFileFollowsUmask)
+{
+    namespace fs = std::filesystem;
+
+    // Same as any other file created by the process
+    this->WriteText(this->path("plain.json"), "[]");
+
+    ASSERT_TRUE(SaveFile(this->path("a.json"), std::vector<int>{1}));
+    EXPECT_EQ(fs::status(this->path("a.json")).permissions(),
+              fs::status(this->path("plain.json")).permissions());
+}
+
+TEST_F(File, SaveLeavesOtherFilesAlone)
+{
+    // Used to be the name of the temporary file
+    this->WriteText(this->path("a.json.tmp"), "keep");
+
+    ASSERT_TRUE(SaveFile(this->path("a.json"), std::vector<int>{1}));
+    EXPECT_EQ(std::filesystem::file_size(this->path("a.json.tmp")), 4);
+}
+
+TEST_F(File, FileEndingOnPageBoundary)
+{
+    // Nothing but the JSON text in whole pages, ParseInsitu still needs to
+    // find a '\0' after it
+    for (size_t size : {4096, 8192, 16384, 65536}) {
+        std::string text(size, 'a');
+        text.front() = '"';
+        text.back() = '"';
+        this->WriteText(this->path("page.json"), text);
+
+        bool error = false;
+        auto loaded = LoadFile<std::string>(this->path("page.json"), &error);
+        EXPECT_FALSE(error) << size;
+        EXPECT_EQ(loaded.size(), size - 2);
+    }
+}
+
+TEST_F(File, LoadErrors)
+{
+    bool error = false;
+    LoadFile<std::vector<int>>(this->path("missing.json"), &error);
+    EXPECT_TRUE(error);
+
+    this->WriteText(this->path("empty.json"), "");
+    error = false;
+    LoadFile<std::vector<int>>(this->path("empty.json"), &error);
+    EXPECT_TRUE(error);
+
+    this->WriteText(this->path("invalid.json"), "[1, 2");
+    error = false;
+    LoadFile<std::vector<int>>(this->path("invalid.json"), &error);
+    EXPECT_TRUE(error);
+
+    this->WriteText(this->path("wrong.json"), "{}");
+    error = false;
+    LoadFile<std::vector<int>>(this->path("wrong.json"), &error);
+    EXPECT_TRUE(error);
+}
+
+TEST_F(File, SaveErrors)
+{
+    EXPECT_FALSE(SaveFile(this->path("missing/a.json"), std::vector<int>{}));
+    EXPECT_FALSE(std::filesystem::exists(this->path("missing")));
+}
@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+#include <rapidjson/document.h>
+#include <rapidjson/reader.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <map>
+#include <pajlada/serialize.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace pajlada;
+
+namespace {
+
+struct Emote {
+    std::string_view name;
+    std::string_view url;
+    int id = 0;
+};
+
+}  // namespace
+
+namespace pajlada {
+
+template <typename RJValue>
+struct Deserialize<Emote, RJValue> {
+    static Emote
+    get(const RJValue &value, bool *error = nullptr)
+    {
+        Emote ret;
+
+        if (!value.IsObject()) {
+            PAJLADA_REPORT_ERROR(error)
+            return ret;
+        }
+
+        auto name = value.FindMember("name");
+        if (name != value.MemberEnd()) {
+            ret.name =
+                Deserialize<std::string_view, RJValue>::get(name->value, error);
+        }
+
+        auto url = value.FindMember("url");
+        if (url != value.MemberEnd()) {
+            ret.url =
+                Deserialize<std::string_view, RJValue>::get(url->value, error);
+        }
+
+        auto id = value.FindMember("id");
+        if (id != value.MemberEnd()) {
+            ret.id = Deserialize<int, RJValue>::get(id->value, error);
+        }
+
+        return ret;
+    }
+};
+
+}  // namespace pajlada
+
+TEST(Insitu, StringViews)
+{
+    bool error = false;
+
+    auto loaded = LoadInsitu<std::vector<std::string_view>>(
+        R"(["forsen", "esc\"aped", ""])", &error);
+    EXPECT_FALSE(error);
+
+    ASSERT_EQ(loaded->size(), 3);
+    EXPECT_EQ((*loaded)[0], "forsen");
+    EXPECT_EQ((*loaded)[1], "esc\"aped");
+    EXPECT_EQ((*loaded)[2], "");
+
+    for (const auto &view : *loaded) {
+        EXPECT_TRUE(loaded.owns(view));
+    }
+    EXPECT_FALSE(loaded.owns("forsen"));
+
+    // Copies share the buffer, so the views survive the original
+    auto copy = loaded;
+    loaded = {};
+    EXPECT_EQ(copy->front(), "forsen");
+    EXPECT_TRUE(copy.owns(copy->front()));
+}
+
+TEST(Insitu, StringViewMap)
+{
+    bool error = false;
+
+    // Short enough to fit in the small string buffer, which must not move
+    // along with the InsituValue
+    auto loaded = LoadInsitu<std::map<std::string_view, std::string_view>>(
+        R"({"a": "b", "a": "c"})", &error);
+    EXPECT_FALSE(error);
+
+    auto moved = std::move(loaded);
+    ASSERT_EQ(moved->size(), 1);
+    EXPECT_EQ(moved->at("a"), "b");
+    EXPECT_TRUE(moved.owns(moved->begin()->first));
+    EXPECT_TRUE(moved.owns(moved->begin()->second));
+}
+
+TEST(Insitu, Struct)
+{
+    bool error = false;
+
+    auto loaded = LoadInsitu<std::map<std::string, Emote>>(
+        R"({"Kappa": {"name": "Kappa", "url": "https://example.com/25",
+            "id": 25}})",
+        &error);
+    EXPECT_FALSE(error);
+
+    const auto &emote = loaded->at("Kappa");
+    EXPECT_EQ(emote.name, "Kappa");
+    EXPECT_EQ(emote.url, "https://example.com/25");
+    EXPECT_EQ(emote.id, 25);
+    EXPECT_TRUE(loaded.owns(emote.name));
+    EXPECT_TRUE(loaded.owns(emote.url));
+}
+
+TEST(Insitu, ParseError)
+{
+    bool error = false;
+
+    auto loaded = LoadInsitu<std::vector<std::string_view>>(R"(["a")", &error);
+    EXPECT_TRUE(error);
+    EXPECT_TRUE(loaded->empty());
+}
+
+TEST(Insitu, StringWithLength)
+{
+    bool error = false;
+    rapidjson::Document d;
+    d.Parse(R"(["a\u0000b"])");
+
+    auto out = Deserialize<std::vector<std::string>>::get(d, &error);
+    EXPECT_FALSE(error);
+    ASSERT_EQ(out.size(), 1);
+    EXPECT_EQ(out[0], std::string("a\0b", 3));
+
+    // Round trips with the embedded null intact
+    auto value = Serialize<std::string>::get(out[0], d.GetAllocator());
+    EXPECT_EQ(value.GetStringLength(), 3);
+}
+
+TEST(Insitu, SerializeStringViewMap)
+{
+    std::map<std::string_view, int> in{{"a", 1}, {"b", 2}};
+
+    rapidjson::Document d;
+    auto value =
+        Serialize<std::map<std::string_view, int>>::get(in, d.GetAllocator());
+
+    rapidjson::StringBuffer dom;
+    rapidjson::Writer<rapidjson::StringBuffer> domWriter(dom);
+    value.Accept(domWriter);
+
+    rapidjson::StringBuffer sax;
+    rapidjson::Writer<rapidjson::StringBuffer> saxWriter(sax);
+    EXPECT_TRUE(
+        (SerializeTo<std::map<std::string_view, int>>::write(in, saxWriter)));
+
+    EXPECT_EQ(std::string(dom.GetString()), R"({"a":1,"b":2})");
+    EXPECT_EQ(std::string(sax.GetString()), R"({"a":1,"b":2})");
+}
+
+TEST(Insitu, StreamingLifetimeCheck)
+{
+    bool error = false;
+
+    // Views are only handed out when the strings live in the input buffer
+    std::vector<std::string_view> out;
+    rapidjson::StringStream ss(R"(["a", "b"])");
+    DeserializeStream(ss, out, &error);
+    EXPECT_TRUE(error);
+    ASSERT_EQ(out.size(), 2);
+    EXPECT_TRUE(out[0].empty());
+
+    std::map<std::string_view, int> map;
+    error = false;
+    rapidjson::StringStream mapStream(R"({"a": 1})");
+    DeserializeStream(mapStream, map, &error);
+    EXPECT_TRUE(error);
+    EXPECT_TRUE(map.empty());
+
+    std::string json = R"({"a": ["b", "c"]})";
+    std::map<std::string_view, std::vector<std::string_view>> insitu;
+    error = false;
+    rapidjson::InsituStringStream is(json.data());
+    DeserializeStream<rapidjson::kParseInsituFlag>(is, insitu, &error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(insitu["a"], (std::vector<std::string_view>{"b", "c"}));
+}
@@ -0,0 +1,130 @@
+#include "common.hpp"
+
+#include <gtest/gtest.h>
+#include <rapidjson/document.h>
+
+#include <array>
+#include <map>
+#include <optional>
+#include <pajlada/serialize.hpp>
+#include <string>
+#include <vector>
+
+using namespace pajlada;
+using namespace test;
+
+TEST(Into, VectorReusesCapacity)
+{
+    bool error = false;
+    std::vector<int> target;
+    target.reserve(16);
+    const auto *data = target.data();
+
+    auto d = ParseDocument("[1, 2, 3]");
+    Deserialize<std::vector<int>>::into(target, d, &error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(target, (std::vector<int>{1, 2, 3}));
+    EXPECT_EQ(target.data(), data);
+
+    d = ParseDocument("[4]");
+    Deserialize<std::vector<int>>::into(target, d, &error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(target, (std::vector<int>{4}));
+    EXPECT_EQ(target.data(), data);
+
+    d = ParseDocument(R"({"a": 1})");
+    Deserialize<std::vector<int>>::into(target, d, &error);
+    EXPECT_TRUE(error);
+    EXPECT_TRUE(target.empty());
+}
+
+TEST(Into, NestedStringsAreOverwrittenInPlace)
+{
+    bool error = false;
+    std::vector<std::string> target{std::string(64, 'x')};
+    const auto *data = target[0].data();
+
+    auto d = ParseDocument(R"(["forsen", "peppah"])");
+    Deserialize<std::vector<std::string>>::into(target, d, &error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(target, (std::vector<std::string>{"forsen", "peppah"}));
+    EXPECT_EQ(target[0].data(), data);
+}
+
+TEST(Into, MapReusesNodes)
+{
+    bool error = false;
+    std::map<std::string, std::vector<int>> target{
+        {"a", {1, 2, 3}},
+        {"b", {4}},
+        {"c", {5}},
+    };
+    const auto *a = &target["a"];
+    const auto *aData = target["a"].data();
+    const auto *c = &target["c"];
+
+    // "b" and "c" are gone, "d" is new and takes over one of their nodes
+    auto d = ParseDocument(R"({"a": [7], "d": [8, 9]})");
+    Deserialize<std::map<std::string, std::vector<int>>>::into(target, d,
+                                                                &error);
+    EXPECT_FALSE(error);
+    ASSERT_EQ(target.size(), 2);
+    EXPECT_EQ(target["a"], (std::vector<int>{7}));
+    EXPECT_EQ(target["d"], (std::vector<int>{8, 9}));
+    EXPECT_EQ(&target["a"], a);
+    EXPECT_EQ(target["a"].data(), aData);
+    EXPECT_EQ(&target["d"], c);
+}
+
+TEST(Into, MapMatchesGet)
+{
+    bool error = false;
+    const char *json = R"({"x": 1, "b": 2, "x": 3, "z": 4, "z": 5})";
+    auto d = ParseDocument(json);
+
+    auto expected = Deserialize<std::map<std::string, int>>::get(d, &error);
+
+    std::map<std::string, int> target{{"b", 9}, {"q", 9}, {"x", 9}};
+    Deserialize<std::map<std::string, int>>::into(target, d, &error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(target, expected);
+    EXPECT_EQ(target["x"], 1);
+    EXPECT_EQ(target["z"], 4);
+}
+
+TEST(Into, ArrayPairOptional)
+{
+    bool error = false;
+
+    std::array<std::string, 2> array{"a", "b"};
+    auto d = ParseDocument(R"(["c", "d"])");
+    Deserialize<decltype(array)>::into(array, d, &error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(array, (std::array<std::string, 2>{"c", "d"}));
+
+    d = ParseDocument(R"(["c"])");
+    Deserialize<decltype(array)>::into(array, d, &error);
+    EXPECT_TRUE(error);
+    EXPECT_EQ(array, (std::array<std::string, 2>{}));
+
+    error = false;
+    std::pair<std::string, int> pair{"a", 1};
+    d = ParseDocument(R"(["b", 2])");
+    Deserialize<decltype(pair)>::into(pair, d, &error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(pair, (std::pair<std::string, int>{"b", 2}));
+
+    std::optional<std::vector<int>> optional;
+    d = ParseDocument("[1]");
+    Deserialize<decltype(optional)>::into(optional, d, &error);
+    EXPECT_EQ(optional, (std::vector<int>{1}));
+    const auto *data = optional->data();
+    d = ParseDocument("[2]");
+    Deserialize<decltype(optional)>::into(optional, d, &error);
+    EXPECT_EQ(optional, (std::vector<int>{2}));
+    EXPECT_EQ(optional->data(), data);
+    d = ParseDocument("null");
+    Deserialize<decltype(optional)>::into(optional, d, &error);
+    EXPECT_FALSE(optional.has_value());
+    EXPECT_FALSE(error);
+}
@@ -0,0 +1,229 @@
+#include "common.hpp"
+
+#include <gtest/gtest.h>
+#include <rapidjson/document.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <map>
+#include <pajlada/serialize.hpp>
+#include <pajlada/serialize/fields.hpp>
+#include <pajlada/serialize/lazy.hpp>
+#include <string>
+#include <vector>
+
+using namespace pajlada;
+using namespace test;
+
+namespace {
+
+// Counts how often it is deserialized
+struct Plugin {
+    std::string name;
+    std::vector<int> values;
+
+    static inline int decoded = 0;
+};
+
+struct Config {
+    std::string name;
+    Lazy<std::map<std::string, Plugin>> plugins;
+    Lazy<std::vector<std::string>> history;
+};
+
+}  // namespace
+
+PAJLADA_SERIALIZE_FIELDS(Config, name, plugins, history);
+
+namespace pajlada {
+
+template <typename RJValue>
+struct Serialize<Plugin, RJValue> {
+    static RJValue
+    get(const Plugin &value, typename RJValue::AllocatorType &a)
+    {
+        RJValue ret(rapidjson::kObjectType);
+        detail::AddMember<std::string, RJValue>(ret, "name", value.name, a);
+        detail::AddMember<std::vector<int>, RJValue>(ret, "values",
+                                                     value.values, a);
+        return ret;
+    }
+};
+
+template <typename RJValue>
+struct Deserialize<Plugin, RJValue> {
+    static Plugin
+    get(const RJValue &value, bool *error = nullptr)
+    {
+        ++Plugin::decoded;
+
+        if (!value.IsObject() || !value.HasMember("name") ||
+            !value.HasMember("values")) {
+            PAJLADA_REPORT_ERROR(error)
+            return {};
+        }
+
+        return {
+            Deserialize<std::string, RJValue>::get(value["name"], error),
+            Deserialize<std::vector<int>, RJValue>::get(value["values"],
+                                                        error),
+        };
+    }
+};
+
+}  // namespace pajlada
+
+namespace {
+
+const char *const Json =
+    R"({"name":"forsen",)"
+    R"("plugins":{"a":{"name":"first","values":[1,2]},)"
+    R"("b":{"name":"second","values":[],"unknown":1.5}},)"
+    R"("history":["x","y\n\"z\""]})";
+
+Config
+Load(const char *json)
+{
+    bool error = false;
+    auto config = Parse<Config>(json, error);
+    EXPECT_FALSE(error);
+    return config;
+}
+
+}  // namespace
+
+TEST(Lazy, UntouchedSectionsAreNotDecoded)
+{
+    Plugin::decoded = 0;
+    auto config = Load(Json);
+
+    EXPECT_EQ(config.name, "forsen");
+    EXPECT_FALSE(config.plugins.decoded());
+    EXPECT_FALSE(config.history.decoded());
+    EXPECT_EQ(config.history.json(), R"(["x","y\n\"z\""])");
+
+    // Saved as it was loaded, unknown members included
+    EXPECT_EQ(Write(config), Json);
+    EXPECT_EQ(Stringify(config), Json);
+    EXPECT_EQ(Plugin::decoded, 0);
+}
+
+TEST(Lazy, DecodeOnFirstAccess)
+{
+    Plugin::decoded = 0;
+    auto config = Load(Json);
+
+    bool error = false;
+    const auto &plugins = config.plugins.get(&error);
+    EXPECT_FALSE(error);
+    EXPECT_TRUE(config.plugins.decoded());
+    EXPECT_EQ(Plugin::decoded, 2);
+    EXPECT_EQ(plugins.at("a").values, (std::vector<int>{1, 2}));
+
+    EXPECT_EQ(config.plugins->at("b").name, "second");
+    EXPECT_EQ(Plugin::decoded, 2);
+
+    // Reading doesn't change anything, so the original text is kept
+    EXPECT_EQ(Write(config), Json);
+
+    config.plugins.mutate().erase("b");
+    config.history.mutate().push_back("w");
+    EXPECT_TRUE(config.plugins.json().empty());
+
+    const char *expected =
+        R"({"name":"forsen",)"
+        R"("plugins":{"a":{"name":"first","values":[1,2]}},)"
+        R"("history":["x","y\n\"z\"","w"]})";
+    EXPECT_EQ(Write(config), expected);
+    EXPECT_EQ(Stringify(config), expected);
+}
+
+TEST(Lazy, Stream)
+{
+    Plugin::decoded = 0;
+
+    Config config;
+    config.plugins.set({{"old", Plugin{}}});
+
+    bool error = false;
+    rapidjson::StringStream ss(Json);
+    DeserializeStream(ss, config, &error);
+    EXPECT_FALSE(error);
+
+    EXPECT_FALSE(config.plugins.decoded());
+    EXPECT_EQ(Write(config), Json);
+    EXPECT_EQ(Plugin::decoded, 0);
+    EXPECT_EQ(config.plugins->size(), 2);
+
+    Lazy<int> scalar;
+    rapidjson::StringStream number("42");
+    DeserializeStream(number, scalar, &error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(scalar.json(), "42");
+    EXPECT_EQ(*scalar, 42);
+}
+
+TEST(Lazy, ErrorsAreReportedOnAccess)
+{
+    auto config = Load(R"({"plugins":{"a":{"name":"first"}},"history":5})");
+
+    bool error = false;
+    config.plugins.get(&error);
+    EXPECT_TRUE(error);
+
+    error = false;
+    config.history.get(&error);
+    EXPECT_TRUE(error);
+    EXPECT_TRUE(config.history->empty());
+
+    // The broken sections are still saved as they were
+    EXPECT_EQ(Write(config),
+              R"({"name":"","plugins":{"a":{"name":"first"}},"history":5})");
+
+    error = false;
+    auto broken = Lazy<int>::fromJson("[");
+    broken.get(&error);
+    EXPECT_TRUE(error);
+}
+
+TEST(Lazy, Doubles)
+{
+    // Read back exactly, whether decoded or copied into a tree
+    std::vector<double> values{0.1, 1.0 / 3, 0.30000000000000004,
+                               2.2250738585072014e-308,
+                               1.7976931348623157e308, 5e-324};
+    auto json = Write(values);
+    auto lazy = Lazy<std::vector<double>>::fromJson(json);
+
+    EXPECT_EQ(Stringify(lazy), json);
+    EXPECT_EQ(*lazy, values);
+}
+
+TEST(Lazy, BrokenTextIsSerializedAsTheValue)
+{
+    auto broken = Lazy<int>::fromJson("[");
+    EXPECT_EQ(Stringify(broken), "0");
+}
+
+TEST(Lazy, NeverLoaded)
+{
+    Lazy<std::vector<int>> numbers;
+    EXPECT_TRUE(numbers.decoded());
+    EXPECT_TRUE(numbers->empty());
+
+    numbers.set({1, 2, 3});
+    EXPECT_EQ(Write(numbers), "[1,2,3]");
+    EXPECT_EQ(Stringify(numbers), "[1,2,3]");
+}
+
+TEST(Lazy, PrettyWriterIndentsTheText)
+{
+    auto numbers = Lazy<std::vector<int>>::fromJson("[1,2]");
+
+    rapidjson::StringBuffer buffer;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+    EXPECT_TRUE(SerializeTo<Lazy<std::vector<int>>>::write(numbers, writer));
+    EXPECT_EQ(std::string(buffer.GetString()), "[\n    1,\n    2\n]");
+    EXPECT_FALSE(numbers.decoded());
+}
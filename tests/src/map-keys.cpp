@@ -0,0 +1,209 @@
+#include "common.hpp"
+
+#include <gtest/gtest.h>
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <cstdint>
+#include <map>
+#include <pajlada/serialize.hpp>
+#include <pajlada/serialize/containers.hpp>
+#include <pajlada/serialize/parallel.hpp>
+#include <pajlada/serialize/patch.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace pajlada;
+using namespace test;
+
+namespace {
+
+enum class Color : uint8_t {
+    Red = 1,
+    Green = 2,
+    Blue = 200,
+};
+
+enum Weekday {
+    Monday = -1,
+    Tuesday,
+};
+
+enum class Switch : bool {
+    Off,
+    On,
+};
+
+// Like bool, enums based on it aren't numbers
+static_assert(detail::IsNumberKey<Weekday>);
+static_assert(!detail::IsNumberKey<bool>);
+static_assert(!detail::IsNumberKey<Switch>);
+static_assert(!detail::IsMapKey<Switch>);
+
+// Checks that value is written as json through both Serialize and
+// SerializeTo, and read back the same through DOM and SAX
+template <typename Type>
+void
+RoundTrip(const Type &value, const char *json)
+{
+    EXPECT_EQ(Write(value), json);
+    EXPECT_EQ(Stringify(value), json);
+
+    bool error = false;
+    EXPECT_EQ(Parse<Type>(json, error), value) << json;
+    EXPECT_EQ(ParseStream<Type>(json, error), value) << json;
+    EXPECT_FALSE(error) << json;
+}
+
+}  // namespace
+
+TEST(MapKeys, Integers)
+{
+    RoundTrip(std::map<uint64_t, std::string>{{1, "a"},
+                                              {18446744073709551615U, "b"}},
+              R"({"1":"a","18446744073709551615":"b"})");
+    RoundTrip(std::map<int, std::vector<int>>{{-5, {1}}, {0, {}}, {3, {2}}},
+              R"({"-5":[1],"0":[],"3":[2]})");
+    RoundTrip(std::map<int64_t, int>{{-9223372036854775807 - 1, 1}},
+              R"({"-9223372036854775808":1})");
+    RoundTrip(std::map<short, int>{}, "{}");
+}
+
+TEST(MapKeys, Enums)
+{
+    RoundTrip(std::map<Color, int>{{Color::Red, 1}, {Color::Blue, 2}},
+              R"({"1":1,"200":2})");
+    RoundTrip(std::map<Weekday, bool>{{Monday, true}, {Tuesday, false}},
+              R"({"-1":true,"0":false})");
+}
+
+TEST(MapKeys, InvalidKeys)
+{
+    using Map = std::map<uint8_t, int>;
+
+    // Names that aren't all digits, or that don't fit in the key, are
+    // reported and their members skipped
+    const char *json =
+        R"({"1": 1, "x": 2, "300": 3, "-1": 4, "1.5": 5, "": 6, " 7": 7,
+            "8 ": 8, "2": 9})";
+
+    bool error = false;
+    EXPECT_EQ(Parse<Map>(json, error), (Map{{1, 1}, {2, 9}}));
+    EXPECT_TRUE(error);
+
+    error = false;
+    EXPECT_EQ(ParseStream<Map>(json, error), (Map{{1, 1}, {2, 9}}));
+    EXPECT_TRUE(error);
+
+    using Colors = std::map<Color, int>;
+
+    error = false;
+    EXPECT_EQ(Parse<Colors>(R"({"2": 1, "256": 2})", error),
+              (Colors{{Color::Green, 1}}));
+    EXPECT_TRUE(error);
+}
+
+TEST(MapKeys, Duplicates)
+{
+    using Map = std::map<int, int>;
+
+    // Keys are compared as numbers, so "01" is the same key as "1"
+    const char *json = R"({"1": 1, "01": 2, "2": 3})";
+
+    bool error = false;
+    EXPECT_EQ(Parse<Map>(json, error), (Map{{1, 1}, {2, 3}}));
+    EXPECT_EQ(ParseStream<Map>(json, error), (Map{{1, 1}, {2, 3}}));
+    EXPECT_FALSE(error);
+}
+
+TEST(MapKeys, Into)
+{
+    using Map = std::map<int, std::vector<int>>;
+
+    Map map{{1, {1, 2, 3}}, {2, {4}}};
+    const auto *keptData = map[1].data();
+
+    rapidjson::Document d;
+    d.Parse(R"({"1": [5, 6], "x": [], "3": [7]})");
+
+    bool error = false;
+    Deserialize<Map>::into(map, d, &error);
+    EXPECT_TRUE(error);
+    EXPECT_EQ(map, (Map{{1, {5, 6}}, {3, {7}}}));
+    EXPECT_EQ(map[1].data(), keptData);
+}
+
+TEST(MapKeys, Parallel)
+{
+    using Map = std::map<uint32_t, int>;
+
+    Map map;
+    for (uint32_t i = 0; i < 5000; ++i) {
+        map[i * 7] = static_cast<int>(i);
+    }
+
+    ThreadPool pool(4);
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    EXPECT_TRUE(SerializeTo<Map>::writeParallel(map, writer, pool));
+    EXPECT_EQ(buffer.GetString(), Write(map));
+
+    rapidjson::Document d;
+    d.Parse(buffer.GetString());
+    bool error = false;
+    EXPECT_EQ(Deserialize<Map>::getParallel(d, pool, &error), map);
+    EXPECT_FALSE(error);
+
+    d.AddMember("x", 1, d.GetAllocator());
+    Deserialize<Map>::getParallel(d, pool, &error);
+    EXPECT_TRUE(error);
+}
+
+TEST(MapKeys, UnorderedMap)
+{
+    using Map = std::unordered_map<Color, std::string>;
+
+    RoundTrip(Map{{Color::Blue, "b"}}, R"({"200":"b"})");
+
+    bool error = false;
+    const char *json = R"({"1": "r", "2": "g", "red": "x"})";
+    EXPECT_EQ(Parse<Map>(json, error),
+              (Map{{Color::Red, "r"}, {Color::Green, "g"}}));
+    EXPECT_TRUE(error);
+
+    error = false;
+    EXPECT_EQ(ParseStream<Map>(json, error),
+              (Map{{Color::Red, "r"}, {Color::Green, "g"}}));
+    EXPECT_TRUE(error);
+}
+
+TEST(MapKeys, Patch)
+{
+    using Map = std::map<int, int>;
+
+    Map from{{1, 1}, {2, 2}, {-3, 3}};
+    Map to{{1, 5}, {-3, 3}, {4, 4}};
+
+    auto patch = Diff(from, to);
+
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    patch.Accept(writer);
+    EXPECT_EQ(std::string(buffer.GetString()),
+              R"([{"op":"replace","path":"/1","value":5},)"
+              R"({"op":"remove","path":"/2"},)"
+              R"({"op":"add","path":"/4","value":4}])");
+
+    bool error = false;
+    ApplyPatch(from, patch, &error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(from, to);
+
+    rapidjson::Document bad;
+    bad.Parse(R"([{"op": "add", "path": "/x", "value": 1}])");
+    ApplyPatch(from, bad, &error);
+    EXPECT_TRUE(error);
+    EXPECT_EQ(from, to);
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <pajlada/serialize/fields.hpp>
+#include <pajlada/serialize/ndjson.hpp>
+#include <ranges>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace pajlada;
+
+namespace {
+
+struct Event {
+    std::string name;
+    int count = 0;
+    std::optional<std::string> note;
+
+    bool operator==(const Event &other) const = default;
+};
+
+}  // namespace
+
+PAJLADA_SERIALIZE_FIELDS(Event, name, count, note);
+
+static_assert(std::ranges::input_range<ndjson::Reader<Event>>);
+
+TEST(NDJSON, RoundTrip)
+{
+    std::vector<Event> events{
+        {"start", 1, std::nullopt},
+        {"multi\nline", 2, "with a \"note\""},
+        {"", 0, ""},
+    };
+
+    std::stringstream stream;
+    ndjson::Writer<Event> writer(stream);
+    for (const auto &event : events) {
+        EXPECT_TRUE(writer.write(event));
+    }
+    EXPECT_EQ(writer.count(), events.size());
+
+    auto text = stream.str();
+    EXPECT_EQ(static_cast<size_t>(std::count(text.begin(), text.end(), '\n')),
+              events.size());
+
+    bool error = false;
+    ndjson::Reader<Event> reader(stream, &error);
+    std::vector<Event> out;
+    for (const auto &event : reader) {
+        out.push_back(event);
+    }
+
+    EXPECT_FALSE(error);
+    EXPECT_EQ(out, events);
+}
+
+TEST(NDJSON, SkipsBlankAndInvalidLines)
+{
+    std::istringstream stream(
+        "{\"name\": \"a\", \"count\": 1}\r\n"
+        "\n"
+        "   \r\n"
+        "{\"name\": \"b\", \"count\": \n"
+        "[1, 2, 3]\n"
+        "{\"name\": \"c\", \"count\": 3}");
+
+    bool error = false;
+    ndjson::Reader<Event> reader(stream, &error);
+
+    ASSERT_TRUE(reader.next());
+    EXPECT_EQ(reader.current().name, "a");
+    EXPECT_EQ(reader.lineNumber(), 1);
+
+    ASSERT_TRUE(reader.next());
+    EXPECT_EQ(reader.current().name, "c");
+    EXPECT_EQ(reader.current().count, 3);
+    EXPECT_EQ(reader.lineNumber(), 6);
+
+    EXPECT_FALSE(reader.next());
+    EXPECT_TRUE(error);
+    EXPECT_EQ(reader.skipped(), 2);
+}
+
+TEST(NDJSON, MembersDontCarryOver)
+{
+    std::istringstream stream(
+        "{\"name\": \"a\", \"count\": 1, \"note\": \"x\"}\n"
+        "{\"name\": \"b\"}\n");
+
+    ndjson::Reader<Event> reader(stream);
+    ASSERT_TRUE(reader.next());
+    EXPECT_EQ(reader.current().note, "x");
+    ASSERT_TRUE(reader.next());
+    EXPECT_EQ(reader.current(), (Event{"b", 0, std::nullopt}));
+}
+
+TEST(NDJSON, Views)
+{
+    std::stringstream stream;
+    ndjson::Writer<std::map<std::string, int>> writer(stream);
+    for (int i = 0; i < 10; ++i) {
+        writer.write({{"i", i}});
+    }
+
+    ndjson::Reader<std::map<std::string, int>> reader(stream);
+    std::vector<int> odd;
+    for (const auto &record :
+         reader | std::views::filter([](const auto &record) {
+             return record.at("i") % 2 == 1;
+         }) | std::views::take(3)) {
+        odd.push_back(record.at("i"));
+    }
+
+    EXPECT_EQ(odd, (std::vector<int>{1, 3, 5}));
+}
@@ -0,0 +1,213 @@
+#include "common.hpp"
+
+#include <gtest/gtest.h>
+#include <rapidjson/document.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <pajlada/serialize.hpp>
+#include <string>
+#include <vector>
+
+using namespace pajlada;
+using namespace test;
+
+namespace {
+
+// What the writer makes of the numbers one by one
+template <typename Type>
+std::string
+WriteEach(const std::vector<Type> &value)
+{
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    writer.StartArray();
+    for (auto number : value) {
+        SerializeTo<Type>::write(number, writer);
+    }
+    writer.EndArray(static_cast<rapidjson::SizeType>(value.size()));
+    return {buffer.GetString(), buffer.GetSize()};
+}
+
+}  // namespace
+
+TEST(Numbers, WriteIntegers)
+{
+    EXPECT_EQ(Write(std::vector<int>{}), "[]");
+    EXPECT_EQ(Write(std::vector<int>{-1, 0, 1}), "[-1,0,1]");
+    EXPECT_EQ(Write(std::array<uint8_t, 3>{0, 128, 255}), "[0,128,255]");
+
+    using Limits = std::numeric_limits<int64_t>;
+    std::vector<int64_t> extremes{Limits::min(), Limits::max(), 0};
+    EXPECT_EQ(Write(extremes),
+              "[-9223372036854775808,9223372036854775807,0]");
+
+    // Spans several buffers
+    std::vector<int64_t> large(5000);
+    for (size_t i = 0; i < large.size(); ++i) {
+        large[i] = (i % 2 == 0 ? Limits::min() : Limits::max()) /
+                   static_cast<int64_t>(i + 1);
+    }
+    EXPECT_EQ(Write(large), WriteEach(large));
+
+    std::vector<uint64_t> unsignedLarge(3000,
+                                        std::numeric_limits<uint64_t>::max());
+    EXPECT_EQ(Write(unsignedLarge), WriteEach(unsignedLarge));
+}
+
+TEST(Numbers, WriteIntegersNested)
+{
+    std::vector<std::vector<int>> nested{{1, 2}, {}, {3}};
+    EXPECT_EQ(Write(nested), "[[1,2],[],[3]]");
+
+    std::map<std::string, std::array<short, 2>> map{{"a", {-5, 5}}};
+    EXPECT_EQ(Write(map), R"({"a":[-5,5]})");
+}
+
+TEST(Numbers, PrettyWriterIsNotAffected)
+{
+    std::vector<int> value{1, 2};
+
+    rapidjson::StringBuffer buffer;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+    EXPECT_TRUE(SerializeTo<std::vector<int>>::write(value, writer));
+    EXPECT_EQ(std::string(buffer.GetString()), "[\n    1,\n    2\n]");
+}
+
+TEST(Numbers, ReadIntegers)
+{
+    bool error = false;
+    EXPECT_EQ(Parse<std::vector<int>>("[1, -2, 3.6, 4.4]", error),
+              (std::vector<int>{1, -2, 4, 4}));
+    EXPECT_FALSE(error);
+
+    EXPECT_EQ(Parse<std::vector<uint8_t>>("[255, 1]", error),
+              (std::vector<uint8_t>{255, 1}));
+    EXPECT_FALSE(error);
+
+    auto array = Parse<std::array<int64_t, 2>>("[-7, 8.5]", error);
+    EXPECT_EQ(array, (std::array<int64_t, 2>{-7, 9}));
+    EXPECT_FALSE(error);
+
+    EXPECT_EQ(Parse<std::vector<int>>(R"([1, "2", 3])", error),
+              (std::vector<int>{1, 0, 3}));
+    EXPECT_TRUE(error);
+}
+
+TEST(Numbers, ReadFloatingPoint)
+{
+    bool error = false;
+    EXPECT_EQ(Parse<std::vector<double>>("[1, 2.5, -1e300]", error),
+              (std::vector<double>{1, 2.5, -1e300}));
+    EXPECT_FALSE(error);
+
+    auto floats = Parse<std::vector<float>>("[0.1, null, 3]", error);
+    EXPECT_FALSE(error);
+    ASSERT_EQ(floats.size(), 3);
+    EXPECT_EQ(floats[0], 0.1F);
+    EXPECT_TRUE(std::isnan(floats[1]));
+    EXPECT_EQ(floats[2], 3.0F);
+
+    Parse<std::vector<double>>("[1, true]", error);
+    EXPECT_TRUE(error);
+}
+
+TEST(Numbers, ReadStream)
+{
+    bool error = false;
+    const char *json = "[1, -2, 3.6, 3000000000, -3000000000]";
+    EXPECT_EQ(ParseStream<std::vector<int64_t>>(json, error),
+              Parse<std::vector<int64_t>>(json, error));
+    EXPECT_FALSE(error);
+
+    EXPECT_EQ(ParseStream<std::vector<uint32_t>>("[0, 4294967295]", error),
+              (std::vector<uint32_t>{0, 4294967295U}));
+    EXPECT_FALSE(error);
+
+    EXPECT_EQ(ParseStream<std::vector<int>>(json, error),
+              (std::vector<int>{1, -2, 4, 0, 0}));
+    EXPECT_TRUE(error);
+
+    error = false;
+    EXPECT_EQ((ParseStream<std::array<double, 3>>("[1, 2.5, 4e10]", error)),
+              (std::array<double, 3>{1, 2.5, 4e10}));
+    EXPECT_FALSE(error);
+
+    auto floats = ParseStream<std::vector<float>>("[0.1, null]", error);
+    EXPECT_FALSE(error);
+    ASSERT_EQ(floats.size(), 2);
+    EXPECT_EQ(floats[0], 0.1F);
+    EXPECT_TRUE(std::isnan(floats[1]));
+
+    ParseStream<std::vector<int>>(R"([1, "2"])", error);
+    EXPECT_TRUE(error);
+}
+
+TEST(Numbers, Integers64)
+{
+    using Int64 = std::numeric_limits<int64_t>;
+    using Uint64 = std::numeric_limits<uint64_t>;
+
+    bool error = false;
+    EXPECT_EQ(Parse<std::vector<int64_t>>(
+                  "[-9223372036854775808, 9223372036854775807, 1e18]", error),
+              (std::vector<int64_t>{Int64::min(), Int64::max(),
+                                    1000000000000000000}));
+    EXPECT_FALSE(error);
+
+    EXPECT_EQ(Parse<uint64_t>("18446744073709551615", error), Uint64::max());
+    EXPECT_EQ(Parse<uint32_t>("4294967295", error), 4294967295U);
+    EXPECT_EQ(Parse<unsigned>("3000000000", error), 3000000000U);
+    EXPECT_EQ(Parse<int64_t>("-3000000000", error), -3000000000);
+    EXPECT_FALSE(error);
+
+    // Past what a double represents exactly, so it mustn't go through one
+    EXPECT_EQ(Parse<uint64_t>("18446744073709551557", error),
+              18446744073709551557U);
+    EXPECT_EQ(Parse<int64_t>("9007199254740993", error), 9007199254740993);
+    EXPECT_FALSE(error);
+}
+
+TEST(Numbers, IntegerRange)
+{
+    auto check = [](auto expected, const char *json, bool expectError) {
+        using Type = decltype(expected);
+
+        bool error = false;
+        EXPECT_EQ(Parse<Type>(json, error), expected) << json;
+        EXPECT_EQ(error, expectError) << json;
+
+        error = false;
+        EXPECT_EQ(ParseStream<std::vector<Type>>(
+                      ("[" + std::string(json) + "]").c_str(), error),
+                  std::vector<Type>{expected})
+            << json;
+        EXPECT_EQ(error, expectError) << json;
+    };
+
+    check(uint8_t(255), "255", false);
+    check(uint8_t(0), "256", true);
+    check(int8_t(-128), "-128", false);
+    check(int8_t(0), "-129", true);
+    check(uint16_t(0), "-1", true);
+    check(uint64_t(0), "-1", true);
+    check(int(0), "2147483648", true);
+    check(int64_t(0), "9223372036854775808", true);
+    check(char(0), "300", true);
+    check(char(65), "65", false);
+
+    // Doubles are rounded, then range checked
+    check(uint8_t(255), "254.6", false);
+    check(uint8_t(0), "255.6", true);
+    check(uint8_t(0), "-0.4", false);
+    check(int64_t(0), "1e19", true);
+    check(uint64_t(0), "1e20", true);
+    check(int64_t(-9223372036854775807 - 1), "-9223372036854775808.0", false);
+    check(int(0), "1e300", true);
+}
@@ -0,0 +1,267 @@
+#include <gtest/gtest.h>
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <atomic>
+#include <map>
+#include <pajlada/serialize.hpp>
+#include <pajlada/serialize/parallel.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace pajlada;
+
+namespace {
+
+// Runs every task on the calling thread, in reverse to make sure nothing
+// depends on the order chunks are decoded in
+class ReverseExecutor
+{
+public:
+    size_t
+    concurrency() const
+    {
+        return 4;
+    }
+
+    template <typename Task>
+    void
+    run(size_t count, Task &&task)
+    {
+        ++this->runs;
+        for (size_t i = count; i > 0; --i) {
+            task(i - 1);
+        }
+    }
+
+    int runs = 0;
+};
+
+rapidjson::Document
+MakeArray(size_t size)
+{
+    rapidjson::Document d;
+    d.SetArray();
+    for (size_t i = 0; i < size; ++i) {
+        d.PushBack(static_cast<int>(i), d.GetAllocator());
+    }
+    return d;
+}
+
+rapidjson::Document
+MakeObject(size_t size)
+{
+    rapidjson::Document d;
+    d.SetObject();
+    for (size_t i = 0; i < size; ++i) {
+        rapidjson::Value key("key" + std::to_string(i), d.GetAllocator());
+        rapidjson::Value value(static_cast<int>(i));
+        d.AddMember(key, value, d.GetAllocator());
+    }
+    return d;
+}
+
+// Returns what SerializeTo<Type>::write and writeParallel wrote
+template <typename Type, typename Executor>
+std::pair<std::string, std::string>
+WriteBoth(const Type &value, Executor &executor)
+{
+    rapidjson::StringBuffer serial;
+    rapidjson::Writer<rapidjson::StringBuffer> serialWriter(serial);
+    EXPECT_TRUE(SerializeTo<Type>::write(value, serialWriter));
+
+    rapidjson::StringBuffer parallel;
+    rapidjson::Writer<rapidjson::StringBuffer> parallelWriter(parallel);
+    EXPECT_TRUE(
+        SerializeTo<Type>::writeParallel(value, parallelWriter, executor));
+
+    return {{serial.GetString(), serial.GetSize()},
+            {parallel.GetString(), parallel.GetSize()}};
+}
+
+std::vector<std::map<std::string, std::vector<int>>>
+MakeRecords(size_t size)
+{
+    std::vector<std::map<std::string, std::vector<int>>> ret(size);
+    for (size_t i = 0; i < size; ++i) {
+        auto n = static_cast<int>(i);
+        ret[i]["id"] = {n};
+        ret[i]["values"] = {n % 7, n % 11, -n};
+    }
+    return ret;
+}
+
+}  // namespace
+
+TEST(ThreadPool, RunsEveryTaskOnce)
+{
+    for (size_t threads : {1, 2, 8}) {
+        ThreadPool pool(threads);
+        EXPECT_EQ(pool.concurrency(), threads);
+
+        for (size_t count : {0, 1, 7, 1000}) {
+            std::vector<std::atomic<int>> calls(count);
+            pool.run(count, [&](size_t i) {
+                ++calls[i];
+            });
+
+            for (size_t i = 0; i < count; ++i) {
+                EXPECT_EQ(calls[i], 1) << threads << " " << count << " " << i;
+            }
+        }
+    }
+}
+
+TEST(Parallel, Vector)
+{
+    auto d = MakeArray(100000);
+
+    ThreadPool pool(4);
+    bool error = false;
+    auto v = Deserialize<std::vector<int>>::getParallel(d, pool, &error);
+
+    EXPECT_FALSE(error);
+    EXPECT_EQ(v, Deserialize<std::vector<int>>::get(d));
+}
+
+TEST(Parallel, VectorChunks)
+{
+    auto d = MakeArray(10 * detail::ParallelMinChunkSize + 3);
+
+    ReverseExecutor executor;
+    bool error = false;
+    auto v =
+        Deserialize<std::vector<double>>::getParallel(d, executor, &error);
+
+    EXPECT_EQ(executor.runs, 1);
+    EXPECT_FALSE(error);
+    ASSERT_EQ(v.size(), d.Size());
+    for (size_t i = 0; i < v.size(); ++i) {
+        EXPECT_EQ(v[i], static_cast<double>(i));
+    }
+}
+
+TEST(Parallel, SmallVectorIsDecodedSerially)
+{
+    auto d = MakeArray(10);
+
+    ReverseExecutor executor;
+    auto v = Deserialize<std::vector<int>>::getParallel(d, executor);
+
+    EXPECT_EQ(executor.runs, 0);
+    EXPECT_EQ(v, Deserialize<std::vector<int>>::get(d));
+}
+
+TEST(Parallel, VectorErrors)
+{
+    auto d = MakeArray(50000);
+    d[40000].SetString("x");
+
+    ThreadPool pool(4);
+    bool error = false;
+    Deserialize<std::vector<int>>::getParallel(d, pool, &error);
+    EXPECT_TRUE(error);
+
+    error = false;
+    Deserialize<std::vector<int>>::getParallel(rapidjson::Value(5), pool,
+                                              &error);
+    EXPECT_TRUE(error);
+}
+
+TEST(Parallel, Map)
+{
+    auto d = MakeObject(20000);
+
+    ThreadPool pool(4);
+    bool error = false;
+    auto m = Deserialize<std::map<std::string, int>>::getParallel(d, pool,
+                                                                 &error);
+
+    EXPECT_FALSE(error);
+    EXPECT_EQ(m, (Deserialize<std::map<std::string, int>>::get(d)));
+
+    auto views = Deserialize<std::map<std::string_view, int>>::getParallel(
+        d, pool, &error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(views.size(), m.size());
+    EXPECT_EQ(views["key123"], 123);
+}
+
+TEST(Parallel, MapDuplicatesAcrossChunks)
+{
+    auto d = MakeObject(10 * detail::ParallelMinChunkSize);
+    // Lands in the last chunk, the first one still has to win
+    rapidjson::Value value(-1);
+    d.AddMember("key0", value, d.GetAllocator());
+
+    ReverseExecutor executor;
+    bool error = false;
+    auto m = Deserialize<std::map<std::string, int>>::getParallel(d, executor,
+                                                                 &error);
+
+    EXPECT_FALSE(error);
+    EXPECT_EQ(m.size(), 10 * detail::ParallelMinChunkSize);
+    EXPECT_EQ(m["key0"], 0);
+}
+
+TEST(Parallel, MapErrors)
+{
+    auto d = MakeObject(20000);
+    d["key15000"].SetString("x");
+
+    ThreadPool pool(4);
+    bool error = false;
+    Deserialize<std::map<std::string, int>>::getParallel(d, pool, &error);
+    EXPECT_TRUE(error);
+}
+
+TEST(Parallel, WriteVector)
+{
+    ThreadPool pool(4);
+
+    auto [serial, parallel] = WriteBoth(MakeRecords(20000), pool);
+    EXPECT_EQ(parallel, serial);
+
+    ReverseExecutor executor;
+    std::vector<bool> flags(5000);
+    for (size_t i = 0; i < flags.size(); i += 3) {
+        flags[i] = true;
+    }
+    auto [serialFlags, parallelFlags] = WriteBoth(flags, executor);
+    EXPECT_EQ(executor.runs, 1);
+    EXPECT_EQ(parallelFlags, serialFlags);
+
+    std::vector<std::string> strings(5000, "forsen");
+    strings[1234] = "";
+    auto [serialStrings, parallelStrings] = WriteBoth(strings, executor);
+    EXPECT_EQ(executor.runs, 2);
+    EXPECT_EQ(parallelStrings, serialStrings);
+
+    auto [serialSmall, parallelSmall] =
+        WriteBoth(std::vector<int>{1, 2, 3}, executor);
+    EXPECT_EQ(executor.runs, 2);
+    EXPECT_EQ(parallelSmall, serialSmall);
+}
+
+TEST(Parallel, WriteMap)
+{
+    std::map<std::string, std::string> m;
+    for (int i = 0; i < 20000; ++i) {
+        m["key\"" + std::to_string(i)] = std::to_string(i * 3);
+    }
+    m[""] = "empty key";
+
+    std::map<std::string_view, double> views;
+    for (const auto &[key, value] : m) {
+        views[key] = static_cast<double>(value.size()) + 0.5;
+    }
+
+    ThreadPool pool(4);
+    auto [serial, parallel] = WriteBoth(m, pool);
+    EXPECT_EQ(parallel, serial);
+
+    auto [serialViews, parallelViews] = WriteBoth(views, pool);
+    EXPECT_EQ(parallelViews, serialViews);
+}
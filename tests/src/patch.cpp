@@ -0,0 +1,282 @@
+#include "common.hpp"
+
+#include <gtest/gtest.h>
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <any>
+#include <array>
+#include <map>
+#include <optional>
+#include <pajlada/serialize.hpp>
+#include <pajlada/serialize/patch.hpp>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+using namespace pajlada;
+using namespace test;
+
+namespace {
+
+struct Circle {
+    int radius = 0;
+
+    bool operator==(const Circle &other) const = default;
+};
+
+struct Square {
+    int side = 0;
+
+    bool operator==(const Square &other) const = default;
+};
+
+using Shape = std::variant<Circle, Square>;
+
+struct Channel {
+    std::string name;
+    std::vector<std::string> highlights;
+    std::optional<int> volume;
+    std::pair<int, bool> position{0, false};
+    std::array<double, 2> color{0.0, 0.0};
+    std::variant<int, std::string> tag;
+    Shape shape;
+
+    bool operator==(const Channel &other) const = default;
+};
+
+using Settings = std::map<std::string, Channel>;
+
+}  // namespace
+
+namespace pajlada {
+
+template <>
+struct VariantTag<Shape> {
+    static constexpr bool enabled = true;
+    static constexpr std::array<std::string_view, 2> names{
+        "circle",
+        "square",
+    };
+};
+
+}  // namespace pajlada
+
+PAJLADA_SERIALIZE_FIELDS(Circle, radius);
+PAJLADA_SERIALIZE_FIELDS(Square, side);
+PAJLADA_SERIALIZE_FIELDS(Channel, name, highlights, volume, position, color,
+                         tag, shape);
+
+namespace {
+
+Settings
+MakeSettings()
+{
+    Settings settings;
+
+    auto &forsen = settings["forsen"];
+    forsen.name = "forsen";
+    forsen.highlights = {"forsen", "bajs"};
+    forsen.volume = 50;
+    forsen.shape = Circle{2};
+
+    auto &pajlada = settings["pajlada"];
+    pajlada.name = "pajlada";
+    pajlada.tag = "admin";
+
+    return settings;
+}
+
+// Diffs from and to, and checks that the patch turns from into to
+template <typename Type>
+std::string
+RoundTrip(const Type &from, const Type &to)
+{
+    auto patch = Diff(from, to);
+
+    auto copy = from;
+    bool error = false;
+    ApplyPatch(copy, patch, &error);
+    EXPECT_FALSE(error);
+    EXPECT_TRUE(copy == to);
+
+    return Print(patch);
+}
+
+}  // namespace
+
+TEST(Patch, EqualValues)
+{
+    auto settings = MakeSettings();
+    EXPECT_EQ(RoundTrip(settings, settings), "[]");
+}
+
+TEST(Patch, Map)
+{
+    auto from = MakeSettings();
+    auto to = from;
+    to.erase("pajlada");
+    to["a/b~c"].name = "escaped";
+    to["forsen"].name = "forsen2";
+
+    EXPECT_EQ(
+        RoundTrip(from, to),
+        R"([{"op":"add","path":"/a~1b~0c","value":{"name":"escaped",)"
+        R"("highlights":[],"volume":null,"position":[0,false],)"
+        R"("color":[0.0,0.0],"tag":0,)"
+        R"("shape":{"type":"circle","value":{"radius":0}}}},)"
+        R"({"op":"replace","path":"/forsen/name","value":"forsen2"},)"
+        R"({"op":"remove","path":"/pajlada"}])");
+}
+
+TEST(Patch, Vector)
+{
+    std::vector<int> from{1, 2, 3, 4};
+
+    EXPECT_EQ(RoundTrip(from, {1, 5}),
+              R"([{"op":"replace","path":"/1","value":5},)"
+              R"({"op":"remove","path":"/3"},{"op":"remove","path":"/2"}])");
+    EXPECT_EQ(RoundTrip(from, {1, 2, 3, 4, 5, 6}),
+              R"([{"op":"add","path":"/4","value":5},)"
+              R"({"op":"add","path":"/5","value":6}])");
+    EXPECT_EQ(RoundTrip(std::vector<bool>{true, false},
+                        std::vector<bool>{true, true, false}),
+              R"([{"op":"replace","path":"/1","value":true},)"
+              R"({"op":"add","path":"/2","value":false}])");
+}
+
+TEST(Patch, NestedTypes)
+{
+    auto from = MakeSettings();
+    auto to = from;
+
+    auto &forsen = to["forsen"];
+    forsen.highlights[1] = "xD";
+    forsen.volume.reset();
+    forsen.position.second = true;
+    forsen.color[1] = 0.5;
+    forsen.shape = Circle{3};
+
+    auto &pajlada = to["pajlada"];
+    pajlada.volume = 10;
+    pajlada.tag = "mod";
+
+    EXPECT_EQ(
+        RoundTrip(from, to),
+        R"([{"op":"replace","path":"/forsen/highlights/1","value":"xD"},)"
+        R"({"op":"replace","path":"/forsen/volume","value":null},)"
+        R"({"op":"replace","path":"/forsen/position/1","value":true},)"
+        R"({"op":"replace","path":"/forsen/color/1","value":0.5},)"
+        R"({"op":"replace","path":"/forsen/shape/value/radius","value":3},)"
+        R"({"op":"replace","path":"/pajlada/volume","value":10},)"
+        R"({"op":"replace","path":"/pajlada/tag","value":"mod"}])");
+
+    // Switching alternatives replaces the whole variant
+    to["pajlada"].tag = 5;
+    to["forsen"].shape = Square{1};
+    auto patch = RoundTrip(from, to);
+    EXPECT_NE(patch.find(R"({"op":"replace","path":"/forsen/shape",)"
+                         R"("value":{"type":"square","value":{"side":1}}})"),
+              std::string::npos);
+    EXPECT_NE(patch.find(R"({"op":"replace","path":"/pajlada/tag",)"
+                         R"("value":5})"),
+              std::string::npos);
+}
+
+TEST(Patch, Any)
+{
+    std::any from = 5;
+    std::any to = std::string("forsen");
+
+    auto patch = Diff(from, to);
+    EXPECT_EQ(Print(patch),
+              R"([{"op":"replace","path":"","value":"forsen"}])");
+    EXPECT_EQ(Print(Diff(from, std::any(5))), "[]");
+
+    bool error = false;
+    ApplyPatch(from, patch, &error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(std::any_cast<std::string>(from), "forsen");
+}
+
+TEST(Patch, Tracked)
+{
+    std::map<std::string, Tracked<std::vector<int>>> from;
+    from["a"].set({1, 2});
+    from["b"].set({3});
+
+    auto to = from;
+    to["b"].mutate().push_back(4);
+
+    EXPECT_EQ(Print(Diff(from, to)),
+              R"([{"op":"add","path":"/b/1","value":4}])");
+
+    ApplyPatch(from, Diff(from, to));
+    EXPECT_TRUE(from["b"].dirty());
+    EXPECT_EQ(from["b"].get(), (std::vector<int>{3, 4}));
+}
+
+TEST(Patch, Operations)
+{
+    auto settings = MakeSettings();
+
+    auto patch = ParseDocument(R"([
+        {"op": "test", "path": "/forsen/volume", "value": 50},
+        {"op": "add", "path": "/forsen/highlights/0", "value": "first"},
+        {"op": "add", "path": "/forsen/highlights/-", "value": "last"},
+        {"op": "copy", "from": "/forsen", "path": "/copy"},
+        {"op": "copy", "from": "/pajlada/tag", "path": "/copy/tag"},
+        {"op": "move", "from": "/copy/highlights/3", "path": "/copy/name"},
+        {"op": "remove", "path": "/forsen/highlights/1"},
+        {"op": "replace", "path": "/forsen/shape",
+         "value": {"type": "square", "value": {"side": 4}}},
+        {"op": "add", "path": "/forsen/shape/value/side", "value": 5}
+    ])");
+
+    bool error = false;
+    ApplyPatch(settings, patch, &error);
+    EXPECT_FALSE(error);
+
+    const auto &forsen = settings["forsen"];
+    EXPECT_EQ(forsen.highlights,
+              (std::vector<std::string>{"first", "bajs", "last"}));
+    EXPECT_EQ(forsen.shape, Shape(Square{5}));
+
+    const auto &copy = settings["copy"];
+    EXPECT_EQ(copy.name, "last");
+    EXPECT_EQ(copy.highlights,
+              (std::vector<std::string>{"first", "forsen", "bajs"}));
+    EXPECT_EQ(copy.volume, 50);
+    EXPECT_EQ(copy.tag, (std::variant<int, std::string>("admin")));
+}
+
+TEST(Patch, Errors)
+{
+    auto check = [](const char *json) {
+        auto settings = MakeSettings();
+        bool error = false;
+        ApplyPatch(settings, ParseDocument(json), &error);
+        EXPECT_TRUE(error) << json;
+    };
+
+    check(R"({})");
+    check(R"([{"op": "add", "path": "/x"}])");
+    check(R"([{"op": "jump", "path": "/forsen"}])");
+    check(R"([{"op": "remove", "path": "forsen"}])");
+    check(R"([{"op": "remove", "path": "/nobody"}])");
+    check(R"([{"op": "remove", "path": "/forsen/name"}])");
+    check(R"([{"op": "replace", "path": "/nobody", "value": {}}])");
+    check(R"([{"op": "replace", "path": "/forsen/nothing", "value": 1}])");
+    check(R"([{"op": "replace", "path": "/forsen/name", "value": 1}])");
+    check(R"([{"op": "test", "path": "/forsen/volume", "value": 51}])");
+    check(R"([{"op": "add", "path": "/forsen/highlights/3", "value": ""}])");
+    check(R"([{"op": "add", "path": "/forsen/highlights/01", "value": ""}])");
+    check(R"([{"op": "add", "path": "/forsen/color/2", "value": 1}])");
+    check(R"([{"op": "replace", "path": "/forsen/shape/type", "value": 1}])");
+    check(R"([{"op": "replace", "path": "/pajlada/volume/x", "value": 1}])");
+    check(R"([{"op": "move", "from": "/forsen", "path": "/forsen/name"}])");
+    check(R"([{"op": "copy", "from": "/nobody", "path": "/x"}])");
+    check(R"([{"op": "remove", "path": "/forsen/x~2"}])");
+}
@@ -0,0 +1,155 @@
+#include "common.hpp"
+
+#include <gtest/gtest.h>
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <any>
+#include <array>
+#include <map>
+#include <optional>
+#include <pajlada/serialize.hpp>
+#include <string>
+#include <variant>
+#include <vector>
+
+using namespace pajlada;
+using namespace test;
+
+namespace {
+
+template <typename Type>
+void
+ExpectSameOutput(const Type &value)
+{
+    EXPECT_EQ(Stringify(value), Write(value));
+}
+
+struct Point {
+    int x;
+    int y;
+};
+
+}  // namespace
+
+namespace pajlada {
+
+template <typename RJValue>
+struct Serialize<Point, RJValue> {
+    static RJValue
+    get(const Point &value, typename RJValue::AllocatorType &a)
+    {
+        RJValue ret(rapidjson::kObjectType);
+
+        detail::AddMember<int, RJValue>(ret, "x", value.x, a);
+        detail::AddMember<int, RJValue>(ret, "y", value.y, a);
+
+        return ret;
+    }
+};
+
+}  // namespace pajlada
+
+TEST(SerializeTo, Scalars)
+{
+    ExpectSameOutput(5);
+    ExpectSameOutput(-5);
+    ExpectSameOutput(5U);
+    ExpectSameOutput(int64_t{-9000000000});
+    ExpectSameOutput(uint64_t{18000000000000000000ULL});
+    ExpectSameOutput(true);
+    ExpectSameOutput(false);
+    ExpectSameOutput(3.7);
+    ExpectSameOutput(3.5f);
+
+    EXPECT_EQ(Write(std::numeric_limits<double>::quiet_NaN()), "null");
+    EXPECT_EQ(Write(std::numeric_limits<float>::infinity()), "null");
+}
+
+TEST(SerializeTo, Strings)
+{
+    ExpectSameOutput(std::string("forsen"));
+    ExpectSameOutput(std::string(""));
+    ExpectSameOutput(std::string("quote \" and \\ backslash"));
+    ExpectSameOutput(std::string_view("forsen"));
+    ExpectSameOutput(std::string_view{});
+    ExpectSameOutput(std::string("a\0b", 3));
+}
+
+TEST(SerializeTo, Containers)
+{
+    ExpectSameOutput(std::pair<int, std::string>{1, "a"});
+    ExpectSameOutput(std::vector<int>{1, 2, 3});
+    ExpectSameOutput(std::vector<int>{});
+    ExpectSameOutput(std::array<int, 3>{4, 5, 6});
+    ExpectSameOutput(std::map<std::string, int>{{"a", 1}, {"b", 2}});
+    ExpectSameOutput(std::map<std::string, std::vector<std::string>>{
+        {"a", {"x", "y"}},
+        {"b", {}},
+    });
+
+    // Keys are copied with their length, so nulls don't cut them short
+    std::map<std::string, int> nulls{{std::string("a\0b", 3), 1}};
+    EXPECT_EQ(Stringify(nulls), R"({"a\u0000b":1})");
+    ExpectSameOutput(nulls);
+}
+
+TEST(SerializeTo, Any)
+{
+    using AnyMap = std::map<std::string, std::any>;
+    using AnyVector = std::vector<std::any>;
+
+    AnyMap in{
+        {"a", 5},
+        {"b", "forsen"},
+        {"c", std::string("peppah")},
+        {"d", 13.37},
+        {"e", AnyVector{1, true, AnyMap{{"x", 1}}}},
+        {"f", std::vector<std::string>{"a", "b"}},
+        {"g", std::any{}},
+    };
+
+    ExpectSameOutput(in);
+}
+
+TEST(SerializeTo, VariantAndOptional)
+{
+    std::variant<std::string, int> v = "forsen";
+    ExpectSameOutput(v);
+    v = 69;
+    ExpectSameOutput(v);
+
+    std::optional<std::string> o;
+    ExpectSameOutput(o);
+    EXPECT_EQ(Write(o), "null");
+    o = "forsen";
+    ExpectSameOutput(o);
+}
+
+TEST(SerializeTo, FallbackToSerialize)
+{
+    // Point only has a Serialize specialization
+    ExpectSameOutput(Point{1, 2});
+    ExpectSameOutput(std::vector<Point>{{1, 2}, {3, 4}});
+    EXPECT_EQ(Write(Point{1, 2}), R"({"x":1,"y":2})");
+}
+
+TEST(SerializeTo, HandlerAbort)
+{
+    struct AbortingHandler
+        : rapidjson::BaseReaderHandler<rapidjson::UTF8<>, AbortingHandler> {
+        int calls = 0;
+
+        bool
+        Default()
+        {
+            return ++this->calls < 3;
+        }
+    };
+
+    AbortingHandler handler;
+    EXPECT_FALSE(
+        SerializeTo<std::vector<int>>::write({1, 2, 3, 4, 5}, handler));
+    EXPECT_EQ(handler.calls, 3);
+}
@@ -0,0 +1,268 @@
+#include <gtest/gtest.h>
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <filesystem>
+#include <mutex>
+#include <pajlada/serialize.hpp>
+#include <pajlada/serialize/fields.hpp>
+#include <pajlada/serialize/file.hpp>
+#include <pajlada/serialize/trace.hpp>
+#include <string>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+// Built into its own executable with PAJLADA_SERIALIZE_TRACE
+
+using namespace pajlada;
+
+namespace {
+
+struct Emote {
+    std::string name;
+    int width = 0;
+};
+
+struct Channel {
+    std::string name;
+    std::vector<Emote> emotes;
+};
+
+}  // namespace
+
+PAJLADA_SERIALIZE_FIELDS(Emote, name, width);
+PAJLADA_SERIALIZE_FIELDS(Channel, name, emotes);
+
+namespace {
+
+class Recorder : public TraceSink
+{
+public:
+    void
+    record(const TraceRecord &record) override
+    {
+        std::lock_guard lock(this->mutex_);
+        this->records.push_back(record);
+    }
+
+    // The records of Type, in the order they finished
+    template <typename Type>
+    std::vector<TraceRecord>
+    of() const
+    {
+        std::vector<TraceRecord> ret;
+        for (const auto &record : this->records) {
+            if (record.type == &detail::TraceTypeOf<Type>) {
+                ret.push_back(record);
+            }
+        }
+        return ret;
+    }
+
+    std::vector<TraceRecord> records;
+
+private:
+    std::mutex mutex_;
+};
+
+// Installs a Recorder for the duration of a test
+class Trace : public ::testing::Test
+{
+protected:
+    void
+    SetUp() override
+    {
+        EXPECT_EQ(SetTraceSink(&this->recorder), nullptr);
+    }
+
+    void
+    TearDown() override
+    {
+        EXPECT_EQ(SetTraceSink(nullptr), &this->recorder);
+    }
+
+    Recorder recorder;
+};
+
+const Channel Forsen{"forsen", {{"forsenE", 28}, {"forsenW", 32}}};
+const char *ForsenJson =
+    R"({"name":"forsen","emotes":[{"name":"forsenE","width":28},)"
+    R"({"name":"forsenW","width":32}]})";
+
+}  // namespace
+
+static_assert(detail::TraceEnabled);
+
+// Without tracing, the hooks take no space at all
+static_assert(std::is_empty_v<detail::TraceScope<Channel, false>>);
+
+TEST_F(Trace, Serialize)
+{
+    rapidjson::Document d;
+    Serialize<Channel>::get(Forsen, d.GetAllocator());
+
+    auto emotes = this->recorder.of<Emote>();
+    auto channels = this->recorder.of<Channel>();
+    ASSERT_EQ(emotes.size(), 2);
+    ASSERT_EQ(channels.size(), 1);
+    ASSERT_EQ(this->recorder.records.size(), 3);
+
+    EXPECT_EQ(channels[0].operation, TraceOperation::Serialize);
+    EXPECT_FALSE(channels[0].error);
+    EXPECT_NE(channels[0].type->name.find("Channel"), std::string::npos);
+
+    // Nested values are included
+    EXPECT_GT(emotes[0].bytes, 0);
+    EXPECT_GE(channels[0].bytes, emotes[0].bytes + emotes[1].bytes);
+    EXPECT_GE(channels[0].elapsed, emotes[0].elapsed + emotes[1].elapsed);
+}
+
+TEST_F(Trace, SerializeTo)
+{
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    EXPECT_TRUE(SerializeTo<Channel>::write(Forsen, writer));
+    EXPECT_EQ(std::string(buffer.GetString()), ForsenJson);
+
+    auto channels = this->recorder.of<Channel>();
+    ASSERT_EQ(channels.size(), 1);
+    EXPECT_EQ(channels[0].operation, TraceOperation::SerializeTo);
+    EXPECT_FALSE(channels[0].error);
+    EXPECT_EQ(this->recorder.of<Emote>().size(), 2);
+}
+
+TEST_F(Trace, Deserialize)
+{
+    rapidjson::Document d;
+    d.Parse(R"({"name": "forsen", "emotes": [{"width": 28}, {"width": "x"}]})");
+
+    bool error = false;
+    Deserialize<Channel>::get(d, &error);
+    EXPECT_TRUE(error);
+
+    auto emotes = this->recorder.of<Emote>();
+    auto channels = this->recorder.of<Channel>();
+    ASSERT_EQ(emotes.size(), 2);
+    ASSERT_EQ(channels.size(), 1);
+    EXPECT_EQ(channels[0].operation, TraceOperation::Deserialize);
+    EXPECT_FALSE(emotes[0].error);
+    EXPECT_TRUE(emotes[1].error);
+    EXPECT_TRUE(channels[0].error);
+
+    // Errors that aren't reported to the caller can't be seen
+    this->recorder.records.clear();
+    Deserialize<Channel>::get(d);
+    ASSERT_EQ(this->recorder.of<Channel>().size(), 1);
+    EXPECT_FALSE(this->recorder.of<Channel>()[0].error);
+
+    // Unless the value is of the wrong kind altogether
+    this->recorder.records.clear();
+    Deserialize<Channel>::get(rapidjson::Value(5));
+    ASSERT_EQ(this->recorder.of<Channel>().size(), 1);
+    EXPECT_TRUE(this->recorder.of<Channel>()[0].error);
+}
+
+TEST_F(Trace, DeserializeFrom)
+{
+    bool error = false;
+    Channel channel;
+    rapidjson::StringStream ss(ForsenJson);
+    DeserializeStream(ss, channel, &error);
+    EXPECT_FALSE(error);
+
+    auto emotes = this->recorder.of<Emote>();
+    auto channels = this->recorder.of<Channel>();
+    ASSERT_EQ(emotes.size(), 2);
+    ASSERT_EQ(channels.size(), 1);
+    EXPECT_EQ(channels[0].operation, TraceOperation::DeserializeFrom);
+    EXPECT_FALSE(channels[0].error);
+
+    // Emotes finish before the channel they're in
+    EXPECT_EQ(this->recorder.records.back().type,
+              &detail::TraceTypeOf<Channel>);
+
+    this->recorder.records.clear();
+    rapidjson::StringStream bad(R"({"name": "forsen", "emotes": [5]})");
+    DeserializeStream(bad, channel, &error);
+    EXPECT_TRUE(error);
+    ASSERT_EQ(this->recorder.of<Emote>().size(), 1);
+    EXPECT_TRUE(this->recorder.of<Emote>()[0].error);
+    EXPECT_TRUE(this->recorder.of<Channel>()[0].error);
+}
+
+TEST_F(Trace, VariantAlternatives)
+{
+    using Variant = std::variant<std::vector<int>, std::vector<std::string>,
+                                 std::string>;
+
+    rapidjson::Document d;
+    d.Parse(R"(["a", "b"])");
+
+    bool error = false;
+    auto value = Deserialize<Variant>::get(d, &error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(value.index(), 1);
+
+    auto variants = this->recorder.of<Variant>();
+    ASSERT_EQ(variants.size(), 1);
+    EXPECT_EQ(variants[0].operation, TraceOperation::Deserialize);
+    EXPECT_EQ(variants[0].alternatives, 2);
+    EXPECT_FALSE(variants[0].error);
+
+    // The string is never tried, it can't be decoded from an array
+    this->recorder.records.clear();
+    d.Parse("[true]");
+    Deserialize<Variant>::get(d);
+    variants = this->recorder.of<Variant>();
+    ASSERT_EQ(variants.size(), 1);
+    EXPECT_EQ(variants[0].alternatives, 2);
+    EXPECT_TRUE(variants[0].error);
+
+    this->recorder.records.clear();
+    Serialize<Variant>::get(value, d.GetAllocator());
+    ASSERT_EQ(this->recorder.of<Variant>().size(), 1);
+    EXPECT_GT(this->recorder.of<Variant>()[0].bytes, 0);
+}
+
+TEST_F(Trace, Files)
+{
+    auto path = std::filesystem::temp_directory_path() /
+                "pajlada-serialize-trace.json";
+
+    ASSERT_TRUE(SaveFile(path, Forsen));
+
+    bool error = false;
+    LoadFile<Channel>(path, &error);
+    EXPECT_FALSE(error);
+    std::filesystem::remove(path);
+
+    auto channels = this->recorder.of<Channel>();
+    ASSERT_EQ(channels.size(), 4);
+    EXPECT_EQ(channels[0].operation, TraceOperation::SerializeTo);
+    EXPECT_EQ(channels[1].operation, TraceOperation::SaveFile);
+    EXPECT_EQ(channels[1].bytes, std::string(ForsenJson).size());
+    EXPECT_FALSE(channels[1].error);
+    EXPECT_EQ(channels[2].operation, TraceOperation::Deserialize);
+    EXPECT_EQ(channels[3].operation, TraceOperation::LoadFile);
+    EXPECT_EQ(channels[3].bytes, channels[1].bytes);
+    EXPECT_FALSE(channels[3].error);
+
+    this->recorder.records.clear();
+    LoadFile<Channel>(path, &error);
+    EXPECT_TRUE(error);
+    ASSERT_EQ(this->recorder.of<Channel>().size(), 1);
+    EXPECT_TRUE(this->recorder.of<Channel>()[0].error);
+}
+
+TEST(TraceWithoutSink, RecordsNothing)
+{
+    Recorder recorder;
+    SetTraceSink(&recorder);
+    SetTraceSink(nullptr);
+
+    rapidjson::Document d;
+    Serialize<Channel>::get(Forsen, d.GetAllocator());
+    EXPECT_TRUE(recorder.records.empty());
+}
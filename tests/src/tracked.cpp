@@ -0,0 +1,229 @@
+#include "common.hpp"
+
+#include <gtest/gtest.h>
+#include <rapidjson/document.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <map>
+#include <pajlada/serialize.hpp>
+#include <pajlada/serialize/tracked.hpp>
+#include <string>
+#include <vector>
+
+using namespace pajlada;
+using namespace test;
+
+namespace {
+
+// Counts how often it is serialized
+struct Leaf {
+    int value = 0;
+
+    static inline int serialized = 0;
+};
+
+}  // namespace
+
+namespace pajlada {
+
+template <typename RJValue>
+struct Serialize<Leaf, RJValue> {
+    static RJValue
+    get(const Leaf &value, typename RJValue::AllocatorType &)
+    {
+        ++Leaf::serialized;
+        return RJValue(value.value);
+    }
+};
+
+template <typename RJValue>
+struct Deserialize<Leaf, RJValue> {
+    static Leaf
+    get(const RJValue &value, bool *error = nullptr)
+    {
+        return Leaf{Deserialize<int, RJValue>::get(value, error)};
+    }
+};
+
+template <>
+struct SerializeTo<Leaf> {
+    template <typename Handler>
+    static bool
+    write(const Leaf &value, Handler &handler)
+    {
+        ++Leaf::serialized;
+        return handler.Int(value.value);
+    }
+};
+
+}  // namespace pajlada
+
+namespace {
+
+using Group = Tracked<std::map<std::string, Leaf>>;
+using Tree = Tracked<std::map<std::string, Group>>;
+
+Tree
+MakeTree()
+{
+    Tree tree;
+    for (const auto *group : {"a", "b", "c"}) {
+        auto &leaves = tree.mutate()[group].mutate();
+        for (int i = 0; i < 10; ++i) {
+            leaves["leaf" + std::to_string(i)] = Leaf{i};
+        }
+    }
+    return tree;
+}
+
+std::map<std::string, std::map<std::string, Leaf>>
+Untracked(const Tree &tree)
+{
+    std::map<std::string, std::map<std::string, Leaf>> ret;
+    for (const auto &[name, group] : tree.get()) {
+        ret[name] = group.get();
+    }
+    return ret;
+}
+
+}  // namespace
+
+TEST(Tracked, SerializeOnlyWhatChanged)
+{
+    auto tree = MakeTree();
+    Leaf::serialized = 0;
+
+    auto first = Stringify(tree);
+    EXPECT_EQ(Leaf::serialized, 30);
+    EXPECT_FALSE(tree.dirty());
+    EXPECT_FALSE(tree->at("a").dirty());
+
+    // Nothing changed
+    EXPECT_EQ(Stringify(tree), first);
+    EXPECT_EQ(Leaf::serialized, 30);
+
+    tree.mutate()["b"].mutate()["leaf3"].value = 42;
+    EXPECT_TRUE(tree.dirty());
+    EXPECT_TRUE(tree->at("b").dirty());
+    EXPECT_FALSE(tree->at("c").dirty());
+
+    auto second = Stringify(tree);
+    EXPECT_EQ(Leaf::serialized, 40);
+    EXPECT_NE(second, first);
+
+    Leaf::serialized = 0;
+    EXPECT_EQ(second, Stringify(Untracked(tree)));
+}
+
+TEST(Tracked, WriteOnlyWhatChanged)
+{
+    auto tree = MakeTree();
+    Leaf::serialized = 0;
+
+    auto first = Write(tree);
+    EXPECT_EQ(Leaf::serialized, 30);
+    EXPECT_EQ(Write(tree), first);
+    EXPECT_EQ(Leaf::serialized, 30);
+
+    tree.mutate()["c"].mutate().erase("leaf0");
+    tree.mutate()["d"].set({{"x", Leaf{7}}});
+
+    auto second = Write(tree);
+    EXPECT_EQ(Leaf::serialized, 40);
+
+    Leaf::serialized = 0;
+    EXPECT_EQ(second, Write(Untracked(tree)));
+    EXPECT_EQ(second, Stringify(tree));
+}
+
+TEST(Tracked, NestedTextIsKeptOnce)
+{
+    auto tree = MakeTree();
+    EXPECT_EQ(tree.cacheSize(), 0);
+
+    auto json = Write(tree);
+
+    // The tree only keeps its own text, the groups' text is in their caches
+    size_t groups = 0;
+    for (const auto &[name, group] : tree.get()) {
+        EXPECT_EQ(group.cacheSize(), Write(group).size());
+        groups += group.cacheSize();
+    }
+    EXPECT_EQ(tree.cacheSize() + groups, json.size());
+    EXPECT_EQ(Stringify(tree), json);
+
+    tree.markDirty();
+    EXPECT_EQ(tree.cacheSize(), 0);
+    EXPECT_EQ(tree->at("a").cacheSize(), Write(tree->at("a")).size());
+}
+
+TEST(Tracked, ScalarsAndVectors)
+{
+    Tracked<std::string> text("forsen");
+    EXPECT_EQ(Write(text), R"("forsen")");
+    EXPECT_EQ(Stringify(text), R"("forsen")");
+
+    Tracked<std::vector<int>> numbers({1, 2, 3});
+    std::vector<Tracked<std::vector<int>>> nested{numbers, numbers};
+    EXPECT_EQ(Write(nested), "[[1,2,3],[1,2,3]]");
+
+    nested[1].mutate().push_back(4);
+    EXPECT_EQ(Write(nested), "[[1,2,3],[1,2,3,4]]");
+    EXPECT_EQ(Stringify(nested), "[[1,2,3],[1,2,3,4]]");
+}
+
+TEST(Tracked, CopiesAreDirty)
+{
+    Tracked<std::vector<int>> a({1, 2});
+    Write(a);
+    EXPECT_FALSE(a.dirty());
+
+    auto b = a;
+    EXPECT_TRUE(b.dirty());
+    EXPECT_EQ(Write(b), "[1,2]");
+
+    b = Tracked<std::vector<int>>({3});
+    EXPECT_TRUE(b.dirty());
+    EXPECT_EQ(Write(b), "[3]");
+}
+
+TEST(Tracked, Deserialize)
+{
+    rapidjson::Document d;
+    d.Parse(R"({"a": {"x": 1}, "b": {"y": 2}})");
+    ASSERT_FALSE(d.HasParseError());
+
+    bool error = false;
+    auto tree = Deserialize<Tree>::get(d, &error);
+    EXPECT_FALSE(error);
+    EXPECT_TRUE(tree.dirty());
+    EXPECT_EQ(tree->at("b")->at("y").value, 2);
+
+    Write(tree);
+    EXPECT_FALSE(tree.dirty());
+
+    Deserialize<Tree>::into(tree, d, &error);
+    EXPECT_FALSE(error);
+    EXPECT_TRUE(tree.dirty());
+
+    Tracked<std::vector<int>> numbers;
+    Write(numbers);
+    rapidjson::StringStream ss("[4,5]");
+    DeserializeStream(ss, numbers, &error);
+    EXPECT_FALSE(error);
+    EXPECT_TRUE(numbers.dirty());
+    EXPECT_EQ(Write(numbers), "[4,5]");
+}
+
+TEST(Tracked, PrettyWriterIndentsTheValue)
+{
+    Tracked<std::vector<int>> numbers({1, 2});
+    Write(numbers);
+
+    rapidjson::StringBuffer buffer;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+    EXPECT_TRUE(SerializeTo<Tracked<std::vector<int>>>::write(numbers, writer));
+    EXPECT_EQ(std::string(buffer.GetString()), "[\n    1,\n    2\n]");
+}
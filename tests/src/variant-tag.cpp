@@ -0,0 +1,218 @@
+#include "common.hpp"
+
+#include <gtest/gtest.h>
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <array>
+#include <pajlada/serialize.hpp>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+using namespace pajlada;
+using namespace test;
+
+namespace {
+
+struct Circle {
+    static inline int attempts = 0;
+
+    int radius = 0;
+
+    bool operator==(const Circle &other) const = default;
+};
+
+struct Square {
+    static inline int attempts = 0;
+
+    int side = 0;
+
+    bool operator==(const Square &other) const = default;
+};
+
+using Shape = std::variant<Circle, Square>;
+using IndexedShape = std::variant<Square, Circle>;
+using Untagged = std::variant<Circle, Square, int, std::string>;
+
+template <typename Type, typename RJValue>
+Type
+GetShape(const RJValue &value, const char *key, int Type::*member,
+         bool *error)
+{
+    ++Type::attempts;
+
+    Type ret;
+
+    if (!value.IsObject()) {
+        PAJLADA_REPORT_ERROR(error)
+        return ret;
+    }
+
+    auto it = value.FindMember(key);
+    if (it == value.MemberEnd()) {
+        PAJLADA_REPORT_ERROR(error)
+        return ret;
+    }
+
+    ret.*member = Deserialize<int, RJValue>::get(it->value, error);
+
+    return ret;
+}
+
+}  // namespace
+
+namespace pajlada {
+
+template <typename RJValue>
+struct Serialize<Circle, RJValue> {
+    static RJValue
+    get(const Circle &value, typename RJValue::AllocatorType &a)
+    {
+        RJValue ret(rapidjson::kObjectType);
+        detail::AddMember<int, RJValue>(ret, "radius", value.radius, a);
+        return ret;
+    }
+};
+
+template <typename RJValue>
+struct Serialize<Square, RJValue> {
+    static RJValue
+    get(const Square &value, typename RJValue::AllocatorType &a)
+    {
+        RJValue ret(rapidjson::kObjectType);
+        detail::AddMember<int, RJValue>(ret, "side", value.side, a);
+        return ret;
+    }
+};
+
+template <typename RJValue>
+struct Deserialize<Circle, RJValue> {
+    static Circle
+    get(const RJValue &value, bool *error = nullptr)
+    {
+        return GetShape<Circle>(value, "radius", &Circle::radius, error);
+    }
+};
+
+template <typename RJValue>
+struct Deserialize<Square, RJValue> {
+    static Square
+    get(const RJValue &value, bool *error = nullptr)
+    {
+        return GetShape<Square>(value, "side", &Square::side, error);
+    }
+};
+
+template <>
+struct JsonKinds<Circle> {
+    static constexpr unsigned value = JsonKind::Object;
+};
+
+template <>
+struct JsonKinds<Square> {
+    static constexpr unsigned value = JsonKind::Object;
+};
+
+template <>
+struct VariantTag<Shape> {
+    static constexpr bool enabled = true;
+    static constexpr std::array<std::string_view, 2> names{
+        "circle",
+        "square",
+    };
+};
+
+template <>
+struct VariantTag<IndexedShape> {
+    static constexpr bool enabled = true;
+};
+
+}  // namespace pajlada
+
+TEST(VariantTag, Names)
+{
+    Shape shape = Square{3};
+
+    EXPECT_EQ(Stringify(shape), R"({"type":"square","value":{"side":3}})");
+    EXPECT_EQ(Write(shape), Stringify(shape));
+
+    bool error = false;
+    Circle::attempts = 0;
+    Square::attempts = 0;
+
+    auto out = Parse<Shape>(R"({"type":"square","value":{"side":3}})", error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(out, shape);
+
+    // Only the tagged alternative is ever decoded
+    EXPECT_EQ(Circle::attempts, 0);
+    EXPECT_EQ(Square::attempts, 1);
+
+    out = Parse<Shape>(R"({"type":"triangle","value":{"side":3}})", error);
+    EXPECT_TRUE(error);
+
+    error = false;
+    out = Parse<Shape>(R"({"side":3})", error);
+    EXPECT_TRUE(error);
+}
+
+TEST(VariantTag, Index)
+{
+    IndexedShape shape = Circle{5};
+
+    EXPECT_EQ(Stringify(shape), R"({"type":1,"value":{"radius":5}})");
+    EXPECT_EQ(Write(shape), Stringify(shape));
+
+    bool error = false;
+    auto out = Parse<IndexedShape>(R"({"type":1,"value":{"radius":5}})", error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(out, shape);
+
+    out = Parse<IndexedShape>(R"({"type":2,"value":{"radius":5}})", error);
+    EXPECT_TRUE(error);
+
+    // Vectors of tagged variants survive a round trip through the stream
+    std::vector<IndexedShape> shapes{Circle{1}, Square{2}};
+    error = false;
+    auto roundTripped =
+        Parse<std::vector<IndexedShape>>(Write(shapes).c_str(), error);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(roundTripped, shapes);
+}
+
+TEST(VariantTag, KindFilter)
+{
+    bool error = false;
+    Circle::attempts = 0;
+    Square::attempts = 0;
+
+    // Neither struct can be decoded from a number or a string
+    EXPECT_EQ(Parse<Untagged>("5", error), Untagged(5));
+    EXPECT_EQ(Parse<Untagged>(R"("forsen")", error), Untagged("forsen"));
+    EXPECT_FALSE(error);
+    EXPECT_EQ(Circle::attempts, 0);
+    EXPECT_EQ(Square::attempts, 0);
+
+    // Objects are still tried in order
+    EXPECT_EQ(Parse<Untagged>(R"({"side":2})", error), Untagged(Square{2}));
+    EXPECT_FALSE(error);
+    EXPECT_EQ(Circle::attempts, 1);
+    EXPECT_EQ(Square::attempts, 1);
+
+    Parse<Untagged>("[1]", error);
+    EXPECT_TRUE(error);
+    EXPECT_EQ(Circle::attempts, 1);
+    EXPECT_EQ(Square::attempts, 1);
+}
+
+TEST(VariantTag, Kinds)
+{
+    static_assert(JsonKinds<Untagged>::value ==
+                  (JsonKind::Object | JsonKind::Number | JsonKind::String));
+    static_assert(JsonKinds<Shape>::value == JsonKind::Object);
+    static_assert(JsonKinds<std::optional<int>>::value ==
+                  (JsonKind::Null | JsonKind::Number));
+}
@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <rapidjson/prettywriter.h>
 
 #include <pajlada/serialize.hpp>
 